@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+struct AdmissionOptions {
+    int initialLimit = 16;
+    int minLimit = 2;
+    int maxLimit = 256;
+    size_t maxQueued = 64;
+    double rttTolerance = 2.0;                          // RTT above tolerance x minRtt counts as congestion
+    double backoffRatio = 0.9;
+    std::chrono::milliseconds maxWait{2000};
+    std::chrono::milliseconds minRttWindow{60000};      // minRtt is re-learned this often
+};
+
+// Adaptive concurrency limit for upstream calls.
+//
+// The limit follows AIMD on the measured upstream RTT: every call that finishes
+// within rttTolerance x the minimum RTT seen adds 1/limit (about +1 per window
+// of calls), a slower call or an upstream error multiplies it by backoffRatio.
+// Requests over the limit wait in a bounded FIFO queue; a request whose deadline
+// can't be met (judged from its queue position and the smoothed RTT) is rejected
+// up front instead of holding a server thread until it times out.
+class AdmissionController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    using Options = AdmissionOptions;
+
+    enum class Decision {
+        Admitted,
+        QueueFull,          // too many requests already waiting
+        DeadlineExceeded    // would not (or did not) get a slot before the deadline
+    };
+
+    enum class Outcome {
+        Success,            // call finished; its RTT is a limit sample
+        Dropped,            // upstream error or timeout: back off
+        Ignore              // released without a usable sample
+    };
+
+    struct Stats {
+        double limit;
+        int inFlight;
+        size_t queued;
+        int64_t minRttUs;
+        int64_t smoothedRttUs;
+        uint64_t admitted;
+        uint64_t rejectedFull;
+        uint64_t rejectedDeadline;
+    };
+
+    // Slot held for the duration of one upstream call. Released with Ignore if
+    // it goes out of scope without an explicit release.
+    class Permit {
+    public:
+        Permit() : owner_(nullptr) {}
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+
+        ~Permit() {
+            release(Outcome::Ignore, Clock::duration::zero());
+        }
+
+        void release(Outcome outcome, Clock::duration rtt) {
+            if (owner_) {
+                AdmissionController* owner = owner_;
+                owner_ = nullptr;
+                owner->onRelease(outcome, rtt);
+            }
+        }
+
+    private:
+        friend class AdmissionController;
+        AdmissionController* owner_;
+    };
+
+    explicit AdmissionController(const Options& options = Options())
+        : options_(options)
+        , limit_(options.initialLimit)
+        , inFlight_(0)
+        , minRtt_(Clock::duration::zero())
+        , smoothedRtt_(Clock::duration::zero())
+        , minRttResetAt_(Clock::now() + options.minRttWindow)
+        , admitted_(0)
+        , rejectedFull_(0)
+        , rejectedDeadline_(0)
+    {}
+
+    // Waits for a slot until min(deadline, now + maxWait). A deadline of now means
+    // "only if a slot is free". On rejection retryAfter estimates when to come back.
+    Decision acquire(Clock::time_point deadline, Permit& permit, Clock::duration& retryAfter) {
+        Clock::time_point now = Clock::now();
+        deadline = std::min(deadline, now + options_.maxWait);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (waiters_.empty() && inFlight_ < currentLimit()) {
+            admitLocked(permit);
+            return Decision::Admitted;
+        }
+
+        if (waiters_.size() >= options_.maxQueued) {
+            ++rejectedFull_;
+            retryAfter = estimatedWaitLocked(waiters_.size());
+            return Decision::QueueFull;
+        }
+
+        Clock::duration expected = estimatedWaitLocked(waiters_.size());
+        if (now + expected > deadline) {
+            ++rejectedDeadline_;
+            retryAfter = expected;
+            return Decision::DeadlineExceeded;
+        }
+
+        Waiter waiter{deadline, true, false, {}};
+        auto position = waiters_.insert(waiters_.end(), &waiter);
+        waiter.cond.wait_until(lock, deadline, [&waiter] { return !waiter.queued; });
+        if (!waiter.admitted) {
+            if (waiter.queued) {
+                waiters_.erase(position);
+            }
+            ++rejectedDeadline_;
+            retryAfter = estimatedWaitLocked(waiters_.size());
+            return Decision::DeadlineExceeded;
+        }
+
+        // The releasing thread already counted us in flight and dequeued us
+        permit.owner_ = this;
+        return Decision::Admitted;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {
+            limit_,
+            inFlight_,
+            waiters_.size(),
+            std::chrono::duration_cast<std::chrono::microseconds>(minRtt_).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(smoothedRtt_).count(),
+            admitted_,
+            rejectedFull_,
+            rejectedDeadline_
+        };
+    }
+
+private:
+    struct Waiter {
+        Clock::time_point deadline;
+        bool queued;
+        bool admitted;
+        std::condition_variable cond;
+    };
+
+    int currentLimit() const {
+        return static_cast<int>(limit_);
+    }
+
+    void admitLocked(Permit& permit) {
+        ++inFlight_;
+        ++admitted_;
+        permit.owner_ = this;
+    }
+
+    // Time until `ahead` queued requests have drained through the current limit
+    Clock::duration estimatedWaitLocked(size_t ahead) const {
+        Clock::duration rtt = smoothedRtt_ > Clock::duration::zero() ? smoothedRtt_ : std::chrono::milliseconds(100);
+        return rtt * static_cast<int64_t>(ahead + 1) / std::max(1, currentLimit());
+    }
+
+    void onRelease(Outcome outcome, Clock::duration rtt) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --inFlight_;
+
+        if (outcome == Outcome::Success) {
+            Clock::time_point now = Clock::now();
+            if (now >= minRttResetAt_) {
+                minRtt_ = Clock::duration::zero();
+                minRttResetAt_ = now + options_.minRttWindow;
+            }
+            if (minRtt_ == Clock::duration::zero() || rtt < minRtt_) {
+                minRtt_ = rtt;
+            }
+            smoothedRtt_ = smoothedRtt_ == Clock::duration::zero() ? rtt : (smoothedRtt_ * 7 + rtt) / 8;
+
+            if (rtt > minRtt_ * options_.rttTolerance) {
+                backOffLocked();
+            } else if (inFlight_ + 1 >= currentLimit()) {
+                // Only grow while the limit is actually the bottleneck
+                limit_ = std::min<double>(options_.maxLimit, limit_ + 1.0 / limit_);
+            }
+        } else if (outcome == Outcome::Dropped) {
+            backOffLocked();
+        }
+
+        // Hand free slots to waiters in arrival order, skipping those already past their deadline
+        Clock::time_point now = Clock::now();
+        while (!waiters_.empty() && inFlight_ < currentLimit()) {
+            Waiter* waiter = waiters_.front();
+            waiters_.pop_front();
+            waiter->queued = false;
+            if (waiter->deadline <= now) {
+                waiter->cond.notify_one();
+                continue;
+            }
+            waiter->admitted = true;
+            ++inFlight_;
+            ++admitted_;
+            waiter->cond.notify_one();
+        }
+    }
+
+    void backOffLocked() {
+        limit_ = std::max<double>(options_.minLimit, limit_ * options_.backoffRatio);
+    }
+
+    Options options_;
+    mutable std::mutex mutex_;
+    double limit_;
+    int inFlight_;
+    std::list<Waiter*> waiters_;
+    Clock::duration minRtt_;
+    Clock::duration smoothedRtt_;
+    Clock::time_point minRttResetAt_;
+    uint64_t admitted_;
+    uint64_t rejectedFull_;
+    uint64_t rejectedDeadline_;
+};
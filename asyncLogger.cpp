@@ -0,0 +1,268 @@
+#include "asyncLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info:  return "INFO";
+        case LogLevel::Warn:  return "WARN";
+        case LogLevel::Error: return "ERROR";
+        default:              return "OFF";
+    }
+}
+
+}
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::~AsyncLogger() {
+    stop();
+}
+
+void AsyncLogger::start(const Options& options) {
+    if (running_.exchange(true)) {
+        return;
+    }
+
+    level_.store(static_cast<uint8_t>(options.level), std::memory_order_relaxed);
+    maxLinesPerSecond_.store(options.maxLinesPerSecond, std::memory_order_relaxed);
+    flushIntervalMs_ = options.flushIntervalMs > 0 ? options.flushIntervalMs : 50;
+
+    file_ = nullptr;
+    if (!options.path.empty()) {
+        file_ = std::fopen(options.path.c_str(), "a");
+        if (!file_) {
+            std::cerr << "Failed to open log file " << options.path << ", logging to stdout" << std::endl;
+        }
+    }
+
+    writer_ = std::thread(&AsyncLogger::writerLoop, this);
+}
+
+void AsyncLogger::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    wakeCond_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+AsyncLogger::ThreadRing* AsyncLogger::localRing() {
+    thread_local std::shared_ptr<ThreadRing> ring;
+    if (!ring) {
+        ring = std::make_shared<ThreadRing>();
+        ring->threadId = nextThreadId_.fetch_add(1, std::memory_order_relaxed);
+        ring->bucketTokens = maxLinesPerSecond_.load(std::memory_order_relaxed);
+        ring->bucketRefillNs = nowNs();
+
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.push_back(ring);
+    }
+    return ring.get();
+}
+
+bool AsyncLogger::takeToken(ThreadRing* ring, int64_t now) {
+    uint32_t limit = maxLinesPerSecond_.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return true;
+    }
+
+    // Refill whole seconds worth of tokens, capped at one second of burst
+    int64_t elapsed = now - ring->bucketRefillNs;
+    if (elapsed > 0) {
+        uint64_t refill = static_cast<uint64_t>(elapsed) * limit / 1000000000ULL;
+        if (refill > 0) {
+            ring->bucketTokens = static_cast<uint32_t>(std::min<uint64_t>(limit, ring->bucketTokens + refill));
+            ring->bucketRefillNs = now;
+        }
+    }
+
+    if (ring->bucketTokens == 0) {
+        return false;
+    }
+    --ring->bucketTokens;
+    return true;
+}
+
+void AsyncLogger::log(LogLevel level, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vlog(level, fmt, args);
+    va_end(args);
+}
+
+void AsyncLogger::vlog(LogLevel level, const char* fmt, va_list args) {
+    if (!enabled(level)) {
+        return;
+    }
+
+    ThreadRing* ring = localRing();
+    int64_t now = nowNs();
+
+    // Errors are never rate limited, everything else shares the thread's bucket
+    if (level < LogLevel::Error && !takeToken(ring, now)) {
+        ring->droppedRate.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail >= kRingSize) {
+        ring->droppedFull.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->slots[head & (kRingSize - 1)];
+    record.timeNs = now;
+    record.threadId = ring->threadId;
+    record.level = level;
+
+    int n = std::vsnprintf(record.text, kMaxLineLength, fmt, args);
+    if (n < 0) {
+        n = 0;
+    } else if (static_cast<size_t>(n) >= kMaxLineLength) {
+        // Truncated, mark it so the reader knows
+        n = kMaxLineLength - 1;
+        record.text[n - 3] = record.text[n - 2] = record.text[n - 1] = '.';
+    }
+    record.length = static_cast<uint16_t>(n);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+AsyncLogger::Counters AsyncLogger::counters() const {
+    Counters result{written_.load(std::memory_order_relaxed),
+                    retiredDroppedFull_.load(std::memory_order_relaxed),
+                    retiredDroppedRate_.load(std::memory_order_relaxed)};
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (const auto& ring : rings_) {
+        result.droppedFull += ring->droppedFull.load(std::memory_order_relaxed);
+        result.droppedRate += ring->droppedRate.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void AsyncLogger::appendRecord(std::string& batch, const Record& record) {
+    time_t seconds = static_cast<time_t>(record.timeNs / 1000000000LL);
+    int millis = static_cast<int>((record.timeNs / 1000000LL) % 1000);
+    struct tm tmv;
+    gmtime_r(&seconds, &tmv);
+
+    char prefix[64];
+    size_t len = std::strftime(prefix, sizeof(prefix), "%Y-%m-%dT%H:%M:%S", &tmv);
+    len += std::snprintf(prefix + len, sizeof(prefix) - len, ".%03dZ %-5s t=%u ",
+                         millis, levelName(record.level), record.threadId);
+
+    batch.append(prefix, len);
+    batch.append(record.text, record.length);
+    batch.push_back('\n');
+}
+
+size_t AsyncLogger::drain(std::string& batch) {
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings = rings_;
+    }
+
+    size_t lines = 0;
+    for (auto& ring : rings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            appendRecord(batch, ring->slots[tail & (kRingSize - 1)]);
+            ++lines;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    // Forget rings whose thread has exited once they are drained
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        for (auto it = rings_.begin(); it != rings_.end();) {
+            // rings_ and the local copy are the only owners left
+            if (it->use_count() <= 2 &&
+                (*it)->head.load(std::memory_order_acquire) == (*it)->tail.load(std::memory_order_relaxed)) {
+                retiredDroppedFull_.fetch_add((*it)->droppedFull.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                retiredDroppedRate_.fetch_add((*it)->droppedRate.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                it = rings_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    return lines;
+}
+
+void AsyncLogger::writeBatch(std::string& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    FILE* out = file_ ? file_ : stdout;
+    std::fwrite(batch.data(), 1, batch.size(), out);
+    std::fflush(out);
+    batch.clear();
+}
+
+void AsyncLogger::writerLoop() {
+    std::string batch;
+    batch.reserve(64 * 1024);
+
+    uint64_t reportedDrops = 0;
+    auto lastDropReport = std::chrono::steady_clock::now();
+
+    while (running_.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wakeCond_.wait_for(lock, std::chrono::milliseconds(flushIntervalMs_));
+        }
+
+        written_.fetch_add(drain(batch), std::memory_order_relaxed);
+
+        // Surface drops once per second so they don't go unnoticed
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastDropReport >= std::chrono::seconds(1)) {
+            Counters c = counters();
+            uint64_t drops = c.droppedFull + c.droppedRate;
+            if (drops != reportedDrops) {
+                char line[160];
+                int n = std::snprintf(line, sizeof(line),
+                                      "logger event=dropped full=%llu rate_limited=%llu\n",
+                                      static_cast<unsigned long long>(c.droppedFull),
+                                      static_cast<unsigned long long>(c.droppedRate));
+                batch.append(line, n);
+                reportedDrops = drops;
+            }
+            lastDropReport = now;
+        }
+
+        writeBatch(batch);
+    }
+
+    // Final drain so nothing logged before stop() is lost
+    written_.fetch_add(drain(batch), std::memory_order_relaxed);
+    writeBatch(batch);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+// Asynchronous logger for request hot paths.
+//
+// Each thread formats its line straight into a slot of its own single-producer
+// ring buffer, so logging never takes a shared lock or touches the heap after
+// the first call from that thread. A background writer drains all rings,
+// batches the lines and writes them to the log file in one fwrite per round.
+// Lines are logfmt-style ("event=cache_hit tokens=3") so they stay greppable.
+class AsyncLogger {
+public:
+    static constexpr size_t kMaxLineLength = 240;
+    static constexpr size_t kRingSize = 1024;   // slots per thread, power of two
+
+    struct Options {
+        std::string path;                  // empty means stdout
+        LogLevel level = LogLevel::Info;
+        uint32_t maxLinesPerSecond = 2000; // per thread, 0 disables rate limiting
+        uint32_t flushIntervalMs = 50;
+    };
+
+    struct Counters {
+        uint64_t written;
+        uint64_t droppedFull;              // ring buffer was full
+        uint64_t droppedRate;              // rejected by the rate limiter
+    };
+
+    static AsyncLogger& instance();
+
+    void start(const Options& options);
+    void stop();
+
+    bool enabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >= level_.load(std::memory_order_relaxed);
+    }
+    void setLevel(LogLevel level) { level_.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+
+    void log(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+    void vlog(LogLevel level, const char* fmt, va_list args);
+
+    Counters counters() const;
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+private:
+    struct Record {
+        int64_t timeNs;
+        uint32_t threadId;
+        LogLevel level;
+        uint16_t length;
+        char text[kMaxLineLength];
+    };
+
+    struct ThreadRing {
+        alignas(64) std::atomic<uint64_t> head{0};   // next slot the producer writes
+        alignas(64) std::atomic<uint64_t> tail{0};   // next slot the writer reads
+        alignas(64) std::atomic<uint64_t> droppedFull{0};
+        std::atomic<uint64_t> droppedRate{0};
+        uint32_t threadId = 0;
+        // Token bucket, only touched by the owning thread
+        int64_t bucketRefillNs = 0;
+        uint32_t bucketTokens = 0;
+        Record slots[kRingSize];
+    };
+
+    AsyncLogger() = default;
+    ~AsyncLogger();
+
+    ThreadRing* localRing();
+    bool takeToken(ThreadRing* ring, int64_t nowNs);
+    void writerLoop();
+    size_t drain(std::string& batch);
+    void appendRecord(std::string& batch, const Record& record);
+    void writeBatch(std::string& batch);
+
+private:
+    std::atomic<uint8_t> level_{static_cast<uint8_t>(LogLevel::Info)};
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> retiredDroppedFull_{0};   // drops of rings already forgotten
+    std::atomic<uint64_t> retiredDroppedRate_{0};
+    std::atomic<uint32_t> maxLinesPerSecond_{2000};
+    uint32_t flushIntervalMs_ = 50;
+    FILE* file_ = nullptr;
+
+    mutable std::mutex ringsMutex_;              // guards rings_ registration only
+    std::vector<std::shared_ptr<ThreadRing>> rings_;
+    std::atomic<uint32_t> nextThreadId_{1};
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCond_;
+    std::thread writer_;
+};
+
+#define LOG_AT(lvl, ...)                                              \
+    do {                                                              \
+        auto& logger_ = AsyncLogger::instance();                      \
+        if (logger_.enabled(lvl)) logger_.log(lvl, __VA_ARGS__);      \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
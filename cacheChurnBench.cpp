@@ -0,0 +1,172 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "cmdLine.h"
+#include "lfuCache.h"
+
+// Long-running eviction churn against HashLfuCache, reporting RSS and fragmentation.
+//
+//   cache_churn_bench --seconds=600 --slice-pools=1 &
+//   cache_churn_bench --seconds=600 --slice-pools=0
+//
+// --threads workers read keys from a keyspace --keys wide; every miss stores a
+// value of random size (64 B .. --max-value, skewed small like chat replies),
+// evicting something else once the cache holds --capacity entries. Alongside,
+// each worker allocates short-lived request-sized strings so cache nodes are
+// interleaved with unrelated garbage on the global heap, as they are in the
+// proxy. Run each mode in its own process: RSS is per process.
+//
+// Every --report-s seconds it prints the throughput, the process RSS, the slice
+// pools' bytes in use vs held (pooled mode) and the glibc heap's free share.
+
+using namespace CacheImpl;
+using Clock = std::chrono::steady_clock;
+using ChurnCache = HashLfuCache<std::pmr::string, std::pmr::string>;
+
+double rssMiB() {
+    long pages = 0;
+    long resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024 * 1024);
+}
+
+// Free bytes inside the heap as a share of the heap, in percent; -1 if unknown
+double heapFragmentation() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    size_t heap = info.arena + info.hblkhd;
+    return heap == 0 ? 0.0 : info.fordblks * 100.0 / heap;
+#else
+    return -1;
+#endif
+}
+
+struct Rng {
+    uint64_t state;
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+// 64 B .. maxValue, log-uniform: most replies are short, a few are long
+size_t valueSize(Rng& rng, size_t maxValue) {
+    int maxBits = 6;
+    while ((size_t(1) << (maxBits + 1)) <= maxValue) {
+        ++maxBits;
+    }
+    int bits = 6 + static_cast<int>(rng.next() % (maxBits - 5));
+    size_t low = size_t(1) << bits;
+    return std::min(maxValue, low + rng.next() % low);
+}
+
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    double seconds = args.getDouble("seconds", 300);
+    double reportEvery = args.getDouble("report-s", 10);
+    int threads = static_cast<int>(args.getInt("threads", 4));
+    size_t capacity = static_cast<size_t>(args.getInt("capacity", 20000));
+    size_t keys = static_cast<size_t>(args.getInt("keys", 200000));
+    int slices = static_cast<int>(args.getInt("slices", 8));
+    size_t maxValue = static_cast<size_t>(args.getInt("max-value", 16384));
+    bool pooled = args.getBool("slice-pools", true);
+
+    ChurnCache cache(capacity, slices, 10, pooled);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> ops{0};
+    std::atomic<uint64_t> misses{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            Rng rng{0x9E3779B97F4A7C15ULL * (t + 1)};
+            // Requests in flight: a ring of strings replaced one at a time
+            std::vector<std::string> inFlight(64);
+            std::pmr::string key;
+            std::pmr::string value;
+            uint64_t local = 0;
+            uint64_t localMisses = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                // Skewed keyspace: squaring a uniform draw favours low key numbers
+                uint64_t draw = rng.next() % keys;
+                key = "prompt #" + std::to_string(draw * draw / keys);
+                if (!cache.get(key, value)) {
+                    cache.put(key, std::pmr::string(valueSize(rng, maxValue), 'a' + draw % 26));
+                    ++localMisses;
+                }
+                inFlight[rng.next() % inFlight.size()].assign(valueSize(rng, 4096), 'r');
+                if (++local % 1024 == 0) {
+                    ops.fetch_add(1024, std::memory_order_relaxed);
+                    misses.fetch_add(localMisses, std::memory_order_relaxed);
+                    localMisses = 0;
+                }
+            }
+        });
+    }
+
+    std::cout << (pooled ? "slice pools" : "global heap") << ", " << threads << " threads, capacity " << capacity
+              << ", " << keys << " keys, values up to " << maxValue << " B\n";
+    std::cout << std::setw(8) << "time_s" << std::setw(10) << "Mops/s" << std::setw(8) << "miss%"
+              << std::setw(10) << "entries" << std::setw(10) << "rss_MiB" << std::setw(12) << "pool_use"
+              << std::setw(12) << "pool_held" << std::setw(11) << "pool_frag" << std::setw(11) << "heap_free" << "\n";
+
+    auto started = Clock::now();
+    uint64_t lastOps = 0;
+    uint64_t lastMisses = 0;
+    auto last = started;
+    double firstRss = 0;
+    double peakRss = 0;
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(reportEvery));
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - started).count();
+        uint64_t totalOps = ops.load();
+        uint64_t totalMisses = misses.load();
+        double interval = std::chrono::duration<double>(now - last).count();
+        uint64_t intervalOps = totalOps - lastOps;
+        auto memory = cache.memoryStats();
+        double rss = rssMiB();
+        firstRss = firstRss == 0 ? rss : firstRss;
+        peakRss = std::max(peakRss, rss);
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(8) << elapsed
+                  << std::setprecision(2) << std::setw(10) << intervalOps / interval / 1e6
+                  << std::setprecision(1) << std::setw(8)
+                  << (intervalOps == 0 ? 0.0 : (totalMisses - lastMisses) * 100.0 / intervalOps)
+                  << std::setw(10) << cache.size() << std::setw(10) << rss
+                  << std::setw(12) << memory.inUse / 1024 << std::setw(12) << memory.held / 1024
+                  << std::setw(10) << memory.fragmentation() * 100 << "%"
+                  << std::setw(10) << heapFragmentation() << "%\n";
+
+        lastOps = totalOps;
+        lastMisses = totalMisses;
+        last = now;
+        if (elapsed >= seconds) {
+            break;
+        }
+    }
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::cout << std::setprecision(1) << "rss first report " << firstRss << " MiB, peak " << peakRss
+              << " MiB, final " << rssMiB() << " MiB (pool columns in KiB)\n";
+    return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Response cache keys for multi-turn traffic.
+//
+// A key is the normalized message prefixed with a 128-bit hash of the last few
+// turns of its conversation, so "why?" after two different answers maps to two
+// different entries. The context hash is kept incrementally by the session store
+// (see ContextHash); a message without history keys on the message alone.
+
+struct Hash128 {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool isZero() const { return lo == 0 && hi == 0; }
+    bool operator==(const Hash128& other) const { return lo == other.lo && hi == other.hi; }
+};
+
+namespace CacheKeyDetail {
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t power(uint64_t base, size_t exponent) {
+    uint64_t result = 1;
+    while (exponent > 0) {
+        if (exponent & 1) {
+            result *= base;
+        }
+        base *= base;
+        exponent >>= 1;
+    }
+    return result;
+}
+
+// Odd multipliers for the two lanes of the rolling hash (arithmetic mod 2^64)
+const uint64_t kRollLo = 0x9E3779B97F4A7C15ULL;
+const uint64_t kRollHi = 0xD6E8FEB86659FD93ULL;
+
+}
+
+// Two independent 64-bit lanes over 8-byte words; not cryptographic
+inline Hash128 hash128(std::string_view data, uint64_t seed = 0) {
+    using namespace CacheKeyDetail;
+    const uint64_t k1 = 0x87c37b91114253d5ULL;
+    const uint64_t k2 = 0x4cf5ad432745937fULL;
+    uint64_t a = seed ^ (data.size() * k1);
+    uint64_t b = ~seed ^ (data.size() * k2);
+
+    const char* p = data.data();
+    size_t n = data.size();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        a = rotl(a ^ (w * k1), 31) * k2;
+        b = rotl(b + (w * k2), 29) * k1;
+    }
+    if (i < n) {
+        uint64_t w = 0;
+        std::memcpy(&w, p + i, n - i);
+        a ^= rotl(w * k1, 31) * k2;
+        b += rotl(w * k2, 29) * k1;
+    }
+
+    a = fmix(a);
+    b = fmix(b + a);
+    a += b;
+    return Hash128{a, b};
+}
+
+// Rolling hash over the digests of the last `depth` turns. Pushing a turn is
+// O(1); the caller hands back the digest that falls out of the window.
+class ContextHash {
+public:
+    void push(const Hash128& digest) {
+        value_.lo = value_.lo * CacheKeyDetail::kRollLo + digest.lo;
+        value_.hi = value_.hi * CacheKeyDetail::kRollHi + digest.hi;
+    }
+
+    // Remove a digest pushed `depth` turns ago
+    void drop(const Hash128& digest, size_t depth) {
+        value_.lo -= digest.lo * CacheKeyDetail::power(CacheKeyDetail::kRollLo, depth);
+        value_.hi -= digest.hi * CacheKeyDetail::power(CacheKeyDetail::kRollHi, depth);
+    }
+
+    const Hash128& value() const { return value_; }
+
+private:
+    Hash128 value_;
+};
+
+// Trim, collapse whitespace runs to one space, lowercase ASCII. Non-ASCII bytes
+// are kept as is so UTF-8 text is never split.
+inline void normalizeMessage(std::string_view message, std::string& out) {
+    out.clear();
+    out.reserve(message.size());
+    bool pendingSpace = false;
+    for (char c : message) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+            pendingSpace = !out.empty();
+            continue;
+        }
+        if (pendingSpace) {
+            out.push_back(' ');
+            pendingSpace = false;
+        }
+        out.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+}
+
+inline void appendHex(const Hash128& hash, std::string& out) {
+    static const char* hex = "0123456789abcdef";
+    for (uint64_t lane : {hash.hi, hash.lo}) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            out.push_back(hex[(lane >> shift) & 0xF]);
+        }
+    }
+}
+
+// "<32 hex digits of context>:<normalized message>", or just the normalized
+// message when there is no context
+inline std::string buildCacheKey(const Hash128& context, std::string_view message) {
+    std::string key;
+    if (!context.isZero()) {
+        key.reserve(33 + message.size());
+        appendHex(context, key);
+        key.push_back(':');
+    }
+    std::string normalized;
+    normalizeMessage(message, normalized);
+    key.append(normalized);
+    return key;
+}
+
+// Key for a request too long to cache, e.g. for the negative cache: a hash of
+// the whole upstream body. The leading space keeps it apart from cache keys,
+// since a normalized message never starts with one.
+inline std::string buildBodyKey(std::string_view body) {
+    std::string key = " body:";
+    appendHex(hash128(body), key);
+    return key;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+namespace CacheImpl
+{
+    // 缓存节点的内存来源。LruCache / LfuCache 构造时可传入一个 memory_resource，
+    // 节点、频次链表和哈希表都从它分配；key / value 如果是 pmr 类型（如 std::pmr::string），
+    // 存进节点的那一份也用同一个 resource。默认是 std::pmr::get_default_resource()，
+    // 即全局分配器，行为与以前相同。
+
+    // 用 resource 构造一个 T：T 支持 pmr 分配器时按 uses-allocator 约定传入，否则直接构造
+    template <typename T, typename... Args>
+    T makeWithResource(std::pmr::memory_resource* resource, Args&&... args)
+    {
+        using Alloc = std::pmr::polymorphic_allocator<std::byte>;
+        if constexpr (!std::uses_allocator_v<T, Alloc>)
+            return T(std::forward<Args>(args)...);
+        else if constexpr (std::is_constructible_v<T, std::allocator_arg_t, const Alloc&, Args...>)
+            return T(std::allocator_arg, Alloc(resource), std::forward<Args>(args)...);
+        else
+            return T(std::forward<Args>(args)..., Alloc(resource));
+    }
+
+    // 在 resource 上分配 T 并返回 shared_ptr（控制块与对象同一块内存）
+    template <typename T, typename... Args>
+    std::shared_ptr<T> allocateShared(std::pmr::memory_resource* resource, Args&&... args)
+    {
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(resource), std::forward<Args>(args)...);
+    }
+
+    // 统计经过的字节数与块数。只允许一个线程（持有分片锁的线程）分配和释放，
+    // 计数用 relaxed 读写而不是原子加，其它线程随时可以读
+    class CountingResource : public std::pmr::memory_resource
+    {
+        public:
+            explicit CountingResource(std::pmr::memory_resource* upstream)
+                : upstream_(upstream)
+                , bytes_(0)
+                , blocks_(0)
+            {}
+
+            size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+            size_t blocks() const { return blocks_.load(std::memory_order_relaxed); }
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override
+            {
+                void* p = upstream_->allocate(bytes, alignment);
+                bytes_.store(bytes_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+                blocks_.store(blocks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return p;
+            }
+
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override
+            {
+                upstream_->deallocate(p, bytes, alignment);
+                bytes_.store(bytes_.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+                blocks_.store(blocks_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+
+        private:
+            std::pmr::memory_resource* upstream_;
+            std::atomic<size_t> bytes_;
+            std::atomic<size_t> blocks_;
+    };
+
+    // 单个分片独占的内存池：按块大小分级的空闲链表（unsynchronized_pool_resource）。
+    // 淘汰释放的节点回到本分片的空闲链表，下一次插入直接复用，不经过全局分配器；
+    // 池向上游整块申请，分片之间互不交错，长时间淘汰换入后也不会把堆切碎。
+    // 池只增不减，峰值之后占用保持平稳，分片表销毁（析构或 reshard 迁移完成）时整体归还。
+    // 只能在分片锁内使用；stats() 可在任意线程调用。
+    class SlicePool
+    {
+        public:
+            struct Stats
+            {
+                size_t inUse;       // 缓存当前实际占用的字节
+                size_t held;        // 池向上游申请、尚未归还的字节
+                size_t chunks;      // 上游块数
+
+                double fragmentation() const
+                {
+                    return held == 0 ? 0.0 : 1.0 - static_cast<double>(inUse) / held;
+                }
+
+                Stats& operator+=(const Stats& other)
+                {
+                    inUse += other.inUse;
+                    held += other.held;
+                    chunks += other.chunks;
+                    return *this;
+                }
+            };
+
+            explicit SlicePool(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+                : held_(upstream)
+                , pool_(poolOptions(), &held_)
+                , inUse_(&pool_)
+            {}
+
+            SlicePool(const SlicePool&) = delete;
+            SlicePool& operator=(const SlicePool&) = delete;
+
+            std::pmr::memory_resource* resource() { return &inUse_; }
+
+            Stats stats() const
+            {
+                return {inUse_.bytes(), held_.bytes(), held_.blocks()};
+            }
+
+        private:
+            static std::pmr::pool_options poolOptions()
+            {
+                std::pmr::pool_options options;
+                options.max_blocks_per_chunk = 256;         // 限制冷门尺寸一次预留的量
+                options.largest_required_pool_block = 4096; // 更大的（长回复、哈希桶数组）直接走上游
+                return options;
+            }
+
+            CountingResource held_;                         // 池与上游之间
+            std::pmr::unsynchronized_pool_resource pool_;
+            CountingResource inUse_;                        // 缓存与池之间
+    };
+}
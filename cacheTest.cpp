@@ -5,8 +5,20 @@
 #include <iomanip>
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
 #include "lruCache.h"
 #include "lfuCache.h"
+#include "coreRouter.h"
+#include "tokenizer.h"
+#include "sessionStore.h"
+#include "jsonScanner.h"
+#include "admissionController.h"
+#include "circuitBreaker.h"
+#include <nlohmann/json.hpp>
 
 using namespace CacheImpl;
 
@@ -32,6 +44,16 @@ void printResults(const std::string& cacheType, int totalOps, int hits, double t
     std::cout << "Time: " << time << " ms\n";
 }
 
+// Correctness checks below report every failure; main() returns 1 if any failed
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        ++failures;
+        std::cout << "FAILED: " << what << "\n";
+    }
+}
+
 // Test LRU cache with hot data access
 void testLruHotData(LruCache<int, std::string>& cache) {
     const int CACHE_SIZE = 20;
@@ -685,9 +707,674 @@ void testWorkloadShift() {
     }
 }
 
+// Writers keep rewriting their own keys while readers check every value they
+// see and the main thread resizes and reshards. A value is key * 16 + version,
+// so a reader can tell a wrong value from a stale one; at the end every key
+// must hold its last version.
+template <typename Cache>
+void checkResizeAndReshard(const std::string& name) {
+    const int KEYS = 4000;
+    const int WRITERS = 4;
+    const int ROUNDS = 8;
+
+    Cache cache(KEYS * 4, 4);
+    std::atomic<bool> stop{false};
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int version = 0; version < ROUNDS; ++version) {
+                for (int key = w; key < KEYS; key += WRITERS) {
+                    cache.put(key, key * 16 + version);
+                }
+            }
+        });
+    }
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&, r]() {
+            std::mt19937 gen(r);
+            while (!stop.load()) {
+                int key = gen() % KEYS;
+                int value = 0;
+                if (cache.get(key, value) && value / 16 != key) {
+                    ++wrong;
+                }
+            }
+        });
+    }
+
+    // Capacity never drops below 2x the keys, so nothing may be evicted
+    for (int i = 0; i < 40; ++i) {
+        cache.resize(i % 2 == 0 ? KEYS * 2 : KEYS * 8);
+        cache.reshard(1 + i % 7);
+        for (int step = 0; step < 50; ++step) {
+            cache.migrateStep();
+        }
+        std::this_thread::yield();
+    }
+    for (int w = 0; w < WRITERS; ++w) {
+        threads[w].join();
+    }
+    stop = true;
+    for (size_t t = WRITERS; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    while (cache.migrateStep()) {
+    }
+
+    check(wrong == 0, name + ": reader saw a value stored under another key");
+    int lost = 0;
+    int stale = 0;
+    for (int key = 0; key < KEYS; ++key) {
+        int value = -1;
+        if (!cache.get(key, value)) {
+            ++lost;
+        } else if (value != key * 16 + ROUNDS - 1) {
+            ++stale;
+        }
+    }
+    check(lost == 0, name + ": " + std::to_string(lost) + " entries lost across resize/reshard");
+    check(stale == 0, name + ": " + std::to_string(stale) + " entries hold an old version");
+    check(cache.size() == static_cast<size_t>(KEYS), name + ": size is " + std::to_string(cache.size()));
+
+    // A purge in the middle of a migration must not leave the next one half done
+    cache.reshard(3);
+    cache.migrateStep(KEYS / 2);
+    cache.purge();
+    for (int key = 0; key < KEYS; ++key) {
+        cache.put(key, key * 16);
+    }
+    cache.reshard(5);
+    while (cache.migrateStep()) {
+    }
+    check(cache.size() == static_cast<size_t>(KEYS), name + ": entries lost when resharding after a purge");
+}
+
+void testResizeAndReshard() {
+    std::cout << "\n=== Test 4: Online Resize and Reshard ===\n";
+    int before = failures;
+    checkResizeAndReshard<HashLruCache<int, int>>("Hash-LRU");
+    checkResizeAndReshard<HashLfuCache<int, int>>("Hash-LFU");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+// Two cores (the same CPU twice on a single-CPU box, which still exercises the rings)
+void testCoreRouter() {
+    std::cout << "\n=== Test 5: Thread-per-Core Routing ===\n";
+    int before = failures;
+    std::vector<int> cpus = CoreRouter::availableCpus();
+    if (cpus.empty()) {
+        std::cout << "skipped: no CPU affinity\n";
+        return;
+    }
+    CoreRouter router({cpus.front(), cpus.back()});
+    router.start();
+
+    // Unpinned callers go through the owner's inbox
+    int counter = 0;
+    for (int i = 0; i < 100; ++i) {
+        router.run(i % 2, [&]() { ++counter; });
+    }
+    check(counter == 100, "router: unpinned calls ran " + std::to_string(counter) + " times");
+
+    bool threw = false;
+    try {
+        router.run(1, []() { throw std::runtime_error("slice failed"); });
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()) == "slice failed";
+    }
+    check(threw, "router: exception not rethrown to the caller");
+
+    const int KEYS = 2000;
+    HashLfuCache<int, int> cache(KEYS * 4, 4);
+    cache.routeToCores(&router);
+    check(!cache.reshard(8), "router: routed cache accepted a reshard");
+
+    // Two pinned workers per core plus an unpinned one, each owning a stripe of keys
+    const int WORKERS = 5;
+    std::atomic<int> wrong{0};
+    std::atomic<int> wrongCore{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WORKERS; ++w) {
+        threads.emplace_back([&, w]() {
+            if (w < 4) {
+                // The first listed core claims a shared CPU
+                int expected = cpus.front() == cpus.back() ? 0 : w % 2;
+                CoreRouter::pinThread(w % 2 == 0 ? cpus.front() : cpus.back());
+                if (router.currentCore() != expected) {
+                    ++wrongCore;
+                }
+            }
+            for (int round = 0; round < 4; ++round) {
+                for (int key = w; key < KEYS; key += WORKERS) {
+                    cache.put(key, key * 16 + round);
+                    int value = -1;
+                    if (!cache.get(key, value) || value != key * 16 + round) {
+                        ++wrong;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    check(wrongCore == 0, "router: pinned thread mapped to the wrong core");
+    check(wrong == 0, "router: " + std::to_string(wrong.load()) + " reads missed their own write");
+    int lost = 0;
+    for (int key = 0; key < KEYS; ++key) {
+        int value = -1;
+        if (!cache.get(key, value) || value != key * 16 + 3) {
+            ++lost;
+        }
+    }
+    check(lost == 0, "router: " + std::to_string(lost) + " entries lost or stale");
+    check(cache.size() == static_cast<size_t>(KEYS), "router: size is " + std::to_string(cache.size()));
+    cache.resize(KEYS / 2);
+    check(cache.capacity() == static_cast<size_t>(KEYS / 2), "router: resize did not take");
+    cache.purge();
+    check(cache.size() == 0, "router: purge left entries behind");
+
+    // Pinned threads run their own core's calls inline and forward the rest
+    uint64_t local = 0;
+    uint64_t forwarded = 0;
+    uint64_t served = 0;
+    for (const auto& core : router.stats()) {
+        local += core.local;
+        forwarded += core.forwarded;
+        served += core.served;
+    }
+    check(local > 0, "router: no call ran inline on its own core");
+    check(forwarded > 0, "router: no call was forwarded to another core");
+    check(served >= forwarded, "router: owners served fewer calls than were forwarded");
+    router.stop();
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+// Writes merges (one "a b" per line) to a scratch file and loads them
+bool loadMergesText(Tokenizer& tokenizer, const std::string& merges) {
+    const std::string path = "cache_test_merges.txt";
+    {
+        std::ofstream out(path);
+        out << merges;
+    }
+    bool loaded = tokenizer.loadMerges(path);
+    std::remove(path.c_str());
+    return loaded;
+}
+
+void testTokenizer() {
+    std::cout << "\n=== Test 6: Token Counting ===\n";
+    int before = failures;
+
+    // Estimate: an ASCII word costs one token per four bytes, a non-ASCII code point one
+    check(Tokenizer::estimate("") == 0, "tokenizer: empty text");
+    check(Tokenizer::estimate("abcd") == 1, "tokenizer: four-byte word");
+    check(Tokenizer::estimate("abcde  fg") == 3, "tokenizer: two words");
+    check(Tokenizer::estimate("\xe4\xbd\xa0\xe5\xa5\xbd") == 2, "tokenizer: two CJK characters");
+    std::mt19937 gen(7);
+    const char* alphabet[] = {"a", "b", "Z", "9", " ", "\n", ",", "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80"};
+    int mismatched = 0;
+    for (int round = 0; round < 200; ++round) {
+        std::string text;
+        size_t length = gen() % 300;
+        while (text.size() < length) {
+            text += alphabet[gen() % 10];
+        }
+        if (Tokenizer::estimate(text) != Tokenizer::estimateScalar(text)) {
+            ++mismatched;
+        }
+    }
+    check(mismatched == 0, "tokenizer: SIMD estimate differs from scalar on " + std::to_string(mismatched) + " inputs");
+
+    Tokenizer missing;
+    check(!missing.loadMerges("no_such_merges.txt") && !missing.hasMerges(), "tokenizer: loaded a missing file");
+    check(missing.count("hello world") == Tokenizer::estimate("hello world"), "tokenizer: count without merges");
+
+    // Byte-level BPE: Ġ is the space byte
+    Tokenizer bpe;
+    check(loadMergesText(bpe, "h e\nl l\nhe ll\nhell o\n\xc4\xa0 w\no r\n\xc4\xa0w or\nl d\n1 2\n"),
+          "tokenizer: merges not loaded");
+    check(bpe.mergeCount() == 9, "tokenizer: merge count is " + std::to_string(bpe.mergeCount()));
+    check(bpe.count("hello world") == 3, "tokenizer: 'hello world' is " + std::to_string(bpe.count("hello world")));
+    check(bpe.count("12345") == 4, "tokenizer: digits are grouped by three");
+    std::string repeated = "hello";
+    for (int i = 0; i < 999; ++i) {
+        repeated += " hello";
+    }
+    check(bpe.count(repeated) == 1 + 2 * 999, "tokenizer: long text is " + std::to_string(bpe.count(repeated)));
+
+    // The lowest rank merges first, wherever it sits in the piece
+    Tokenizer leftFirst;
+    Tokenizer rightFirst;
+    loadMergesText(leftFirst, "a b\nb c\na bc\n");
+    loadMergesText(rightFirst, "b c\na b\na bc\n");
+    check(leftFirst.count("abc") == 2, "tokenizer: 'a b' should win in 'abc'");
+    check(rightFirst.count("abc") == 1, "tokenizer: 'b c' should win in 'abc'");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testSessionTrimming() {
+    std::cout << "\n=== Test 7: Session Trimming ===\n";
+    int before = failures;
+    using Role = SessionStore::Role;
+
+    SessionStore::Limits limits;
+    limits.maxMessages = 4;
+    limits.maxBytes = 40;
+    limits.chunkSize = 16;
+    SessionStore store(1000, 4, limits);
+
+    // Only the newest maxMessages survive, and an earlier view keeps its content
+    store.appendExchange("trim", "q0", "a0");
+    SessionStore::View early;
+    check(store.view("trim", early) && early.turns().size() == 2, "session: first exchange missing");
+    for (int i = 1; i < 5; ++i) {
+        store.appendExchange("trim", "q" + std::to_string(i), "a" + std::to_string(i));
+    }
+    SessionStore::View view;
+    store.view("trim", view);
+    check(view.turns().size() == 4, "session: kept " + std::to_string(view.turns().size()) + " messages, limit 4");
+    check(!view.turns().empty() && view.turns().front().content == "q3", "session: oldest kept message is not q3");
+    check(view.lastResponse() == "a4", "session: last response is not a4");
+    check(early.turns().size() == 2 && early.turns()[0].content == "q0" && early.turns()[1].content == "a0",
+          "session: trimming changed an earlier view");
+
+    // Over maxBytes drops old messages but always keeps the newest one
+    std::string large(100, 'x');
+    store.append("trim", Role::User, large);
+    store.view("trim", view);
+    check(view.turns().size() == 1 && view.bytes() == large.size(), "session: oversized message not kept alone");
+
+    SessionStore::View missing;
+    check(!store.view("absent", missing), "session: view of an unknown session");
+    store.remove("trim");
+    check(!store.view("trim", view), "session: removed session still visible");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testSessionPaging() {
+    std::cout << "\n=== Test 8: Session Paging ===\n";
+    int before = failures;
+    using Role = SessionStore::Role;
+    SessionStore store(1000, 4);
+
+    // Pages walk all sessions newest first, each exactly once, even with updates in between
+    const int SESSIONS = 200;
+    for (int i = 0; i < SESSIONS; ++i) {
+        store.append("s" + std::to_string(i), Role::User, "hello " + std::to_string(i));
+    }
+    std::vector<int> seen(SESSIONS, 0);
+    std::vector<std::string> order;
+    uint64_t cursor = 0;
+    int pages = 0;
+    do {
+        uint64_t next = 0;
+        for (const auto& summary : store.list(cursor, 7, next)) {
+            int index = std::stoi(summary.id.substr(1));
+            ++seen[index];
+            order.push_back(summary.id);
+            check(summary.messageCount == 1 && summary.preview == "hello " + std::to_string(index),
+                  "session: wrong summary for " + summary.id);
+        }
+        cursor = next;
+        if (++pages == 3) {
+            // Touching a listed session moves it ahead of the cursor, not into a later page
+            store.append("s199", Role::Assistant, "again");
+        }
+    } while (cursor != 0 && pages < 100);
+    int wrong = 0;
+    for (int count : seen) {
+        wrong += count != 1;
+    }
+    check(wrong == 0, "session: " + std::to_string(wrong) + " sessions not listed exactly once");
+    bool newestFirst = order.size() == static_cast<size_t>(SESSIONS);
+    for (size_t i = 0; newestFirst && i < order.size(); ++i) {
+        newestFirst = order[i] == "s" + std::to_string(SESSIONS - 1 - i);
+    }
+    check(newestFirst, "session: pages are not newest first");
+
+    // Slices filled at the same time by several threads still page without gaps:
+    // an entry sharing a stamp with a page's last entry would be skipped
+    const int ENTRIES = 20000;
+    HashLruCache<int, int> cache(ENTRIES, 16);
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; ++w) {
+        writers.emplace_back([&cache, w]() {
+            for (int key = w; key < ENTRIES; key += 4) {
+                cache.put(key, key);
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    std::vector<int> listed(ENTRIES, 0);
+    uint64_t pageBefore = UINT64_MAX;
+    uint64_t lastStamp = UINT64_MAX;
+    bool ordered = true;
+    do {
+        uint64_t next = 0;
+        for (const auto& entry : cache.page<int>(pageBefore, 3, [](const int&, const int& value) { return value; }, next)) {
+            ++listed[entry.item];
+            ordered = ordered && entry.stamp < lastStamp;
+            lastStamp = entry.stamp;
+        }
+        pageBefore = next;
+    } while (pageBefore != 0);
+    int missed = 0;
+    for (int count : listed) {
+        missed += count != 1;
+    }
+    check(missed == 0, "paging: " + std::to_string(missed) + " entries not listed exactly once");
+    check(ordered, "paging: stamps repeat or go backwards across slices");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testJsonScanner() {
+    std::cout << "\n=== Test 9: JSON Scanner ===\n";
+    int before = failures;
+
+    // Skipped values contain brackets, escaped quotes and nested containers
+    const std::string reply = R"({"id":"x{\"[","meta":{"a":[1,{"b":"]"}]},"choices":[{"index":0},)"
+                              R"({"message":{"role":"assistant","content":"line\n中😀 \"q\""}}],)"
+                              R"("usage":{"total_tokens":123,"delta":-7,"ratio":1.5,"text":"12"}})";
+    JsonScanner scanner(reply);
+    std::string text;
+    check(scanner.findString({"choices", 1, "message", "content"}, text) &&
+          text == "line\n\xe4\xb8\xad\xf0\x9f\x98\x80 \"q\"", "json: nested escaped string");
+    check(scanner.findString({"id"}, text) && text == "x{\"[", "json: string with brackets");
+    int64_t number = 0;
+    check(scanner.findInt({"usage", "total_tokens"}, number) && number == 123, "json: integer");
+    check(scanner.findInt({"usage", "delta"}, number) && number == -7, "json: negative integer");
+    check(!scanner.findInt({"usage", "ratio"}, number), "json: fraction read as an integer");
+    check(!scanner.findInt({"usage", "text"}, number), "json: string read as an integer");
+    check(!scanner.findString({"usage", "total_tokens"}, text), "json: integer read as a string");
+    check(!scanner.findString({"choices", 2, "message"}, text), "json: index past the end");
+    check(!scanner.findString({"missing"}, text), "json: missing key");
+    std::string_view raw;
+    bool isString = false;
+    check(scanner.findRaw({"meta"}, raw, isString) && !isString && raw == R"({"a":[1,{"b":"]"}]})",
+          "json: raw object");
+
+    check(!JsonScanner(R"({"a":"unterminated)").findString({"a"}, text), "json: unterminated string");
+    check(!JsonScanner(R"({"a":{"b":1)").findRaw({"a"}, raw, isString), "json: unterminated object");
+    check(!JsonScanner::unescape(R"(\ud83d)", text), "json: lone surrogate accepted");
+
+    // appendEscaped output parses back to the original with both parsers
+    std::mt19937 gen(11);
+    int mismatched = 0;
+    for (int round = 0; round < 200; ++round) {
+        std::string original;
+        size_t length = gen() % 40;
+        for (size_t i = 0; i < length; ++i) {
+            const char* pool[] = {"a", " ", "\"", "\\", "\n", "\t", "\x01", "\x1f", "/", "\xc3\xa9"};
+            original += pool[gen() % 10];
+        }
+        std::string document = "{\"s\":\"";
+        JsonScanner::appendEscaped(document, original);
+        document += "\"}";
+        std::string scanned;
+        bool ok = JsonScanner(document).findString({"s"}, scanned) && scanned == original;
+        ok = ok && nlohmann::json::parse(document)["s"].get<std::string>() == original;
+        mismatched += !ok;
+    }
+    check(mismatched == 0, "json: " + std::to_string(mismatched) + " escaped strings did not round-trip");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testAdmissionShedding() {
+    std::cout << "\n=== Test 10: Admission Shedding ===\n";
+    int before = failures;
+    using Clock = AdmissionController::Clock;
+    using Decision = AdmissionController::Decision;
+    using Outcome = AdmissionController::Outcome;
+
+    AdmissionController::Options options;
+    options.initialLimit = 2;
+    options.minLimit = 1;
+    options.maxQueued = 1;
+    options.backoffRatio = 0.5;
+    options.maxWait = std::chrono::milliseconds(200);
+    AdmissionController admission(options);
+    Clock::duration retryAfter{};
+    Clock::time_point later = Clock::now() + std::chrono::seconds(5);
+
+    AdmissionController::Permit first;
+    AdmissionController::Permit second;
+    check(admission.acquire(later, first, retryAfter) == Decision::Admitted, "admission: first call rejected");
+    check(admission.acquire(later, second, retryAfter) == Decision::Admitted, "admission: second call rejected");
+
+    // A deadline of now only takes a free slot
+    AdmissionController::Permit now;
+    check(admission.acquire(Clock::now(), now, retryAfter) == Decision::DeadlineExceeded && retryAfter.count() > 0,
+          "admission: call over the limit not shed by its deadline");
+
+    // One waiter fits in the queue; the next is turned away, and the waiter gets the freed slot
+    Decision queuedDecision = Decision::QueueFull;
+    std::thread waiter([&]() {
+        AdmissionController::Permit permit;
+        Clock::duration waited{};
+        queuedDecision = admission.acquire(Clock::now() + std::chrono::seconds(5), permit, waited);
+        permit.release(Outcome::Success, std::chrono::milliseconds(1));
+    });
+    while (admission.stats().queued == 0) {
+        std::this_thread::yield();
+    }
+    AdmissionController::Permit full;
+    Clock::duration fullRetry{};
+    check(admission.acquire(later, full, fullRetry) == Decision::QueueFull, "admission: full queue accepted a call");
+    first.release(Outcome::Success, std::chrono::milliseconds(1));
+    waiter.join();
+    check(queuedDecision == Decision::Admitted, "admission: queued call not admitted on release");
+
+    // An upstream error backs the limit off to one slot, so a waiter now times out after maxWait
+    second.release(Outcome::Dropped, std::chrono::milliseconds(1));
+    check(admission.stats().limit < 2, "admission: limit did not back off on an error");
+    AdmissionController::Permit held;
+    check(admission.acquire(later, held, retryAfter) == Decision::Admitted, "admission: idle controller rejected");
+    AdmissionController::Permit late;
+    auto start = Clock::now();
+    check(admission.acquire(later, late, retryAfter) == Decision::DeadlineExceeded, "admission: waiter outlived maxWait");
+    check(Clock::now() - start >= options.maxWait, "admission: waiter gave up before maxWait");
+
+    AdmissionController::Stats stats = admission.stats();
+    check(stats.inFlight == 1 && stats.queued == 0, "admission: slots leaked");
+    check(stats.rejectedFull == 1 && stats.rejectedDeadline == 2, "admission: rejection counters");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testCircuitBreaker() {
+    std::cout << "\n=== Test 11: Circuit Breaker States ===\n";
+    int before = failures;
+    using Clock = CircuitBreaker::Clock;
+    using State = CircuitBreaker::State;
+    using std::chrono::milliseconds;
+
+    CircuitBreaker::Options options;
+    options.minCalls = 4;
+    options.openFor = milliseconds(1000);
+    options.halfOpenProbes = 2;
+    options.slowCall = milliseconds(100);
+    CircuitBreaker breaker(options);
+    Clock::time_point t = Clock::now();
+    milliseconds fast(1);
+
+    // Failures below minCalls, or that have left the window, never trip
+    for (int i = 0; i < 3; ++i) {
+        breaker.record(false, fast, t);
+    }
+    check(breaker.state() == State::Closed, "breaker: tripped below minCalls");
+    t += milliseconds(11000);
+    breaker.record(false, fast, t);
+    check(breaker.state() == State::Closed, "breaker: counted failures outside the window");
+    for (int i = 0; i < 3; ++i) {
+        breaker.record(i == 0, fast, t);
+    }
+    check(breaker.state() == State::Open, "breaker: 3 of 4 failed and it stayed closed");
+
+    Clock::duration retryAfter{};
+    check(!breaker.allow(t + milliseconds(400), retryAfter) && retryAfter == milliseconds(600),
+          "breaker: open breaker let a call through");
+
+    // After openFor, only halfOpenProbes trial calls go out; a failed one reopens
+    t += options.openFor;
+    check(breaker.allow(t) && breaker.state() == State::HalfOpen, "breaker: no probe after openFor");
+    check(breaker.allow(t), "breaker: second probe refused");
+    check(!breaker.allow(t), "breaker: more probes than halfOpenProbes");
+    breaker.record(true, fast, t);
+    breaker.record(false, fast, t);
+    check(breaker.state() == State::Open, "breaker: failed probe did not reopen");
+
+    // Probes that never report back are reissued after another openFor
+    t += options.openFor;
+    check(breaker.allow(t) && breaker.allow(t) && !breaker.allow(t), "breaker: probes after reopening");
+    check(breaker.allow(t + options.openFor), "breaker: lost probes never reissued");
+    t += options.openFor;
+    breaker.record(true, fast, t);
+    breaker.record(true, fast, t);
+    check(breaker.state() == State::Closed, "breaker: successful probes did not close it");
+    check(breaker.stats(t).calls == 0, "breaker: closed with a stale window");
+
+    // Slow successes trip it too
+    for (int i = 0; i < 4; ++i) {
+        breaker.record(true, milliseconds(200), t);
+    }
+    check(breaker.state() == State::Open, "breaker: slow calls did not trip it");
+    CircuitBreaker::Stats stats = breaker.stats(t);
+    check(stats.opened == 3 && stats.rejected == 3, "breaker: opened " + std::to_string(stats.opened) +
+          ", rejected " + std::to_string(stats.rejected));
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testThreadCacheInvalidation() {
+    std::cout << "\n=== Test 12: L1 Invalidation ===\n";
+    int before = failures;
+
+    // A fill that raced with a write carries the old epoch and is never served
+    ThreadCache<int, int> l1;
+    l1.setEntries(16);
+    std::shared_ptr<const int> value;
+    l1.fill(5, l1.epochOf(5), std::make_shared<const int>(50));
+    check(l1.get(5, value) && *value == 50, "l1: filled entry missed");
+    l1.invalidate(5);
+    check(!l1.get(5, value), "l1: invalidated entry served");
+    uint64_t epoch = l1.epochOf(6);
+    l1.invalidate(6);
+    l1.fill(6, epoch, std::make_shared<const int>(60));
+    check(!l1.get(6, value), "l1: fill with a stale epoch served");
+    l1.setEntries(0);
+    check(!l1.enabled() && !l1.get(5, value), "l1: disabled cache served an entry");
+
+    // Readers never see a key go back to an older version, and all see the last write
+    const int KEYS = 8;
+    const int VERSIONS = 20000;
+    HashLfuCache<int, int> cache(1000, 4);
+    cache.enableThreadCache(64);
+    for (int key = 0; key < KEYS; ++key) {
+        cache.put(key, 0);
+    }
+    std::atomic<bool> writing{true};
+    std::atomic<int> backwards{0};
+    std::atomic<int> stale{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]() {
+            std::vector<int> seen(KEYS, 0);
+            while (writing.load()) {
+                for (int key = 0; key < KEYS; ++key) {
+                    int version = -1;
+                    if (cache.get(key, version)) {
+                        backwards += version < seen[key];
+                        seen[key] = std::max(seen[key], version);
+                    }
+                }
+            }
+            for (int key = 0; key < KEYS; ++key) {
+                int version = -1;
+                stale += !cache.get(key, version) || version != VERSIONS;
+            }
+        });
+    }
+    for (int version = 1; version <= VERSIONS; ++version) {
+        cache.put(version % KEYS, version);
+    }
+    for (int key = 0; key < KEYS; ++key) {
+        cache.put(key, VERSIONS);
+    }
+    writing = false;
+    for (auto& t : readers) {
+        t.join();
+    }
+    check(backwards == 0, "l1: " + std::to_string(backwards.load()) + " reads went back to an older version");
+    check(stale == 0, "l1: " + std::to_string(stale.load()) + " reads missed the last write");
+
+    // Hits are flushed to the stats every few hundred accesses
+    uint64_t hitsBefore = cache.threadCacheStats().hits;
+    for (int i = 0; i < 300; ++i) {
+        int version = -1;
+        cache.get(0, version);
+    }
+    check(cache.threadCacheStats().hits > hitsBefore, "l1: repeated reads never hit");
+
+    cache.purge();
+    int left = 0;
+    check(!cache.get(0, left), "l1: entry served after purge");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
+void testHotKeyPromotion() {
+    std::cout << "\n=== Test 13: Hot-Key Promotion and Demotion ===\n";
+    int before = failures;
+    const int KEYS = 1000;
+    HashLfuCache<int, int> cache(KEYS * 2, 4);
+    cache.enableHotKeys(4);
+    for (int key = 1; key <= KEYS; ++key) {
+        cache.put(key, key);
+    }
+
+    // One key taking most of the traffic is promoted and then served from the replicas
+    std::mt19937 gen(5);
+    int wrong = 0;
+    for (int i = 0; i < 100000; ++i) {
+        int key = gen() % 4 == 0 ? 1 + gen() % KEYS : 7;
+        int value = 0;
+        wrong += !cache.get(key, value) || value != key;
+    }
+    auto stats = cache.hotKeyStats();
+    check(stats.hot == 1 && stats.promoted == 1, "hot keys: " + std::to_string(stats.hot) + " hot after a skewed load");
+    check(stats.replicaHits > 0, "hot keys: the hot key was never read from a replica");
+
+    // A write reaches readers of the replicas at once
+    cache.put(7, 70);
+    int value = 0;
+    check(cache.get(7, value) && value == 70, "hot keys: replica served a value older than the last write");
+    cache.put(7, 7);
+
+    // Once the traffic spreads out, the key is demoted
+    for (int i = 0; i < 200000; ++i) {
+        int key = 1 + gen() % KEYS;
+        wrong += !cache.get(key, value) || value != key;
+    }
+    stats = cache.hotKeyStats();
+    check(stats.hot == 0 && stats.demoted == 1, "hot keys: " + std::to_string(stats.hot) + " still hot after a uniform load");
+    check(wrong == 0, "hot keys: " + std::to_string(wrong) + " reads returned a wrong value");
+    std::cout << (failures == before ? "passed" : "FAILED") << "\n";
+}
+
 int main() {
     testHotDataAccess();
     testLoopPattern();
     testWorkloadShift();
-    return 0;
+    testResizeAndReshard();
+    testCoreRouter();
+    testTokenizer();
+    testSessionTrimming();
+    testSessionPaging();
+    testJsonScanner();
+    testAdmissionShedding();
+    testCircuitBreaker();
+    testThreadCacheInvalidation();
+    testHotKeyPromotion();
+    return failures == 0 ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+#include "jsonScanner.h"
+#include "usageAccounting.h"
+
+// Cache response structure. The reply is also kept pre-serialized, so a hit
+// only splices the (escaped) conversationId into body at `splice`.
+struct CachedResponse {
+    std::string content;
+    std::string role;
+    std::string body;       // {"conversationId":"","content":"...","role":"..."}
+    size_t splice = 0;
+    std::chrono::steady_clock::time_point storedAt;
+    UsageSample usage;      // what the upstream call cost; credited as avoided on every hit
+};
+
+inline CachedResponse makeCachedResponse(std::string content, std::string role) {
+    CachedResponse cached;
+    cached.body.reserve(content.size() + role.size() + 64);
+    cached.body.append("{\"conversationId\":\"");
+    cached.splice = cached.body.size();
+    cached.body.append("\",\"content\":\"");
+    JsonScanner::appendEscaped(cached.body, content);
+    cached.body.append("\",\"role\":\"");
+    JsonScanner::appendEscaped(cached.body, role);
+    cached.body.append("\"}");
+    cached.content = std::move(content);
+    cached.role = std::move(role);
+    cached.storedAt = std::chrono::steady_clock::now();
+    return cached;
+}
+
+inline void renderCachedResponse(const CachedResponse& cached, const std::string& conversationId, std::string& out) {
+    out.clear();
+    out.reserve(cached.body.size() + conversationId.size() + 8);
+    out.append(cached.body, 0, cached.splice);
+    JsonScanner::appendEscaped(out, conversationId);
+    out.append(cached.body, cached.splice, std::string::npos);
+}
+
+// Pull message and conversationId out of a request body without building a DOM;
+// falls back to nlohmann::json for anything the scanner doesn't handle
+inline void parseMessageRequest(const std::string& body, std::string& message, std::string& conversationId) {
+    JsonScanner scanner(body);
+    if (scanner.findString({"message"}, message)) {
+        std::string_view raw;
+        bool is_string = false;
+        if (!scanner.findRaw({"conversationId"}, raw, is_string)) {
+            conversationId.clear();
+            return;
+        }
+        if (is_string && JsonScanner::unescape(raw, conversationId)) {
+            return;
+        }
+    }
+
+    auto json = nlohmann::json::parse(body);
+    message = json["message"];
+    conversationId = json.value("conversationId", "");
+}
+
+// Extract the reply from http_server's response body, same rules as before:
+// "content" (+ "role"), else "response", else a placeholder
+inline void parseUpstreamReply(const std::string& body, std::string& reply, std::string& role) {
+    JsonScanner scanner(body);
+    std::string_view raw;
+    bool is_string = false;
+    if (scanner.findRaw({"content"}, raw, is_string) && is_string && JsonScanner::unescape(raw, reply)) {
+        if (!scanner.findString({"role"}, role)) {
+            role = "assistant";
+        }
+        return;
+    }
+    if (!scanner.findRaw({"content"}, raw, is_string) &&
+        scanner.findRaw({"response"}, raw, is_string) && is_string && JsonScanner::unescape(raw, reply)) {
+        role = "assistant";
+        return;
+    }
+
+    auto response_json = nlohmann::json::parse(body);
+    if (response_json.contains("content") && !response_json["content"].is_null()) {
+        reply = response_json["content"];
+        role = response_json.value("role", "assistant");
+    } else if (response_json.contains("response") && !response_json["response"].is_null()) {
+        reply = response_json["response"];
+        role = "assistant";
+    } else {
+        reply = "(No valid content from main server)";
+        role = "assistant";
+    }
+}
+
+// Token usage http_server reports next to the reply; zeros if absent
+inline void parseUpstreamUsage(const std::string& body, UsageSample& usage) {
+    std::string_view raw;
+    bool is_string = false;
+    if (!JsonScanner(body).findRaw({"usage"}, raw, is_string) || is_string) {
+        return;
+    }
+    JsonScanner scanner(raw);
+    int64_t value;
+    if (scanner.findInt({"prompt_tokens"}, value) && value > 0) {
+        usage.promptTokens = static_cast<uint64_t>(value);
+    }
+    if (scanner.findInt({"prompt_cache_hit_tokens"}, value) && value > 0) {
+        usage.cacheHitTokens = static_cast<uint64_t>(value);
+    }
+    if (scanner.findInt({"completion_tokens"}, value) && value > 0) {
+        usage.completionTokens = static_cast<uint64_t>(value);
+    }
+}
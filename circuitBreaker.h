@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+struct CircuitBreakerOptions {
+    std::chrono::milliseconds window{10000};        // rolling window the rates are taken over
+    size_t minCalls = 20;                           // fewer calls in the window never trip
+    double failureRate = 0.5;
+    std::chrono::milliseconds slowCall{20000};      // successes slower than this count as slow
+    double slowRate = 0.8;
+    std::chrono::milliseconds openFor{5000};
+    int halfOpenProbes = 3;                         // trial calls; all must succeed to close
+};
+
+// Thrown (or reported) instead of calling a backend whose breaker is open
+class CircuitOpenError : public std::runtime_error {
+public:
+    CircuitOpenError(const std::string& what, std::chrono::steady_clock::duration retryAfter)
+        : std::runtime_error(what), retryAfter_(retryAfter) {}
+    std::chrono::steady_clock::duration retryAfter() const { return retryAfter_; }
+
+private:
+    std::chrono::steady_clock::duration retryAfter_;
+};
+
+// Per-backend circuit breaker.
+//
+// Closed: calls go through and their outcome lands in a ring of buckets covering
+// `window`. Once the window holds minCalls calls and either the failure rate or
+// the slow-call rate reaches its threshold, the breaker opens: calls are refused
+// for openFor, then up to halfOpenProbes trial calls are let through (half-open).
+// A failed probe opens it again; halfOpenProbes successes close it with an
+// empty window.
+class CircuitBreaker {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Options = CircuitBreakerOptions;
+
+    enum class State { Closed, Open, HalfOpen };
+
+    struct Stats {
+        State state;
+        uint64_t calls;             // in the window
+        uint64_t failures;
+        uint64_t slow;
+        uint64_t opened;            // times the breaker tripped
+        uint64_t rejected;          // calls refused while open
+    };
+
+    explicit CircuitBreaker(const Options& options = Options())
+        : options_(options)
+        , state_(State::Closed)
+        , probesIssued_(0)
+        , probesSucceeded_(0)
+        , opened_(0)
+        , rejected_(0)
+    {
+        bucketSpan_ = std::max<Clock::duration>(options_.window / kBuckets, std::chrono::milliseconds(1));
+    }
+
+    // May a call go out now? If not, retryAfter is how long the breaker stays open.
+    bool allow(Clock::time_point now, Clock::duration& retryAfter) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ == State::Open) {
+            if (now < openUntil_) {
+                retryAfter = openUntil_ - now;
+                ++rejected_;
+                return false;
+            }
+            state_ = State::HalfOpen;
+            probesIssued_ = 0;
+            probesSucceeded_ = 0;
+            halfOpenSince_ = now;
+        }
+        if (state_ == State::HalfOpen) {
+            // Probes whose outcome never came back are reissued after another openFor
+            if (probesIssued_ >= options_.halfOpenProbes && now - halfOpenSince_ >= options_.openFor) {
+                probesIssued_ = probesSucceeded_;
+                halfOpenSince_ = now;
+            }
+            if (probesIssued_ >= options_.halfOpenProbes) {
+                retryAfter = options_.openFor;
+                ++rejected_;
+                return false;
+            }
+            ++probesIssued_;
+        }
+        return true;
+    }
+
+    bool allow(Clock::time_point now) {
+        Clock::duration retryAfter;
+        return allow(now, retryAfter);
+    }
+
+    // Outcome of a call that allow() let through
+    void record(bool success, Clock::duration latency, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool slow = success && latency >= options_.slowCall;
+        if (state_ == State::HalfOpen) {
+            if (!success || slow) {
+                trip(now);
+            } else if (++probesSucceeded_ >= options_.halfOpenProbes) {
+                state_ = State::Closed;
+                buckets_.fill(Bucket());
+            }
+            return;
+        }
+        if (state_ == State::Open) {
+            return;     // a call that started before the breaker opened
+        }
+
+        Bucket& bucket = current(now);
+        ++bucket.calls;
+        bucket.failures += success ? 0 : 1;
+        bucket.slow += slow ? 1 : 0;
+
+        Bucket sum = total(now);
+        if (sum.calls >= options_.minCalls &&
+            (sum.failures >= options_.failureRate * sum.calls || sum.slow >= options_.slowRate * sum.calls)) {
+            trip(now);
+        }
+    }
+
+    State state() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return state_;
+    }
+
+    Stats stats(Clock::time_point now) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Bucket sum = total(now);
+        return {state_, sum.calls, sum.failures, sum.slow, opened_, rejected_};
+    }
+
+    static const char* stateName(State state) {
+        switch (state) {
+        case State::Open: return "open";
+        case State::HalfOpen: return "half_open";
+        default: return "closed";
+        }
+    }
+
+private:
+    static constexpr size_t kBuckets = 10;
+
+    struct Bucket {
+        int64_t slot = -1;      // which span of bucketSpan_ the counts belong to
+        uint64_t calls = 0;
+        uint64_t failures = 0;
+        uint64_t slow = 0;
+    };
+
+    int64_t slotOf(Clock::time_point now) const {
+        return now.time_since_epoch() / bucketSpan_;
+    }
+
+    Bucket& current(Clock::time_point now) {
+        int64_t slot = slotOf(now);
+        Bucket& bucket = buckets_[static_cast<size_t>(slot) % kBuckets];
+        if (bucket.slot != slot) {
+            bucket = Bucket();
+            bucket.slot = slot;
+        }
+        return bucket;
+    }
+
+    Bucket total(Clock::time_point now) const {
+        int64_t slot = slotOf(now);
+        Bucket sum;
+        for (const Bucket& bucket : buckets_) {
+            if (bucket.slot > slot - static_cast<int64_t>(kBuckets) && bucket.slot <= slot) {
+                sum.calls += bucket.calls;
+                sum.failures += bucket.failures;
+                sum.slow += bucket.slow;
+            }
+        }
+        return sum;
+    }
+
+    void trip(Clock::time_point now) {
+        state_ = State::Open;
+        openUntil_ = now + options_.openFor;
+        ++opened_;
+        buckets_.fill(Bucket());
+    }
+
+    Options options_;
+    Clock::duration bucketSpan_;
+    mutable std::mutex mutex_;
+    State state_;
+    std::array<Bucket, kBuckets> buckets_;
+    Clock::time_point openUntil_;
+    Clock::time_point halfOpenSince_;
+    int probesIssued_;
+    int probesSucceeded_;
+    uint64_t opened_;
+    uint64_t rejected_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+// Minimal "--name=value" / "--flag" command line parser shared by the servers.
+class CommandLine {
+public:
+    CommandLine(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0) {
+                continue;
+            }
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                options_[arg.substr(2)] = "true";
+            } else {
+                options_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    bool has(const std::string& name) const {
+        return options_.count(name) > 0;
+    }
+
+    std::string get(const std::string& name, const std::string& fallback) const {
+        auto it = options_.find(name);
+        return it != options_.end() ? it->second : fallback;
+    }
+
+    long long getInt(const std::string& name, long long fallback) const {
+        auto it = options_.find(name);
+        return it != options_.end() ? std::strtoll(it->second.c_str(), nullptr, 10) : fallback;
+    }
+
+    double getDouble(const std::string& name, double fallback) const {
+        auto it = options_.find(name);
+        return it != options_.end() ? std::strtod(it->second.c_str(), nullptr) : fallback;
+    }
+
+    bool getBool(const std::string& name, bool fallback) const {
+        auto it = options_.find(name);
+        if (it == options_.end()) {
+            return fallback;
+        }
+        return it->second == "true" || it->second == "1" || it->second == "yes";
+    }
+
+private:
+    std::map<std::string, std::string> options_;
+};
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// Bounded single-producer/single-consumer ring. Head and tail sit on their own
+// cache lines, and each side keeps a private copy of the other's index, so a
+// push or pop only reads the other side's line when the ring looks full or empty.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : mask_(roundUp(capacity) - 1)
+        , slots_(mask_ + 1)
+    {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side
+    bool tryPush(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool tryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) {
+                return false;
+            }
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; a snapshot
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const size_t mask_;
+    std::vector<T> slots_;
+    alignas(64) std::atomic<size_t> head_{0};   // written by the consumer
+    size_t tailCache_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};   // written by the producer
+    size_t headCache_ = 0;
+};
+
+// Thread-per-core message passing.
+//
+// One owner thread per CPU, pinned to it. Data partitioned by core (e.g. cache
+// slices) is only touched while holding that core's exclusion. While the router
+// runs, only the threads pinned to the core and its owner take it, so its cache
+// line never leaves the core. run(core, fn) executes fn there:
+//
+// - called from a thread pinned to that core, fn runs inline;
+// - called from a thread pinned to another core A, the call goes over the SPSC
+//   ring A->core (A's threads take turns as its single producer), the target's
+//   owner runs it and wakes the caller;
+// - threads not pinned to one of the CPUs (admin, background refresh) post to
+//   the target's inbox instead.
+//
+// An idle owner parks on a condition variable; senders wake it only when it is
+// parked. A waiting caller spins briefly before it blocks, since a remote call
+// usually finishes within a few microseconds.
+class CoreRouter {
+public:
+    struct CoreStats {
+        int cpu;
+        uint64_t local;         // calls run inline by threads pinned here
+        uint64_t forwarded;     // calls this core's threads sent to other cores
+        uint64_t served;        // calls this core's owner ran for other threads
+        uint64_t backlogged;    // forwards that found the ring full and had to wait
+    };
+
+    // One owner per entry of cpus; queueDepth slots per ring (one ring per pair of cores)
+    explicit CoreRouter(const std::vector<int>& cpus, size_t queueDepth = 1024)
+        : id_(nextId().fetch_add(1, std::memory_order_relaxed))
+        , running_(false)
+    {
+        for (int cpu : cpus) {
+            cores_.emplace_back(new Core());
+            cores_.back()->cpu = cpu;
+        }
+        for (auto& core : cores_) {
+            for (size_t i = 0; i < cores_.size(); ++i) {
+                core->from.emplace_back(new SpscQueue<Call*>(queueDepth));
+            }
+        }
+    }
+
+    CoreRouter(const CoreRouter&) = delete;
+    CoreRouter& operator=(const CoreRouter&) = delete;
+
+    ~CoreRouter() {
+        stop();
+    }
+
+    void start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        for (size_t i = 0; i < cores_.size(); ++i) {
+            cores_[i]->owner = std::thread([this, i]() { loop(i); });
+        }
+    }
+
+    // Finishes the calls already posted, then joins the owners. Callers must
+    // have stopped issuing calls.
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        for (auto& core : cores_) {
+            wake(*core);
+        }
+        for (auto& core : cores_) {
+            if (core->owner.joinable()) {
+                core->owner.join();
+            }
+        }
+    }
+
+    size_t cores() const { return cores_.size(); }
+
+    // Index of the core the calling thread is pinned to; -1 if it may run on
+    // more than one CPU or on a CPU we don't own. Cached per thread.
+    int currentCore() const {
+        thread_local uint64_t cachedFor = 0;
+        thread_local int cached = -1;
+        if (cachedFor != id_) {
+            cached = lookupCore();
+            cachedFor = id_;
+        }
+        return cached;
+    }
+
+    // Run fn with core's exclusion held and wait for it; exceptions are rethrown
+    // here. fn must not call run() itself. When the router isn't running, fn runs
+    // inline on any thread, still under the exclusion.
+    template <typename F>
+    void run(size_t core, F&& fn) {
+        using Fn = std::remove_reference_t<F>;
+        int origin = currentCore();
+        Core& target = *cores_[core];
+        if (origin == static_cast<int>(core) || !running_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(target.exclusive);
+            bump(target.local);
+            fn();
+            return;
+        }
+
+        thread_local Waiter waiter;
+        waiter.done.store(false, std::memory_order_relaxed);
+        Call call;
+        call.invoke = [](void* f) { (*static_cast<Fn*>(f))(); };
+        call.fn = const_cast<void*>(static_cast<const void*>(std::addressof(fn)));
+        call.waiter = &waiter;
+
+        if (origin >= 0) {
+            Core& source = *cores_[origin];
+            std::unique_lock<std::mutex> lock(source.sendMutex);
+            bump(source.forwarded);
+            if (!target.from[origin]->tryPush(&call)) {
+                bump(source.backlogged);
+                do {
+                    // Let the target drain, and the core's other threads run meanwhile
+                    lock.unlock();
+                    wake(target);
+                    std::this_thread::yield();
+                    lock.lock();
+                } while (!target.from[origin]->tryPush(&call));
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(target.inboxMutex);
+            target.inbox.push_back(&call);
+        }
+        wake(target);
+
+        for (int spin = 0; spin < kWaitSpins && !waiter.done.load(std::memory_order_acquire); ++spin) {
+            std::this_thread::yield();
+        }
+        // Taken even when the spin saw done: the owner may still be inside
+        // complete(), and the waiter must not be reused before it leaves
+        std::unique_lock<std::mutex> lock(waiter.mutex);
+        waiter.cv.wait(lock, [&]() { return waiter.done.load(std::memory_order_relaxed); });
+        lock.unlock();
+        if (call.error) {
+            std::rethrow_exception(call.error);
+        }
+    }
+
+    std::vector<CoreStats> stats() const {
+        std::vector<CoreStats> out;
+        for (auto& core : cores_) {
+            out.push_back({core->cpu, core->local.load(std::memory_order_relaxed),
+                           core->forwarded.load(std::memory_order_relaxed),
+                           core->served.load(std::memory_order_relaxed),
+                           core->backlogged.load(std::memory_order_relaxed)});
+        }
+        return out;
+    }
+
+    // Pin the calling thread to cpu. Threads it creates afterwards inherit the pin.
+    static bool pinThread(int cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    // CPUs this process may run on, lowest first
+    static std::vector<int> availableCpus() {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+            return cpus;
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+private:
+    static constexpr int kIdleSpins = 16;
+    static constexpr int kWaitSpins = 64;
+
+    struct Waiter {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<bool> done{false};
+    };
+
+    struct Call {
+        void (*invoke)(void*);
+        void* fn;
+        Waiter* waiter;
+        std::exception_ptr error;
+    };
+
+    // Counters are written under a lock (exclusive, sendMutex) or by the owner only
+    static void bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    struct alignas(64) Core {
+        int cpu = -1;
+        std::thread owner;
+        std::mutex exclusive;                                   // held while this core's data is touched
+        std::mutex sendMutex;                                   // threads pinned here, as producer of from[me] rings
+        std::mutex inboxMutex;                                  // unpinned threads
+        std::vector<Call*> inbox;
+        std::vector<std::unique_ptr<SpscQueue<Call*>>> from;    // from[i]: ring core i -> this core
+        std::mutex parkMutex;
+        std::condition_variable park;
+        std::atomic<bool> parked{false};
+        std::atomic<uint64_t> local{0};
+        std::atomic<uint64_t> forwarded{0};
+        std::atomic<uint64_t> served{0};
+        std::atomic<uint64_t> backlogged{0};
+    };
+
+    static std::atomic<uint64_t>& nextId() {
+        static std::atomic<uint64_t> id{1};
+        return id;
+    }
+
+    int lookupCore() const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0 || CPU_COUNT(&set) != 1) {
+            return -1;
+        }
+        for (size_t i = 0; i < cores_.size(); ++i) {
+            if (CPU_ISSET(cores_[i]->cpu, &set)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void wake(Core& core) {
+        // Pairs with the fence in park(): either we see it parked, or it sees our call
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (core.parked.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(core.parkMutex);
+            core.park.notify_one();
+        }
+    }
+
+    static void execute(Call* call) {
+        try {
+            call->invoke(call->fn);
+        } catch (...) {
+            call->error = std::current_exception();
+        }
+    }
+
+    static void complete(Call* call) {
+        // Set and notify under the lock: once the caller holds it and sees done,
+        // it may return, and the call (on its stack) is gone
+        Waiter* waiter = call->waiter;
+        std::lock_guard<std::mutex> lock(waiter->mutex);
+        waiter->done.store(true, std::memory_order_release);
+        waiter->cv.notify_one();
+    }
+
+    bool hasWork(size_t me) {
+        Core& core = *cores_[me];
+        {
+            std::lock_guard<std::mutex> lock(core.inboxMutex);
+            if (!core.inbox.empty()) {
+                return true;
+            }
+        }
+        for (auto& ring : core.from) {
+            if (!ring->empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void park(size_t me) {
+        Core& core = *cores_[me];
+        std::unique_lock<std::mutex> lock(core.parkMutex);
+        core.parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasWork(me) && running_.load(std::memory_order_relaxed)) {
+            core.park.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        core.parked.store(false, std::memory_order_relaxed);
+    }
+
+    void loop(size_t me) {
+        Core& core = *cores_[me];
+        pinThread(core.cpu);
+        std::vector<Call*> batch;
+        std::vector<Call*> inbox;
+        int idle = 0;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(core.inboxMutex);
+                inbox.swap(core.inbox);
+            }
+            batch.insert(batch.end(), inbox.begin(), inbox.end());
+            inbox.clear();
+            for (auto& ring : core.from) {
+                Call* call;
+                while (ring->tryPop(call)) {
+                    batch.push_back(call);
+                }
+            }
+
+            if (!batch.empty()) {
+                // One hold of the exclusion for the whole batch
+                {
+                    std::lock_guard<std::mutex> lock(core.exclusive);
+                    for (Call* call : batch) {
+                        execute(call);
+                    }
+                    core.served.store(core.served.load(std::memory_order_relaxed) + batch.size(),
+                                      std::memory_order_relaxed);
+                }
+                for (Call* call : batch) {
+                    complete(call);
+                }
+                batch.clear();
+                idle = 0;
+            } else if (!running_.load(std::memory_order_acquire) && !hasWork(me)) {
+                break;
+            } else if (++idle < kIdleSpins) {
+                std::this_thread::yield();
+            } else {
+                park(me);
+            }
+        }
+    }
+
+    const uint64_t id_;
+    std::vector<std::unique_ptr<Core>> cores_;
+    std::atomic<bool> running_;
+};
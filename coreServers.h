@@ -0,0 +1,115 @@
+#pragma once
+
+#include <httplib.h>
+#include <sys/socket.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "coreRouter.h"
+
+// Routes registered once and mounted on any number of servers
+class RouteSet {
+public:
+    RouteSet& Get(const std::string& pattern, httplib::Server::Handler handler) {
+        routes_.push_back({false, pattern, std::move(handler)});
+        return *this;
+    }
+
+    RouteSet& Post(const std::string& pattern, httplib::Server::Handler handler) {
+        routes_.push_back({true, pattern, std::move(handler)});
+        return *this;
+    }
+
+    void mount(httplib::Server& svr) const {
+        for (const auto& route : routes_) {
+            if (route.post) {
+                svr.Post(route.pattern, route.handler);
+            } else {
+                svr.Get(route.pattern, route.handler);
+            }
+        }
+    }
+
+private:
+    struct Route {
+        bool post;
+        std::string pattern;
+        httplib::Server::Handler handler;
+    };
+
+    std::vector<Route> routes_;
+};
+
+// Thread-per-core serving: one httplib::Server per CPU, all listening on the
+// same port with SO_REUSEPORT, so the kernel spreads connections over them.
+// Each server's accept thread pins itself to its CPU before creating its
+// worker pool, and the workers inherit the pin, so a connection is handled
+// start to finish on one core.
+class CoreServers {
+public:
+    CoreServers(std::vector<int> cpus, int workersPerCore)
+        : cpus_(std::move(cpus))
+        , workersPerCore_(workersPerCore > 0 ? workersPerCore : 1)
+        , stopped_(false)
+    {}
+
+    CoreServers(const CoreServers&) = delete;
+    CoreServers& operator=(const CoreServers&) = delete;
+
+    // setup registers the routes on each server. Blocks until stop(); false if
+    // the port can't be bound.
+    bool listen(const std::string& host, int port, const std::function<void(httplib::Server&)>& setup) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) {
+                return true;
+            }
+            for (size_t i = 0; i < cpus_.size(); ++i) {
+                auto svr = std::make_unique<httplib::Server>();
+                setup(*svr);
+                svr->set_socket_options([](socket_t sock) {
+                    int yes = 1;
+                    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+                    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+                });
+                int workers = workersPerCore_;
+                svr->new_task_queue = [workers]() { return new httplib::ThreadPool(workers); };
+                if (!svr->bind_to_port(host, port)) {
+                    servers_.clear();
+                    return false;
+                }
+                servers_.push_back(std::move(svr));
+            }
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < servers_.size(); ++i) {
+            threads.emplace_back([this, i]() {
+                CoreRouter::pinThread(cpus_[i]);
+                servers_[i]->listen_after_bind();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return true;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        for (auto& svr : servers_) {
+            svr->stop();
+        }
+    }
+
+private:
+    std::vector<int> cpus_;
+    int workersPerCore_;
+    std::mutex mutex_;
+    bool stopped_;
+    std::vector<std::unique_ptr<httplib::Server>> servers_;
+};
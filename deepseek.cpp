@@ -1,18 +1,142 @@
 #include "deepseek.h"
+#include "tokenizer.h"
+#include "jsonScanner.h"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <chrono>
-#include <regex>
+#include <stdexcept>
+#include <strings.h>
 
-DeepSeekChat::DeepSeekChat(const std::string& apiKey) : apiKey_(apiKey) {
+// One logical request: owns the body and the result, outlives its attempts.
+// Only touched on the I/O thread once submitted.
+struct DeepSeekChat::Call {
+    std::string request;
+    std::promise<Completion> promise;
+    Callback callback;
+    Clock::time_point deadline = Clock::time_point::max();
+    int attempts = 0;
+    bool done = false;
+    std::vector<CURL*> live;        // attempts still in flight
+    std::exception_ptr lastError;
+
+    void fail(std::exception_ptr error) {
+        done = true;
+        if (callback) {
+            callback(error, Completion());
+        } else {
+            promise.set_exception(error);
+        }
+    }
+
+    void succeed(Completion completion) {
+        done = true;
+        if (callback) {
+            callback(nullptr, std::move(completion));
+        } else {
+            promise.set_value(std::move(completion));
+        }
+    }
+};
+
+// One HTTP attempt of a call. CURLOPT_POSTFIELDS does not copy, so the body
+// stays in the Call, which the attempt keeps alive.
+struct DeepSeekChat::Transfer {
+    CURL* easy = nullptr;
+    std::shared_ptr<Call> call;
+    std::string response;
+    Clock::time_point started;
+    bool hedge = false;
+
+    ~Transfer() {
+        if (easy) {
+            curl_easy_cleanup(easy);
+        }
+    }
+};
+
+namespace {
+
+std::exception_ptr shuttingDown() {
+    return std::make_exception_ptr(std::runtime_error("DeepSeek client is shutting down"));
+}
+
+// Larger Content-Length values are not trusted for the up-front reservation
+const size_t kMaxReserve = 16 * 1024 * 1024;
+
+bool readUsage(std::string_view json, const char* field, int& out) {
+    int64_t value;
+    if (!JsonScanner(json).findInt({field}, value)) {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+}
+
+}
+
+DeepSeekChat::DeepSeekChat(const std::string& apiKey, const DeepSeekRetryOptions& options,
+                           const DeepSeekPromptOptions& prompt)
+    : apiKey_(apiKey)
+    , options_(options)
+    , prompt_(prompt)
+    , headers_(nullptr)
+    , running_(true)
+    , retryTokens_(options.retryBudgetBurst)
+    , successes_(0)
+    , rng_(std::random_device{}())
+    , breaker_(options.breaker)
+    , calls_(0)
+    , attempts_(0)
+    , retries_(0)
+    , hedges_(0)
+    , hedgesWon_(0)
+    , budgetExhausted_(0)
+    , failures_(0)
+    , hedgeDelayMs_(0)
+    , promptTokens_(0)
+    , completionTokens_(0)
+    , cacheHitTokens_(0)
+    , cacheMissTokens_(0)
+    , trimmedMessages_(0)
+{
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl_ = curl_easy_init();
+
+    // Everything before the history is the same for every request
+    requestPrefix_ = "{\"model\":\"deepseek-chat\",\"stream\":false,\"messages\":[{\"role\":\"system\",\"content\":\"";
+    JsonScanner::appendEscaped(requestPrefix_, prompt_.systemPrompt);
+    requestPrefix_ += "\"}";
+
+    // Built once; every transfer points at the same list
+    headers_ = curl_slist_append(headers_, "Content-Type: application/json");
+    std::string authHeader = "Authorization: Bearer " + apiKey_;
+    headers_ = curl_slist_append(headers_, authHeader.c_str());
+
+    // DNS answers and TLS sessions are reused by every transfer
+    share_ = curl_share_init();
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &DeepSeekChat::lockShared);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &DeepSeekChat::unlockShared);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    multi_ = curl_multi_init();
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    // Without HTTP/2 this caps the connection pool to the API host
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, 16L);
+
+    ioThread_ = std::thread(&DeepSeekChat::ioLoop, this);
 }
 
 DeepSeekChat::~DeepSeekChat() {
-    if (curl_) {
-        curl_easy_cleanup(curl_);
+    running_ = false;
+    curl_multi_wakeup(multi_);
+    if (ioThread_.joinable()) {
+        ioThread_.join();
     }
+    curl_multi_cleanup(multi_);
+    curl_share_cleanup(share_);
+    curl_slist_free_all(headers_);
     curl_global_cleanup();
 }
 
@@ -22,69 +146,460 @@ size_t DeepSeekChat::WriteCallback(void* contents, size_t size, size_t nmemb, st
     return realsize;
 }
 
-std::string DeepSeekChat::sendRequest(const std::string& url, const std::string& data) {
-    if (!curl_) {
-        throw std::runtime_error("CURL not initialized");
+// Reserves the response buffer once when the server announces the body size
+size_t DeepSeekChat::HeaderCallback(char* buffer, size_t size, size_t nitems, std::string* userp) {
+    size_t length = size * nitems;
+    static const char kName[] = "content-length:";
+    const size_t nameLength = sizeof(kName) - 1;
+    if (length > nameLength && strncasecmp(buffer, kName, nameLength) == 0) {
+        size_t value = 0;
+        for (size_t i = nameLength; i < length && value <= kMaxReserve; ++i) {
+            if (buffer[i] >= '0' && buffer[i] <= '9') {
+                value = value * 10 + (buffer[i] - '0');
+            } else if (buffer[i] != ' ' && buffer[i] != '\t') {
+                break;
+            }
+        }
+        if (value > 0 && value <= kMaxReserve) {
+            userp->reserve(value);
+        }
     }
+    return length;
+}
 
-    std::string response;
-    curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response);
-    
-    // Set POST data
-    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, data.c_str());
-    
-    // Set request headers
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string authHeader = "Authorization: Bearer " + apiKey_;
-    headers = curl_slist_append(headers, authHeader.c_str());
-    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
+void DeepSeekChat::lockShared(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+    static_cast<DeepSeekChat*>(userp)->shareMutexes_[data].lock();
+}
 
-    // Set POST method
-    curl_easy_setopt(curl_, CURLOPT_POST, 1L);
+void DeepSeekChat::unlockShared(CURL*, curl_lock_data data, void* userp) {
+    static_cast<DeepSeekChat*>(userp)->shareMutexes_[data].unlock();
+}
 
-    CURLcode res = curl_easy_perform(curl_);
-    curl_slist_free_all(headers);
+size_t DeepSeekChat::trimStart(const std::vector<Message>& history, size_t fixedTokens, size_t budget, size_t step) {
+    // Per-message overhead of the chat template, roughly
+    const size_t kMessageOverhead = 4;
+    size_t total = fixedTokens;
+    for (const auto& message : history) {
+        total += Tokenizer::estimate(message.content) + kMessageOverhead;
+    }
 
-    if (res != CURLE_OK) {
-        throw std::runtime_error("CURL request failed: " + std::string(curl_easy_strerror(res)));
+    size_t start = 0;
+    while (start < history.size() && total > budget) {
+        total -= Tokenizer::estimate(history[start].content) + kMessageOverhead;
+        ++start;
+    }
+    // Round the cut up to a block boundary so it stays put for the next few turns
+    if (start > 0 && step > 1) {
+        start = std::min(history.size(), (start + step - 1) / step * step);
     }
+    // The kept history must open with a user turn
+    while (start < history.size() && history[start].role != "user") {
+        ++start;
+    }
+    return start;
+}
 
-    return response;
+std::string DeepSeekChat::buildRequest(const std::vector<Message>& history, const std::string& content) {
+    size_t fixedTokens = Tokenizer::estimate(prompt_.systemPrompt) + Tokenizer::estimate(content) + 8;
+    size_t start = trimStart(history, fixedTokens, prompt_.contextTokens, prompt_.trimStep);
+    trimmedMessages_ += start;
+
+    // System prompt first and history verbatim: the serialized prefix must not
+    // change between turns for the API's context cache to hit. Rendered into a
+    // per-thread buffer that keeps its capacity, then copied once at exact size.
+    thread_local std::string buffer;
+    buffer.clear();
+    buffer += requestPrefix_;
+    for (size_t i = start; i < history.size(); ++i) {
+        buffer += ",{\"role\":\"";
+        JsonScanner::appendEscaped(buffer, history[i].role);
+        buffer += "\",\"content\":\"";
+        JsonScanner::appendEscaped(buffer, history[i].content);
+        buffer += "\"}";
+    }
+    buffer += ",{\"role\":\"user\",\"content\":\"";
+    JsonScanner::appendEscaped(buffer, content);
+    buffer += "\"}]}";
+    return buffer;
 }
 
 DeepSeekChat::Message DeepSeekChat::sendMessage(const std::string& content) {
-    // Construct request data
-    nlohmann::json requestData = {
-        {"model", "deepseek-chat"},
-        {"messages", {
-            {
-                {"role", "system"},
-                {"content", "You are a helpful assistant."}
-            },
+    return sendMessageAsync(content).get().message;
+}
+
+DeepSeekChat::Message DeepSeekChat::sendMessage(const std::vector<Message>& history, const std::string& content) {
+    return sendMessageAsync(history, content).get().message;
+}
+
+std::future<DeepSeekChat::Completion> DeepSeekChat::sendMessageAsync(const std::string& content) {
+    return sendMessageAsync({}, content);
+}
+
+std::future<DeepSeekChat::Completion> DeepSeekChat::sendMessageAsync(const std::vector<Message>& history, const std::string& content,
+                                                                     Clock::time_point deadline) {
+    auto call = std::make_shared<Call>();
+    call->request = buildRequest(history, content);
+    call->deadline = deadline;
+    auto future = call->promise.get_future();
+    submit(std::move(call));
+    return future;
+}
+
+void DeepSeekChat::sendMessageAsync(const std::vector<Message>& history, const std::string& content, Callback callback,
+                                    Clock::time_point deadline) {
+    auto call = std::make_shared<Call>();
+    call->request = buildRequest(history, content);
+    call->deadline = deadline;
+    call->callback = std::move(callback);
+    submit(std::move(call));
+}
+
+DeepSeekChat::TokenUsage DeepSeekChat::getLastTokenUsage() const {
+    std::lock_guard<std::mutex> lock(usageMutex_);
+    return lastTokenUsage_;
+}
+
+DeepSeekChat::UsageTotals DeepSeekChat::usageTotals() const {
+    return {
+        promptTokens_.load(),
+        completionTokens_.load(),
+        cacheHitTokens_.load(),
+        cacheMissTokens_.load(),
+        trimmedMessages_.load()
+    };
+}
+
+CircuitBreaker::Stats DeepSeekChat::breakerStats() const {
+    return breaker_.stats(Clock::now());
+}
+
+DeepSeekChat::RetryStats DeepSeekChat::retryStats() const {
+    return {
+        calls_.load(),
+        attempts_.load(),
+        retries_.load(),
+        hedges_.load(),
+        hedgesWon_.load(),
+        budgetExhausted_.load(),
+        failures_.load(),
+        hedgeDelayMs_.load()
+    };
+}
+
+void DeepSeekChat::submit(std::shared_ptr<Call> call) {
+    call->deadline = std::min(call->deadline, Clock::now() + options_.overallTimeout);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (!running_.load()) {
+            call->fail(shuttingDown());
+            return;
+        }
+        pending_.push_back(std::move(call));
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void DeepSeekChat::startCall(const std::shared_ptr<Call>& call) {
+    ++calls_;
+    retryTokens_ = std::min(options_.retryBudgetBurst, retryTokens_ + options_.retryBudgetRatio);
+    Clock::duration retryAfter;
+    if (!breaker_.allow(Clock::now(), retryAfter)) {
+        ++failures_;
+        call->fail(std::make_exception_ptr(CircuitOpenError("DeepSeek circuit breaker is open", retryAfter)));
+        return;
+    }
+    startAttempt(call, false);
+
+    int64_t hedgeDelay = hedgeDelayMs_.load(std::memory_order_relaxed);
+    if (options_.hedge && hedgeDelay > 0 && !call->done) {
+        timers_.emplace(Clock::now() + std::chrono::milliseconds(hedgeDelay), Timer{call, TimerKind::Hedge});
+    }
+}
+
+void DeepSeekChat::startAttempt(const std::shared_ptr<Call>& call, bool hedge) {
+    Clock::time_point now = Clock::now();
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(call->deadline - now);
+    if (remaining.count() <= 0) {
+        if (!call->live.empty()) {
+            return;
+        }
+        ++failures_;
+        call->fail(call->lastError ? call->lastError
+                                   : std::make_exception_ptr(std::runtime_error("DeepSeek request deadline exceeded")));
+        return;
+    }
+
+    CURL* easy = curl_easy_init();
+    if (!easy) {
+        if (!call->live.empty()) {
+            return;
+        }
+        ++failures_;
+        call->fail(std::make_exception_ptr(std::runtime_error("CURL not initialized")));
+        return;
+    }
+    auto transfer = std::make_unique<Transfer>();
+    transfer->easy = easy;
+    transfer->call = call;
+    transfer->started = now;
+    transfer->hedge = hedge;
+
+    curl_easy_setopt(easy, CURLOPT_URL, baseUrl_.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, &transfer->response);
+    curl_easy_setopt(easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, call->request.data());
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(call->request.size()));
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers_);
+    curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+
+    // Prefer one multiplexed HTTP/2 connection over opening a new one per request
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    // The attempt may not outlive the call's deadline
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(std::min(options_.connectTimeout, remaining).count()));
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(std::min(options_.attemptTimeout, remaining).count()));
+
+    CURLMcode code = curl_multi_add_handle(multi_, easy);
+    if (code != CURLM_OK) {
+        if (!call->live.empty()) {
+            return;
+        }
+        ++failures_;
+        call->fail(std::make_exception_ptr(
+            std::runtime_error("CURL request failed: " + std::string(curl_multi_strerror(code)))));
+        return;
+    }
+    ++call->attempts;
+    ++attempts_;
+    call->live.push_back(easy);
+    active_.emplace(easy, std::move(transfer));
+}
+
+void DeepSeekChat::cancelAttempts(Call& call) {
+    for (CURL* easy : call.live) {
+        curl_multi_remove_handle(multi_, easy);
+        active_.erase(easy);
+    }
+    call.live.clear();
+}
+
+bool DeepSeekChat::takeRetryToken() {
+    if (retryTokens_ < 1.0) {
+        ++budgetExhausted_;
+        return false;
+    }
+    retryTokens_ -= 1.0;
+    return true;
+}
+
+// Full jitter: uniform in [0, min(maxBackoff, baseBackoff * 2^(attempt-1))]
+DeepSeekChat::Clock::duration DeepSeekChat::backoff(int attempt) {
+    auto cap = options_.baseBackoff * (1LL << std::min(attempt - 1, 20));
+    cap = std::min<std::chrono::milliseconds>(cap, options_.maxBackoff);
+    std::uniform_int_distribution<int64_t> jitter(0, std::max<int64_t>(0, cap.count()));
+    return std::chrono::milliseconds(jitter(rng_));
+}
+
+void DeepSeekChat::finishTransfer(CURL* easy, CURLcode result) {
+    curl_multi_remove_handle(multi_, easy);
+    auto it = active_.find(easy);
+    if (it == active_.end()) {
+        return;
+    }
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    active_.erase(it);
+    std::shared_ptr<Call> call = transfer->call;
+    call->live.erase(std::remove(call->live.begin(), call->live.end(), easy), call->live.end());
+    if (call->done) {
+        return;
+    }
+
+    long status = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    Clock::time_point now = Clock::now();
+    // A timeout the caller's deadline imposed says nothing about the backend
+    bool clipped = result == CURLE_OPERATION_TIMEDOUT && call->deadline - transfer->started < options_.attemptTimeout;
+    if (!clipped) {
+        bool failed = result != CURLE_OK || status == 429 || status >= 500;
+        breaker_.record(!failed, now - transfer->started, now);
+    }
+    bool retryable = false;
+    std::exception_ptr error;
+    if (result != CURLE_OK) {
+        // Connect failures, resets and timeouts are worth another try
+        retryable = true;
+        error = std::make_exception_ptr(
+            std::runtime_error("CURL request failed: " + std::string(curl_easy_strerror(result))));
+    } else if (status >= 400) {
+        retryable = status == 429 || status >= 500;
+        error = std::make_exception_ptr(std::runtime_error(
+            "DeepSeek API returned HTTP " + std::to_string(status) + ": " + transfer->response.substr(0, 200)));
+    } else {
+        try {
+            Completion completion = parseMessageResponse(transfer->response);
             {
-                {"role", "user"},
-                {"content", content}
+                std::lock_guard<std::mutex> lock(usageMutex_);
+                lastTokenUsage_ = completion.usage;
             }
-        }},
-        {"stream", false}
-    };
+            promptTokens_ += completion.usage.prompt_tokens;
+            completionTokens_ += completion.usage.completion_tokens;
+            cacheHitTokens_ += completion.usage.prompt_cache_hit_tokens;
+            cacheMissTokens_ += completion.usage.prompt_cache_miss_tokens;
+
+            // The hedge delay tracks the p95 of successful attempts
+            attemptLatency_.record(Clock::now() - transfer->started);
+            if (++successes_ >= options_.hedgeWarmup && successes_ % 16 == 0) {
+                auto p95 = std::chrono::microseconds(attemptLatency_.snapshot().percentile(0.95));
+                hedgeDelayMs_ = std::max(options_.minHedgeDelay, std::chrono::duration_cast<std::chrono::milliseconds>(p95)).count();
+            }
+            if (transfer->hedge) {
+                ++hedgesWon_;
+            }
+            cancelAttempts(*call);
+            call->succeed(std::move(completion));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        if (!error) {
+            return;
+        }
+    }
+
+    call->lastError = error;
+    if (!call->live.empty()) {
+        // A hedge is still running; let it decide
+        return;
+    }
+    if (retryable && call->attempts < options_.maxAttempts) {
+        Clock::time_point retryAt = Clock::now() + backoff(call->attempts);
+        if (retryAt < call->deadline && takeRetryToken()) {
+            ++retries_;
+            timers_.emplace(retryAt, Timer{call, TimerKind::Retry});
+            return;
+        }
+    }
+    ++failures_;
+    call->fail(error);
+}
 
-    // Ensure JSON uses UTF-8 encoding
-    std::string jsonStr = requestData.dump(-1, 32, true);
-    std::string response = sendRequest(baseUrl_, jsonStr);
-    
-    return parseMessageResponse(response);
+void DeepSeekChat::runTimers(Clock::time_point now) {
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+        Timer timer = std::move(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+        Call& call = *timer.call;
+        if (call.done) {
+            continue;
+        }
+        if (timer.kind == TimerKind::Retry) {
+            if (!breaker_.allow(now)) {
+                ++failures_;
+                call.fail(call.lastError);
+                continue;
+            }
+            startAttempt(timer.call, false);
+        } else if (call.live.size() == 1 && call.attempts < options_.maxAttempts && takeRetryToken() && breaker_.allow(now)) {
+            ++hedges_;
+            startAttempt(timer.call, true);
+        }
+    }
 }
 
-DeepSeekChat::Message DeepSeekChat::parseMessageResponse(const std::string& response) {
-    Message message;
+void DeepSeekChat::ioLoop() {
+    while (true) {
+        std::deque<std::shared_ptr<Call>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            incoming.swap(pending_);
+        }
+        bool stopping = !running_.load();
+        for (auto& call : incoming) {
+            if (stopping) {
+                call->fail(shuttingDown());
+            } else {
+                startCall(call);
+            }
+        }
+        if (stopping) {
+            break;
+        }
+
+        int stillRunning = 0;
+        curl_multi_perform(multi_, &stillRunning);
+
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+            if (message->msg == CURLMSG_DONE) {
+                finishTransfer(message->easy_handle, message->data.result);
+            }
+        }
+        runTimers(Clock::now());
+
+        // Sleeps until socket activity, a curl timer, the next retry/hedge timer,
+        // or curl_multi_wakeup from submit()
+        int timeoutMs = 1000;
+        if (!timers_.empty()) {
+            auto untilTimer = std::chrono::duration_cast<std::chrono::milliseconds>(timers_.begin()->first - Clock::now());
+            timeoutMs = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(timeoutMs, untilTimer.count() + 1)));
+        }
+        curl_multi_poll(multi_, nullptr, 0, timeoutMs, nullptr);
+    }
+
+    // Fail whatever is still in flight or waiting; new submissions are rejected from here on
+    timers_.clear();
+    std::vector<std::shared_ptr<Call>> unfinished;
+    for (auto& entry : active_) {
+        curl_multi_remove_handle(multi_, entry.first);
+        if (!entry.second->call->done) {
+            unfinished.push_back(entry.second->call);
+        }
+    }
+    active_.clear();
+    for (auto& call : unfinished) {
+        if (!call->done) {
+            call->fail(shuttingDown());
+        }
+    }
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    for (auto& call : pending_) {
+        call->fail(shuttingDown());
+    }
+    pending_.clear();
+}
+
+DeepSeekChat::Completion DeepSeekChat::parseMessageResponse(const std::string& response) {
+    Completion completion;
+    Message& message = completion.message;
+
+    // Fast path: pull choices[0].message and usage out of the body without a DOM
+    JsonScanner scanner(response);
+    std::string_view messageJson;
+    bool isString = false;
+    if (scanner.findRaw({"choices", 0, "message"}, messageJson, isString) && !isString) {
+        JsonScanner fields(messageJson);
+        if (fields.findString({"role"}, message.role) && fields.findString({"content"}, message.content)) {
+            std::string_view usage;
+            if (scanner.findRaw({"usage"}, usage, isString) && !isString) {
+                readUsage(usage, "prompt_tokens", completion.usage.prompt_tokens);
+                readUsage(usage, "completion_tokens", completion.usage.completion_tokens);
+                readUsage(usage, "total_tokens", completion.usage.total_tokens);
+                readUsage(usage, "prompt_cache_hit_tokens", completion.usage.prompt_cache_hit_tokens);
+                readUsage(usage, "prompt_cache_miss_tokens", completion.usage.prompt_cache_miss_tokens);
+            }
+            return completion;
+        }
+    }
+
+    // Anything unusual (escaped keys, null content, error bodies) takes the full parser
+    completion = Completion();
     try {
         // Parse JSON with UTF-8 encoding
         auto json = nlohmann::json::parse(response, nullptr, true, true);
-        
+
         // Parse DeepSeek response
         if (json.contains("choices") && !json["choices"].empty()) {
             const auto& choice = json["choices"][0];
@@ -95,10 +610,19 @@ DeepSeekChat::Message DeepSeekChat::parseMessageResponse(const std::string& resp
         } else {
             throw std::runtime_error("No choices in response");
         }
+
+        if (json.contains("usage") && json["usage"].is_object()) {
+            const auto& usage = json["usage"];
+            completion.usage.prompt_tokens = usage.value("prompt_tokens", 0);
+            completion.usage.completion_tokens = usage.value("completion_tokens", 0);
+            completion.usage.total_tokens = usage.value("total_tokens", 0);
+            completion.usage.prompt_cache_hit_tokens = usage.value("prompt_cache_hit_tokens", 0);
+            completion.usage.prompt_cache_miss_tokens = usage.value("prompt_cache_miss_tokens", 0);
+        }
     } catch (const nlohmann::json::parse_error& e) {
         throw std::runtime_error("JSON parse error: " + std::string(e.what()));
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to parse message response: " + std::string(e.what()));
     }
-    return message;
-}
\ No newline at end of file
+    return completion;
+}
@@ -3,9 +3,65 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include "latencyHistogram.h"
+#include "circuitBreaker.h"
 
+struct DeepSeekRetryOptions {
+    std::chrono::milliseconds attemptTimeout{30000};
+    std::chrono::milliseconds overallTimeout{120000};   // including backoff between attempts
+    std::chrono::milliseconds connectTimeout{5000};
+    int maxAttempts = 3;
+    std::chrono::milliseconds baseBackoff{200};         // doubled per retry, full jitter
+    std::chrono::milliseconds maxBackoff{5000};
+    double retryBudgetRatio = 0.1;                      // retries + hedges allowed per request
+    double retryBudgetBurst = 10;
+    bool hedge = false;
+    std::chrono::milliseconds minHedgeDelay{100};
+    size_t hedgeWarmup = 20;                            // successes seen before hedging starts
+    CircuitBreakerOptions breaker;                      // 429 / 5xx / transport errors and slow attempts
+};
+
+struct DeepSeekPromptOptions {
+    std::string systemPrompt = "You are a helpful assistant.";
+    size_t contextTokens = 16000;       // system prompt + history + message (estimated)
+    size_t trimStep = 8;                // history is cut in blocks of this many messages
+};
+
+// DeepSeek chat client, safe to share between threads.
+//
+// Requests are handed to one I/O thread that drives a curl multi handle: every
+// call to the API shares the same HTTP/2 connection (multiplexed streams) or a
+// small pool of reused connections, plus the DNS and TLS session caches. Callers
+// either block (sendMessage), hold a future (sendMessageAsync) or get a callback
+// on the I/O thread.
+//
+// Each call has a deadline. Transport errors, 429 and 5xx are retried with
+// jittered exponential backoff while a retry budget allows it: retries (and
+// hedges) may add at most retryBudgetRatio of the request rate, so a dead
+// upstream sees ~1.1x the traffic, not maxAttempts x. With hedging on, a call
+// still running after the observed p95 gets a second attempt; the first answer
+// wins and the other transfer is cancelled.
+//
+// A caller deadline (e.g. from the proxy's X-Deadline-Ms) shortens the call's
+// own and so the curl timeouts of every attempt. While the circuit breaker is
+// open, calls and retries fail at once with CircuitOpenError.
+//
+// Requests may carry the conversation so far. History that doesn't fit the
+// token budget is dropped oldest first, in blocks of trimStep messages: the cut
+// moves once every few turns instead of on every turn, so consecutive requests
+// of a conversation start with the same bytes and hit the API's context cache.
 class DeepSeekChat {
 public:
     struct Message {
@@ -13,33 +69,149 @@ public:
         std::string content;
     };
 
-    DeepSeekChat(const std::string& apiKey);
+    // Token usage of one request
+    struct TokenUsage {
+        int prompt_tokens = 0;
+        int completion_tokens = 0;
+        int total_tokens = 0;
+        int prompt_cache_hit_tokens = 0;    // prompt prefix served from the API's context cache
+        int prompt_cache_miss_tokens = 0;
+    };
+
+    // Sums over all finished requests
+    struct UsageTotals {
+        uint64_t promptTokens;
+        uint64_t completionTokens;
+        uint64_t cacheHitTokens;
+        uint64_t cacheMissTokens;
+        uint64_t trimmedMessages;       // history messages left out to fit the budget
+    };
+
+    struct Completion {
+        Message message;
+        TokenUsage usage;
+    };
+
+    struct RetryStats {
+        uint64_t calls;
+        uint64_t attempts;
+        uint64_t retries;
+        uint64_t hedges;
+        uint64_t hedgesWon;
+        uint64_t budgetExhausted;   // retries or hedges skipped for lack of budget
+        uint64_t failures;
+        int64_t hedgeDelayMs;       // 0 until enough samples
+    };
+
+    // Exactly one of error / completion is meaningful. Runs on the I/O thread:
+    // keep it short and don't call sendMessage from it.
+    using Callback = std::function<void(std::exception_ptr error, Completion completion)>;
+
+    DeepSeekChat(const std::string& apiKey, const DeepSeekRetryOptions& options = DeepSeekRetryOptions(),
+                 const DeepSeekPromptOptions& prompt = DeepSeekPromptOptions());
     ~DeepSeekChat();
 
-    // Send message and get response
+    DeepSeekChat(const DeepSeekChat&) = delete;
+    DeepSeekChat& operator=(const DeepSeekChat&) = delete;
+
+    // Send message and get response (blocks the calling thread only)
     Message sendMessage(const std::string& content);
-    
-    // Get token usage of last request
-    struct TokenUsage {
-        int prompt_tokens;
-        int completion_tokens;
-        int total_tokens;
-    };
-    TokenUsage getLastTokenUsage() const { return lastTokenUsage_; }
+    // history: earlier "user"/"assistant" turns, oldest first
+    Message sendMessage(const std::vector<Message>& history, const std::string& content);
+
+    std::future<Completion> sendMessageAsync(const std::string& content);
+    // deadline: when the caller stops waiting; the call never runs past overallTimeout either
+    std::future<Completion> sendMessageAsync(const std::vector<Message>& history, const std::string& content,
+                                             std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+    void sendMessageAsync(const std::vector<Message>& history, const std::string& content, Callback callback,
+                          std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    // Get token usage of the most recently finished request
+    TokenUsage getLastTokenUsage() const;
+
+    RetryStats retryStats() const;
+    UsageTotals usageTotals() const;
+    CircuitBreaker::Stats breakerStats() const;
+
+    // Index of the first history message that fits the budget
+    static size_t trimStart(const std::vector<Message>& history, size_t fixedTokens, size_t budget, size_t step);
 
 private:
+    using Clock = std::chrono::steady_clock;
+    struct Call;
+    struct Transfer;
+
+    enum class TimerKind { Retry, Hedge };
+
+    struct Timer {
+        std::shared_ptr<Call> call;
+        TimerKind kind;
+    };
+
     // CURL callback function
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp);
-    
-    // Send HTTP request
-    std::string sendRequest(const std::string& url, const std::string& data);
-    
+    static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, std::string* userp);
+    static void lockShared(CURL* handle, curl_lock_data data, curl_lock_access access, void* userp);
+    static void unlockShared(CURL* handle, curl_lock_data data, void* userp);
+
+    std::string buildRequest(const std::vector<Message>& history, const std::string& content);
+    void submit(std::shared_ptr<Call> call);
+
+    // I/O thread only
+    void ioLoop();
+    void startCall(const std::shared_ptr<Call>& call);
+    void startAttempt(const std::shared_ptr<Call>& call, bool hedge);
+    void finishTransfer(CURL* easy, CURLcode result);
+    void cancelAttempts(Call& call);
+    void runTimers(Clock::time_point now);
+    bool takeRetryToken();
+    Clock::duration backoff(int attempt);
+
     // Parse JSON response
-    Message parseMessageResponse(const std::string& response);
+    Completion parseMessageResponse(const std::string& response);
 
 private:
     std::string apiKey_;
-    CURL* curl_;
     const std::string baseUrl_ = "https://api.deepseek.com/chat/completions";
+    DeepSeekRetryOptions options_;
+    DeepSeekPromptOptions prompt_;
+    std::string requestPrefix_;     // model and system message, rendered once
+    curl_slist* headers_;
+
+    CURLM* multi_;
+    CURLSH* share_;
+    std::mutex shareMutexes_[CURL_LOCK_DATA_LAST];
+
+    std::mutex queueMutex_;
+    std::deque<std::shared_ptr<Call>> pending_;
+    std::atomic<bool> running_;
+    std::thread ioThread_;
+
+    // I/O thread only
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> active_;
+    std::multimap<Clock::time_point, Timer> timers_;
+    double retryTokens_;
+    LatencyHistogram attemptLatency_;
+    uint64_t successes_;
+    std::mt19937_64 rng_;
+
+    mutable CircuitBreaker breaker_;
+
+    std::atomic<uint64_t> calls_;
+    std::atomic<uint64_t> attempts_;
+    std::atomic<uint64_t> retries_;
+    std::atomic<uint64_t> hedges_;
+    std::atomic<uint64_t> hedgesWon_;
+    std::atomic<uint64_t> budgetExhausted_;
+    std::atomic<uint64_t> failures_;
+    std::atomic<int64_t> hedgeDelayMs_;
+
+    std::atomic<uint64_t> promptTokens_;
+    std::atomic<uint64_t> completionTokens_;
+    std::atomic<uint64_t> cacheHitTokens_;
+    std::atomic<uint64_t> cacheMissTokens_;
+    std::atomic<uint64_t> trimmedMessages_;
+
+    mutable std::mutex usageMutex_;
     TokenUsage lastTokenUsage_;
-};
\ No newline at end of file
+};
@@ -0,0 +1,110 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cmdLine.h"
+#include "lfuCache.h"
+#include "cachedResponse.h"
+
+// Many threads reading one viral key from HashLfuCache.
+//
+//   hot_key_bench --threads=16 --seconds=2 --hot-share=0.9 --keys=1000 --slices=8
+//
+// Each read is the hot key with probability --hot-share, otherwise one of
+// --keys others. Without help, every hot read takes the same slice mutex. The
+// bench runs the same load against the plain cache, hot-key replication
+// (--replicas copies) and the per-thread L1.
+
+using namespace CacheImpl;
+using ResponseCache = HashLfuCache<std::string, CachedResponse>;
+
+struct Mode {
+    std::string name;
+    size_t replicas;
+    size_t l1Entries;
+};
+
+double runMode(const Mode& mode, int threads, double seconds, double hotShare, size_t keys, int slices) {
+    auto cache = std::make_unique<ResponseCache>(keys + 16, slices);
+    cache->enableHotKeys(mode.replicas);
+    cache->enableThreadCache(mode.l1Entries);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < keys; ++i) {
+        names.push_back("question " + std::to_string(i));
+        cache->put(names.back(), makeCachedResponse(std::string(512, 'a' + i % 26), "assistant"));
+    }
+    const std::string hot = "hello";
+    cache->put(hot, makeCachedResponse("Hello! How can I help you today?", "assistant"));
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> workers;
+    uint32_t hotThreshold = static_cast<uint32_t>(hotShare * 1024);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            uint64_t rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+            uint64_t ops = 0;
+            std::shared_ptr<const CachedResponse> value;
+            while (!stop.load(std::memory_order_relaxed)) {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                const std::string& key = (rng & 1023) < hotThreshold ? hot : names[(rng >> 10) % names.size()];
+                cache->getShared(key, value);
+                ++ops;
+            }
+            total.fetch_add(ops);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (mode.replicas > 0) {
+        auto stats = cache->hotKeyStats();
+        uint64_t sampled = 0;
+        uint64_t hottest = 0;
+        for (uint64_t count : stats.sliceSamples) {
+            sampled += count;
+            hottest = std::max(hottest, count);
+        }
+        std::cout << "    hot keys=" << stats.hot << " promoted=" << stats.promoted << " replica hits=" << stats.replicaHits
+                  << " hottest slice=" << std::fixed << std::setprecision(1)
+                  << (sampled == 0 ? 0.0 : hottest * 100.0 / sampled) << "% of sampled reads\n";
+    }
+    return total.load() / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    int threads = static_cast<int>(args.getInt("threads", std::max(2u, std::thread::hardware_concurrency())));
+    double seconds = args.getDouble("seconds", 2.0);
+    double hotShare = args.getDouble("hot-share", 0.9);
+    size_t keys = static_cast<size_t>(args.getInt("keys", 1000));
+    int slices = static_cast<int>(args.getInt("slices", 8));
+    size_t replicas = static_cast<size_t>(args.getInt("replicas", threads));
+
+    std::vector<Mode> modes = {
+        {"sharded", 0, 0},
+        {"hot replicas", replicas, 0},
+        {"per-thread L1", 0, 256},
+    };
+
+    std::cout << threads << " threads, " << hotShare * 100 << "% of reads on one key, " << slices << " slices\n";
+    double baseline = 0;
+    for (const auto& mode : modes) {
+        double rate = runMode(mode, threads, seconds, hotShare, keys, slices);
+        if (baseline == 0) {
+            baseline = rate;
+        }
+        std::cout << std::left << std::setw(16) << mode.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << rate / 1e6 << " Mops/s  (" << rate / baseline << "x)\n";
+    }
+    return 0;
+}
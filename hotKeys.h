@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CacheImpl
+{
+    // 热点 key 检测与多副本只读复制，供分片缓存使用。
+    //
+    // 检测：每个分片一个 space-saving 草图（kCounters 个计数器），按 1/kSampleEvery
+    // 抽样记录访问，草图忙时直接跳过。每满 kWindow 次抽样评估一次：同一时段内一个
+    // key 占全部抽样的比例达到 min(2/分片数, 1/kPromoteShare)，即单个 key 的流量超过
+    // 一个分片的两倍平均值，就升为热点；已是热点但比例跌破门槛一半的降级。然后清空
+    // 草图重新计数。冷分片里独占该分片的 key 不会被误判，因为看的是全局比例。
+    //
+    // 复制：热点 key 的值（不可变 shared_ptr）在 replicas 个副本里各存一份，线程固定
+    // 读其中一个，原来挤在一个分片锁上的读请求被分摊到多把锁上。副本条目记录填充时
+    // 的纪元，与调用方（见 threadCache.h）的纪元不一致即作废，所以写入不必逐个副本
+    // 删除；降级时才清理各副本。
+    template <typename Key, typename Value>
+    class HotKeys
+    {
+        public:
+            using ValuePtr = std::shared_ptr<const Value>;
+
+            struct Stats
+            {
+                size_t hot;                         // 当前热点 key 数
+                uint64_t promoted;
+                uint64_t demoted;
+                uint64_t replicaHits;
+                std::vector<uint64_t> sliceSamples; // 各分片被抽样的访问数，看哪个分片热
+            };
+
+            HotKeys()
+                : hotCount_(0)
+                , promoted_(0)
+                , demoted_(0)
+            {
+                for (auto& slot : hotHashes_)
+                    slot.store(0, std::memory_order_relaxed);
+            }
+
+            HotKeys(const HotKeys&) = delete;
+            HotKeys& operator=(const HotKeys&) = delete;
+
+            // 副本数，0 表示关闭；须在缓存开始使用前调用
+            void enable(size_t replicas)
+            {
+                replicas_.clear();
+                for (size_t i = 0; i < replicas; ++i)
+                    replicas_.emplace_back(new Replica());
+            }
+
+            bool enabled() const
+            {
+                return !replicas_.empty();
+            }
+
+            // 热点 key 在本线程副本中的值；epoch 为当前纪元
+            bool find(const Key& key, size_t hash, uint64_t epoch, ValuePtr& value)
+            {
+                if (!isHot(hash))
+                    return false;
+
+                Replica& replica = localReplica();
+                std::lock_guard<std::mutex> lock(replica.mutex);
+                for (auto it = replica.entries.begin(); it != replica.entries.end(); ++it)
+                {
+                    if (it->hash != hash || !(it->key == key))
+                        continue;
+                    if (it->epoch != epoch)
+                    {
+                        replica.entries.erase(it);
+                        return false;
+                    }
+                    // 定期放一次给分片，热点 key 在分片里的访问频次才不会停滞
+                    if (++it->hits % kTouchEvery == 0)
+                        return false;
+                    value = it->value;
+                    ++replica.hits;
+                    return true;
+                }
+                return false;
+            }
+
+            // 分片命中后调用：热点 key 放进本线程的副本；epoch 为查分片之前读取的纪元
+            void offer(const Key& key, size_t hash, uint64_t epoch, const ValuePtr& value)
+            {
+                if (!isHot(hash))
+                    return;
+
+                Replica& replica = localReplica();
+                std::lock_guard<std::mutex> lock(replica.mutex);
+                for (auto& entry : replica.entries)
+                {
+                    if (entry.hash == hash && entry.key == key)
+                    {
+                        entry.epoch = epoch;
+                        entry.value = value;
+                        return;
+                    }
+                }
+                if (replica.entries.size() < kMaxHot)
+                    replica.entries.push_back({hash, epoch, 0, key, value});
+            }
+
+            // 记录一次对 slice 分片（共 slices 个）的访问（抽样）
+            void sample(const Key& key, size_t hash, size_t slice, size_t slices)
+            {
+                // 随机抽样而不是每隔 N 次，免得与调用方的访问周期同步
+                thread_local uint32_t rng = 0x9E3779B9u ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&rng));
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                if (rng % kSampleEvery != 0)
+                    return;
+
+                slices = std::max<size_t>(1, std::min(slices, kMaxSketches));
+                Sketch& sketch = sketches_[slice % slices];
+                sketch.total.fetch_add(1, std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lock(sketch.mutex, std::try_to_lock);
+                if (!lock.owns_lock())
+                    return;
+
+                sketch.add(key, hash);
+                if (++sketch.samples >= kWindow)
+                {
+                    uint64_t now = sampledTotal(slices);
+                    evaluate(sketch, slice % slices, slices, now - sketch.windowStart);
+                    sketch.reset(now);
+                }
+            }
+
+            Stats stats(size_t slices) const
+            {
+                Stats stats;
+                stats.hot = hotCount_.load(std::memory_order_relaxed);
+                stats.promoted = promoted_.load(std::memory_order_relaxed);
+                stats.demoted = demoted_.load(std::memory_order_relaxed);
+                stats.replicaHits = 0;
+                for (auto& replica : replicas_)
+                {
+                    std::lock_guard<std::mutex> lock(replica->mutex);
+                    stats.replicaHits += replica->hits;
+                }
+                for (size_t i = 0; i < std::min(slices, kMaxSketches); ++i)
+                    stats.sliceSamples.push_back(sketches_[i].total.load(std::memory_order_relaxed));
+                return stats;
+            }
+
+        private:
+            static constexpr size_t kMaxHot = 16;
+            static constexpr size_t kMaxSketches = 64;
+            static constexpr size_t kCounters = 16;
+            static constexpr uint32_t kSampleEvery = 16;
+            static constexpr uint32_t kWindow = 512;
+            static constexpr uint32_t kPromoteShare = 4;
+            static constexpr uint32_t kTouchEvery = 64;
+
+            struct Entry
+            {
+                size_t hash;
+                uint64_t epoch;
+                uint32_t hits;
+                Key key;
+                ValuePtr value;
+            };
+
+            struct alignas(64) Replica
+            {
+                mutable std::mutex mutex;
+                std::vector<Entry> entries;
+                uint64_t hits = 0;
+            };
+
+            struct Counter
+            {
+                size_t hash;
+                Key key;
+                uint32_t count;
+            };
+
+            struct Sketch
+            {
+                std::mutex mutex;
+                std::vector<Counter> counters;
+                uint32_t samples = 0;
+                uint64_t windowStart = 0;       // 窗口开始时所有分片的抽样总数
+                std::atomic<uint64_t> total{0};
+
+                // space-saving：已有则计数加一，否则顶替计数最小的计数器
+                void add(const Key& key, size_t hash)
+                {
+                    for (auto& counter : counters)
+                    {
+                        if (counter.hash == hash && counter.key == key)
+                        {
+                            ++counter.count;
+                            return;
+                        }
+                    }
+                    if (counters.size() < kCounters)
+                    {
+                        counters.push_back({hash, key, 1});
+                        return;
+                    }
+                    auto min = std::min_element(counters.begin(), counters.end(),
+                                                [](const Counter& a, const Counter& b) { return a.count < b.count; });
+                    min->hash = hash;
+                    min->key = key;
+                    ++min->count;
+                }
+
+                uint32_t countOf(const Key& key, size_t hash) const
+                {
+                    for (auto& counter : counters)
+                    {
+                        if (counter.hash == hash && counter.key == key)
+                            return counter.count;
+                    }
+                    return 0;
+                }
+
+                void reset(uint64_t sampledTotal)
+                {
+                    counters.clear();
+                    samples = 0;
+                    windowStart = sampledTotal;
+                }
+            };
+
+            struct HotKey
+            {
+                Key key;
+                size_t sketch;
+            };
+
+            bool isHot(size_t hash) const
+            {
+                if (hotCount_.load(std::memory_order_relaxed) == 0)
+                    return false;
+                for (auto& slot : hotHashes_)
+                {
+                    if (slot.load(std::memory_order_acquire) == hash)
+                        return true;
+                }
+                return false;
+            }
+
+            Replica& localReplica()
+            {
+                static std::atomic<size_t> nextThread{0};
+                thread_local size_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+                return *replicas_[thread % replicas_.size()];
+            }
+
+            uint64_t sampledTotal(size_t slices) const
+            {
+                uint64_t total = 0;
+                for (size_t i = 0; i < slices; ++i)
+                    total += sketches_[i].total.load(std::memory_order_relaxed);
+                return total;
+            }
+
+            // 持有 sketch.mutex；锁顺序为草图、hotMutex_、副本。
+            // sampled 为本窗口期间所有分片的抽样数
+            void evaluate(const Sketch& sketch, size_t index, size_t slices, uint64_t sampled)
+            {
+                double threshold = std::min(2.0 / slices, 1.0 / kPromoteShare) * std::max<uint64_t>(sampled, kWindow);
+                std::lock_guard<std::mutex> lock(hotMutex_);
+                for (size_t i = 0; i < kMaxHot; ++i)
+                {
+                    size_t hash = hotHashes_[i].load(std::memory_order_relaxed);
+                    if (hash == 0 || hotKeys_[i].sketch != index)
+                        continue;
+                    if (sketch.countOf(hotKeys_[i].key, hash) < threshold / 2)
+                        demoteLocked(i);
+                }
+                for (auto& counter : sketch.counters)
+                {
+                    if (counter.count >= threshold && counter.hash != 0)
+                        promoteLocked(counter.key, counter.hash, index);
+                }
+            }
+
+            void promoteLocked(const Key& key, size_t hash, size_t sketch)
+            {
+                size_t free = kMaxHot;
+                for (size_t i = 0; i < kMaxHot; ++i)
+                {
+                    size_t slot = hotHashes_[i].load(std::memory_order_relaxed);
+                    if (slot == hash)
+                        return;
+                    if (slot == 0 && free == kMaxHot)
+                        free = i;
+                }
+                if (free == kMaxHot)
+                    return;
+                hotKeys_[free] = {key, sketch};
+                hotHashes_[free].store(hash, std::memory_order_release);
+                hotCount_.fetch_add(1, std::memory_order_relaxed);
+                promoted_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void demoteLocked(size_t i)
+            {
+                size_t hash = hotHashes_[i].load(std::memory_order_relaxed);
+                hotHashes_[i].store(0, std::memory_order_release);
+                hotCount_.fetch_sub(1, std::memory_order_relaxed);
+                demoted_.fetch_add(1, std::memory_order_relaxed);
+                for (auto& replica : replicas_)
+                {
+                    std::lock_guard<std::mutex> lock(replica->mutex);
+                    auto& entries = replica->entries;
+                    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+                        return entry.hash == hash && entry.key == hotKeys_[i].key;
+                    }), entries.end());
+                }
+                hotKeys_[i] = HotKey();
+            }
+
+        private:
+            std::vector<std::unique_ptr<Replica>> replicas_;
+            Sketch sketches_[kMaxSketches];
+            std::mutex hotMutex_;                           // 升降级时持有
+            std::atomic<size_t> hotHashes_[kMaxHot];        // 0 为空槽；读路径只看这里
+            HotKey hotKeys_[kMaxHot];
+            std::atomic<size_t> hotCount_;
+            std::atomic<uint64_t> promoted_;
+            std::atomic<uint64_t> demoted_;
+    };
+}
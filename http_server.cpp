@@ -3,11 +3,86 @@
 #include <string>
 #include <nlohmann/json.hpp>
 #include <filesystem>
-#include "deepseek.h"
+#include "llmBackend.h"
+#include "mockBackend.h"
+#include "jsonScanner.h"
 #include "config.h"
+#include "asyncLogger.h"
+#include "tokenizer.h"
+#include "staticAssets.h"
+#include "cmdLine.h"
+#include "usageAccounting.h"
+#include "proxyCacheTier.h"
+#include "requestParams.h"
 
-int main() {
+// Who to bill: the X-Client-Id a proxy in front passes on, else the peer address
+static std::string clientId(const httplib::Request& req) {
+    std::string id = req.get_header_value("X-Client-Id");
+    return id.empty() ? req.remote_addr : id;
+}
+
+// X-Deadline-Ms: milliseconds the caller (normally proxy_server) will still
+// wait, relative so the hosts' clocks don't have to agree. No header or an
+// invalid one, no deadline.
+static LlmBackend::Deadline requestDeadline(const httplib::Request& req) {
+    std::chrono::milliseconds budget;
+    if (!parseDeadlineMs(req.get_header_value("X-Deadline-Ms"), budget)) {
+        return LlmBackend::Deadline::max();
+    }
+    return std::chrono::steady_clock::now() + budget;
+}
+
+// Error body, plus Retry-After when the backend said how long to stay away
+static void sendBackendError(const BackendError& e, httplib::Response& res) {
+    res.status = e.status();
+    if (e.retryAfter().count() > 0) {
+        res.set_header("Retry-After", std::to_string(e.retryAfter().count()));
+    }
+    res.set_content(nlohmann::json{{"error", e.what()}}.dump(), "application/json");
+}
+
+// The tier's record of a conversation, for requests that don't carry their own history
+static void sessionHistory(CacheImpl::SessionStore& sessions, const std::string& conversationId, LlmBackend::History& history) {
+    CacheImpl::SessionStore::View view;
+    if (conversationId.empty() || !sessions.view(conversationId, view)) {
+        return;
+    }
+    history.reserve(view.turns().size());
+    for (const auto& turn : view.turns()) {
+        history.push_back({turn.role == CacheImpl::SessionStore::Role::User ? "user" : "assistant", std::string(turn.content)});
+    }
+}
+
+// Optional "history": [{"role":"user"|"assistant","content":"..."}, ...], oldest first.
+// Other roles are refused: the system prompt is the server's.
+static LlmBackend::History parseHistory(const nlohmann::json& body) {
+    LlmBackend::History history;
+    auto it = body.find("history");
+    if (it == body.end() || it->is_null()) {
+        return history;
+    }
+    if (!it->is_array()) {
+        throw BackendError(400, "history must be an array");
+    }
+    history.reserve(it->size());
+    for (const auto& turn : *it) {
+        std::string role = turn.at("role").get<std::string>();
+        if (role != "user" && role != "assistant") {
+            throw BackendError(400, "history role must be user or assistant");
+        }
+        history.push_back({std::move(role), turn.at("content").get<std::string>()});
+    }
+    return history;
+}
+
+int main(int argc, char* argv[]) {
     try {
+        CommandLine args(argc, argv);
+
+        AsyncLogger::Options log_options;
+        log_options.path = "http_server.log";
+        AsyncLogger::instance().start(log_options);
+
         httplib::Server svr;
 
         // Set CORS headers
@@ -27,34 +102,164 @@ int main() {
             std::filesystem::create_directories(static_path);
         }
         
-        if (!svr.set_mount_point("/", static_path)) {
-            std::cout << "Failed to set static directory" << std::endl;
+        // Static files are served from memory (gzip + ETag); the route is registered last
+        StaticAssets static_assets(static_path);
+        static_assets.load();
+        if (args.getBool("watch-static", false) && !static_assets.watch()) {
+            std::cout << "Failed to watch static directory, changes need a restart" << std::endl;
+        }
+
+        // --backend=mock answers without network, e.g.
+        //   --backend=mock --mock-latency=bimodal:80,2000,0.05 --mock-reply-tokens=lognormal:200,0.7
+        //   --mock-error-rate=0.01 --mock-overload-rate=0.01 --mock-tokens-per-s=40 --mock-seed=7
+        std::unique_ptr<LlmBackend> backend;
+        std::string backend_name = args.get("backend", "deepseek");
+        if (backend_name == "mock") {
+            MockBackendOptions mock_options;
+            if ((args.has("mock-latency") && !Distribution::parse(args.get("mock-latency", ""), mock_options.latencyMs)) ||
+                (args.has("mock-reply-tokens") && !Distribution::parse(args.get("mock-reply-tokens", ""), mock_options.replyTokens))) {
+                std::cerr << "Distributions are fixed:N, lognormal:MEDIAN,SIGMA or bimodal:FAST,SLOW,P" << std::endl;
+                return 1;
+            }
+            mock_options.errorRate = args.getDouble("mock-error-rate", 0.0);
+            mock_options.overloadRate = args.getDouble("mock-overload-rate", 0.0);
+            mock_options.tokensPerSecond = args.getDouble("mock-tokens-per-s", 0.0);
+            mock_options.seed = static_cast<uint64_t>(args.getInt("mock-seed", 1));
+            backend = std::make_unique<MockBackend>(mock_options);
+        } else if (backend_name == "deepseek") {
+            // Retries and hedging, e.g. --upstream-attempts=3 --upstream-timeout-ms=60000 --hedge
+            DeepSeekRetryOptions retry_options;
+            retry_options.maxAttempts = static_cast<int>(args.getInt("upstream-attempts", retry_options.maxAttempts));
+            retry_options.attemptTimeout = std::chrono::milliseconds(args.getInt("upstream-attempt-timeout-ms", retry_options.attemptTimeout.count()));
+            retry_options.overallTimeout = std::chrono::milliseconds(args.getInt("upstream-timeout-ms", retry_options.overallTimeout.count()));
+            retry_options.retryBudgetRatio = args.getDouble("retry-budget", retry_options.retryBudgetRatio);
+            retry_options.hedge = args.getBool("hedge", retry_options.hedge);
+            // Circuit breaker, e.g. --breaker-failure-rate=0.5 --breaker-min-requests=20 --breaker-slow-ms=20000 --breaker-open-ms=5000
+            CircuitBreakerOptions& breaker = retry_options.breaker;
+            breaker.failureRate = args.getDouble("breaker-failure-rate", breaker.failureRate);
+            breaker.minCalls = static_cast<size_t>(args.getInt("breaker-min-requests", breaker.minCalls));
+            breaker.slowCall = std::chrono::milliseconds(args.getInt("breaker-slow-ms", breaker.slowCall.count()));
+            breaker.openFor = std::chrono::milliseconds(args.getInt("breaker-open-ms", breaker.openFor.count()));
+            // History forwarded with each message, e.g. --context-tokens=32000 --context-trim-step=8
+            DeepSeekPromptOptions prompt_options;
+            prompt_options.contextTokens = static_cast<size_t>(args.getInt("context-tokens", prompt_options.contextTokens));
+            prompt_options.trimStep = static_cast<size_t>(args.getInt("context-trim-step", prompt_options.trimStep));
+            backend = std::make_unique<DeepSeekBackend>(DEEPSEEK_API_KEY, retry_options, prompt_options);
+        } else {
+            std::cerr << "Unknown --backend=" << backend_name << " (deepseek or mock)" << std::endl;
             return 1;
         }
+        std::cout << "Backend: " << backend->name() << std::endl;
+        int http_port = static_cast<int>(args.getInt("port", 8888));
+
+        // Spend per conversation and client, priced in USD per million tokens, e.g.
+        //   --price-input=0.27 --price-cached-input=0.07 --price-output=1.10
+        UsageAccounting::Options usage_options;
+        usage_options.pricing.inputCacheMiss = args.getDouble("price-input", usage_options.pricing.inputCacheMiss);
+        usage_options.pricing.inputCacheHit = args.getDouble("price-cached-input", usage_options.pricing.inputCacheHit);
+        usage_options.pricing.output = args.getDouble("price-output", usage_options.pricing.output);
+        usage_options.maxKeys = static_cast<size_t>(args.getInt("usage-max-keys", usage_options.maxKeys));
+        UsageAccounting usage(usage_options);
 
-        // Create DeepSeek client
-        DeepSeekChat deepseek(DEEPSEEK_API_KEY);
+        // --cache-tier: proxy_server's response cache and sessions in this process,
+        // so a co-located deployment answers hits without the proxy hop. Same flags
+        // as the proxy: --cache-capacity --cache-slices --max-cache-tokens --fresh-ttl-ms
+        std::unique_ptr<ProxyCacheTier> cache_tier;
+        if (args.getBool("cache-tier", false)) {
+            ProxyCacheTier::Options tier_options;
+            tier_options.capacity = static_cast<size_t>(args.getInt("cache-capacity", tier_options.capacity));
+            tier_options.slices = static_cast<int>(args.getInt("cache-slices", tier_options.slices));
+            tier_options.maxCacheTokens = static_cast<int>(args.getInt("max-cache-tokens", tier_options.maxCacheTokens));
+            tier_options.freshness.fresh = std::chrono::milliseconds(args.getInt("fresh-ttl-ms", tier_options.freshness.fresh.count()));
+            tier_options.sessionLimits.contextTurns = static_cast<size_t>(args.getInt("cache-context-turns", tier_options.sessionLimits.contextTurns));
+            tier_options.threadCacheEntries = static_cast<size_t>(args.getInt("l1-entries", 0));
+            tier_options.hotKeyReplicas = static_cast<size_t>(args.getInt("hot-key-replicas", tier_options.hotKeyReplicas));
+            tier_options.slicePools = args.getBool("slice-pools", tier_options.slicePools);
+            if (const char* tokenizer_file = std::getenv("DEEPSEEK_TOKENIZER_FILE")) {
+                tier_options.tokenizerFile = tokenizer_file;
+            }
+            cache_tier = std::make_unique<ProxyCacheTier>(tier_options);
+            std::cout << "In-process cache tier: capacity " << tier_options.capacity << std::endl;
+        }
 
         // Handle message POST request
-        svr.Post("/api/message", [&deepseek](const httplib::Request &req, httplib::Response &res) {
+        svr.Post("/api/message", [&backend, &usage, &cache_tier](const httplib::Request &req, httplib::Response &res) {
             try {
                 auto json = nlohmann::json::parse(req.body);
                 std::string message = json["message"];
-                // std::string conversationId = json.value("conversationId", "");
+                std::string conversationId = json.value("conversationId", "");
+                auto history = parseHistory(json);
+                std::string client = clientId(req);
+                auto deadline = requestDeadline(req);
+                if (deadline <= std::chrono::steady_clock::now()) {
+                    throw BackendError(504, "Deadline exceeded before the request was handled");
+                }
 
-                // Send message to DeepSeek
-                auto response = deepseek.sendMessage(message);
+                // In-process tier: fresh hits never reach the backend; stale and
+                // expired entries are refreshed on the request path
+                ProxyCacheTier::Lookup lookup;
+                if (cache_tier) {
+                    lookup = cache_tier->prepare(message, conversationId);
+                    std::shared_ptr<const CachedResponse> cached;
+                    FreshnessPolicy::State state;
+                    if (cache_tier->find(lookup, std::chrono::steady_clock::now(), cached, state) &&
+                        state == FreshnessPolicy::State::Fresh) {
+                        LOG_INFO("event=cache_hit conversation=%s", conversationId.c_str());
+                        cache_tier->stats().hits++;
+                        usage.recordAvoided(conversationId, client, cached->usage);
+                        std::string body;
+                        renderCachedResponse(*cached, conversationId, body);
+                        res.set_content(std::move(body), "application/json");
+                        cache_tier->recordExchange(conversationId, message, cached->content);
+                        return;
+                    }
+                    cache_tier->stats().misses++;
+                    if (history.empty()) {
+                        sessionHistory(cache_tier->sessions(), conversationId, history);
+                    }
+                }
 
-                // Construct response
+                // Send message to the backend
+                LOG_INFO("event=message bytes=%zu est_tokens=%zu history=%zu", message.size(), Tokenizer::estimate(message), history.size());
+                auto response = backend->complete(history, message, deadline);
+                LOG_INFO("event=reply role=%s bytes=%zu prompt_tokens=%d cache_hit_tokens=%d completion_tokens=%d",
+                         response.role.c_str(), response.content.size(), response.promptTokens, response.cacheHitTokens, response.completionTokens);
+
+                UsageSample sample;
+                sample.promptTokens = static_cast<uint64_t>(response.promptTokens);
+                sample.cacheHitTokens = static_cast<uint64_t>(response.cacheHitTokens);
+                sample.completionTokens = static_cast<uint64_t>(response.completionTokens);
+                usage.recordSpent(conversationId, client, sample);
+
+                if (cache_tier) {
+                    CachedResponse entry = makeCachedResponse(std::move(response.content), std::move(response.role));
+                    entry.usage = sample;
+                    cache_tier->store(lookup, entry);
+                    cache_tier->recordExchange(conversationId, message, entry.content);
+                    std::string body;
+                    renderCachedResponse(entry, conversationId, body);
+                    res.set_content(std::move(body), "application/json");
+                    return;
+                }
+
+                // Construct response; usage lets a cache in front credit what its hits save
                 nlohmann::json response_json;
                 // response_json["conversationId"] = conversationId;
                 response_json["content"] = response.content;
                 response_json["role"] = response.role;
+                response_json["usage"] = {
+                    {"prompt_tokens", response.promptTokens},
+                    {"completion_tokens", response.completionTokens},
+                    {"prompt_cache_hit_tokens", response.cacheHitTokens}
+                };
                 
                 res.set_content(response_json.dump(), "application/json");
 
+            } catch (const BackendError& e) {
+                LOG_WARN("event=backend_error status=%d error=\"%s\"", e.status(), e.what());
+                sendBackendError(e, res);
             } catch (const std::exception& e) {
-                std::cerr << "Error processing message: " << e.what() << std::endl;
+                LOG_ERROR("event=message_error error=\"%s\"", e.what());
                 nlohmann::json error = {
                     {"error", std::string("Error processing message: ") + e.what()}
                 };
@@ -63,13 +268,122 @@ int main() {
             }
         });
 
+        // Same request, reply streamed as server-sent events:
+        //   data: {"content":"<piece>"} ... data: [DONE]
+        svr.Post("/api/message/stream", [&backend, &usage](const httplib::Request &req, httplib::Response &res) {
+            std::string message;
+            std::string conversationId;
+            LlmBackend::History history;
+            try {
+                auto json = nlohmann::json::parse(req.body);
+                message = json.at("message").get<std::string>();
+                conversationId = json.value("conversationId", "");
+                history = parseHistory(json);
+            } catch (const std::exception& e) {
+                res.status = 400;
+                res.set_content(nlohmann::json{{"error", e.what()}}.dump(), "application/json");
+                return;
+            }
+            LOG_INFO("event=message_stream bytes=%zu history=%zu", message.size(), history.size());
+
+            std::string client = clientId(req);
+            auto deadline = requestDeadline(req);
+            res.set_chunked_content_provider("text/event-stream", [&backend, &usage, message, history, conversationId, client, deadline](size_t, httplib::DataSink &sink) {
+                std::string event;
+                try {
+                    auto reply = backend->stream(history, message, deadline, [&sink, &event](std::string_view piece) {
+                        event = "data: {\"content\":\"";
+                        JsonScanner::appendEscaped(event, piece);
+                        event += "\"}\n\n";
+                        return sink.write(event.data(), event.size());
+                    });
+                    LOG_INFO("event=reply_streamed bytes=%zu", reply.content.size());
+                    UsageSample sample;
+                    sample.promptTokens = static_cast<uint64_t>(reply.promptTokens);
+                    sample.cacheHitTokens = static_cast<uint64_t>(reply.cacheHitTokens);
+                    sample.completionTokens = static_cast<uint64_t>(reply.completionTokens);
+                    usage.recordSpent(conversationId, client, sample);
+                    event = "data: [DONE]\n\n";
+                } catch (const std::exception& e) {
+                    LOG_WARN("event=stream_error error=\"%s\"", e.what());
+                    event = "data: {\"error\":\"";
+                    JsonScanner::appendEscaped(event, e.what());
+                    event += "\"}\n\n";
+                }
+                sink.write(event.data(), event.size());
+                sink.done();
+                return true;
+            });
+        });
+
+        // Attempts, retries, hedges and budget exhaustion of the upstream client
+        svr.Get("/api/metrics/backend", [&backend, &cache_tier](const httplib::Request &, httplib::Response &res) {
+            nlohmann::json response = {
+                {"backend", backend->name()},
+                {"stats", backend->stats()}
+            };
+            if (cache_tier) {
+                response["cache"] = cache_tier->statsJson();
+            }
+            res.set_content(response.dump(), "application/json");
+        });
+
+        // Token spend and cost: totals, rates over the last minute / window, top
+        // conversations and clients (?top=N), one row with ?conversation=ID or ?client=ID
+        svr.Get("/api/usage", [&usage](const httplib::Request &req, httplib::Response &res) {
+            uint64_t top = 10;
+            if (req.has_param("top") && !parseUnsigned(req.get_param_value("top"), top)) {
+                res.status = 400;
+                res.set_content(nlohmann::json{{"error", "top must be a non-negative integer"}}.dump(), "application/json");
+                return;
+            }
+            // The top-N tables are built under the shard locks, so keep N small
+            top = std::max<uint64_t>(1, std::min<uint64_t>(top, 100));
+            auto report = usage.report(top, req.get_param_value("conversation"), req.get_param_value("client"));
+            res.set_content(report.dump(), "application/json");
+        });
+
+        // Conversation list and history for the chat page, when the tier keeps sessions
+        if (cache_tier) {
+            svr.Get("/api/session/list", [&cache_tier](const httplib::Request &req, httplib::Response &res) {
+                uint64_t cursor = 0;
+                uint64_t limit = 50;
+                if ((req.has_param("cursor") && !parseUnsigned(req.get_param_value("cursor"), cursor)) ||
+                    (req.has_param("limit") && !parseUnsigned(req.get_param_value("limit"), limit))) {
+                    res.status = 400;
+                    res.set_content(nlohmann::json{{"error", "cursor and limit must be non-negative integers"}}.dump(), "application/json");
+                    return;
+                }
+                limit = std::max<uint64_t>(1, std::min<uint64_t>(limit, 500));
+                try {
+                    res.set_content(cache_tier->sessionPage(cursor, limit).dump(), "application/json");
+                } catch (const std::exception& e) {
+                    res.status = 500;
+                    res.set_content(nlohmann::json{{"error", e.what()}}.dump(), "application/json");
+                }
+            });
+
+            svr.Get("/api/session/:id", [&cache_tier](const httplib::Request &req, httplib::Response &res) {
+                nlohmann::json response;
+                if (cache_tier->sessionDetail(req.path_params.at("id"), response)) {
+                    res.set_content(response.dump(), "application/json");
+                } else {
+                    res.status = 404;
+                    res.set_content(nlohmann::json{{"error", "Session not found"}}.dump(), "application/json");
+                }
+            });
+        }
+
         // Add a simple health check endpoint
         svr.Get("/api/hello", [](const httplib::Request &, httplib::Response &res) {
             res.set_content("Hello from DeepSeek server!", "text/plain");
         });
 
-        std::cout << "Server running on http://0.0.0.0:8888" << std::endl;
-        svr.listen("0.0.0.0", 8888);
+        static_assets.mount(svr);
+
+        std::cout << "Server running on http://0.0.0.0:" << http_port << std::endl;
+        svr.listen("0.0.0.0", http_port);
+        AsyncLogger::instance().stop();
 
     } catch (const std::exception& e) {
         std::cerr << "Server initialization error: " << e.what() << std::endl;
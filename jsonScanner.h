@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// On-demand JSON field extraction for hot request paths.
+//
+// Instead of building a DOM, the scanner walks the document once, skipping values
+// it is not asked for, and hands back views into the original buffer. Only string
+// values that actually contain escapes are copied (into a caller-owned buffer
+// whose capacity is reused). The scanner validates what it walks over but is not
+// a full validator: callers fall back to nlohmann::json when it returns false.
+class JsonScanner {
+public:
+    // A path step is either an object key or an array index
+    struct Step {
+        Step(const char* key) : key(key), index(-1) {}
+        Step(std::string_view key) : key(key), index(-1) {}
+        Step(int index) : key(), index(index) {}
+
+        std::string_view key;
+        int index;
+    };
+
+    explicit JsonScanner(std::string_view json) : json_(json) {}
+
+    // Raw value text at path (strings without their quotes, still escaped)
+    bool findRaw(std::initializer_list<Step> path, std::string_view& raw, bool& isString) const {
+        size_t pos = 0;
+        skipSpace(pos);
+        for (const Step& step : path) {
+            if (!(step.index >= 0 ? enterIndex(pos, step.index) : enterKey(pos, step.key))) {
+                return false;
+            }
+        }
+
+        size_t start = pos;
+        if (pos < json_.size() && json_[pos] == '"') {
+            size_t end = pos;
+            if (!skipString(end)) {
+                return false;
+            }
+            raw = json_.substr(start + 1, end - start - 2);
+            isString = true;
+            return true;
+        }
+        if (!skipValue(pos)) {
+            return false;
+        }
+        raw = json_.substr(start, pos - start);
+        isString = false;
+        return true;
+    }
+
+    // String value at path, unescaped; false if missing or not a string
+    bool findString(std::initializer_list<Step> path, std::string& out) const {
+        std::string_view raw;
+        bool isString = false;
+        return findRaw(path, raw, isString) && isString && unescape(raw, out);
+    }
+
+    // Integer value at path; false if missing or not an integer
+    bool findInt(std::initializer_list<Step> path, int64_t& out) const {
+        std::string_view raw;
+        bool isString = false;
+        if (!findRaw(path, raw, isString) || isString || raw.empty()) {
+            return false;
+        }
+        int64_t value = 0;
+        size_t i = raw[0] == '-' ? 1 : 0;
+        if (i == raw.size()) {
+            return false;
+        }
+        for (; i < raw.size(); ++i) {
+            if (raw[i] < '0' || raw[i] > '9') {
+                return false;
+            }
+            value = value * 10 + (raw[i] - '0');
+        }
+        out = raw[0] == '-' ? -value : value;
+        return true;
+    }
+
+    // Decode the body of a JSON string (without quotes) into UTF-8
+    static bool unescape(std::string_view raw, std::string& out) {
+        out.clear();
+        if (raw.find('\\') == std::string_view::npos) {
+            out.assign(raw.data(), raw.size());
+            return true;
+        }
+
+        out.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); ++i) {
+            char c = raw[i];
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (++i >= raw.size()) {
+                return false;
+            }
+            switch (raw[i]) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!readHex4(raw, i + 1, cp)) {
+                        return false;
+                    }
+                    i += 4;
+                    // Surrogate pair
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        uint32_t low;
+                        if (i + 2 >= raw.size() || raw[i + 1] != '\\' || raw[i + 2] != 'u' ||
+                            !readHex4(raw, i + 3, low) || low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return false;
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Append text as the body of a JSON string (no surrounding quotes)
+    static void appendEscaped(std::string& out, std::string_view text) {
+        static const char* hex = "0123456789abcdef";
+        size_t plain = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            out.append(text.data() + plain, i - plain);
+            plain = i + 1;
+            switch (c) {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\b': out.append("\\b"); break;
+                case '\f': out.append("\\f"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default: {
+                    char buf[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                    out.append(buf, 6);
+                }
+            }
+        }
+        out.append(text.data() + plain, text.size() - plain);
+    }
+
+private:
+    static bool readHex4(std::string_view s, size_t pos, uint32_t& value) {
+        if (pos + 4 > s.size()) {
+            return false;
+        }
+        value = 0;
+        for (size_t i = pos; i < pos + 4; ++i) {
+            char c = s[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    void skipSpace(size_t& pos) const {
+        while (pos < json_.size() &&
+               (json_[pos] == ' ' || json_[pos] == '\n' || json_[pos] == '\r' || json_[pos] == '\t')) {
+            ++pos;
+        }
+    }
+
+    // pos at the opening quote; leaves pos after the closing quote
+    bool skipString(size_t& pos) const {
+        ++pos;
+        while (pos < json_.size()) {
+            const char* quote = static_cast<const char*>(
+                std::memchr(json_.data() + pos, '"', json_.size() - pos));
+            if (!quote) {
+                return false;
+            }
+            size_t end = quote - json_.data();
+            // The quote is escaped if preceded by an odd number of backslashes
+            size_t backslashes = 0;
+            while (end - backslashes > pos && json_[end - backslashes - 1] == '\\') {
+                ++backslashes;
+            }
+            pos = end + 1;
+            if (backslashes % 2 == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool skipLiteral(size_t& pos) const {
+        size_t start = pos;
+        while (pos < json_.size()) {
+            char c = json_[pos];
+            bool literal = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                           c == '-' || c == '+' || c == '.' || c == 'E';
+            if (!literal) {
+                break;
+            }
+            ++pos;
+        }
+        return pos > start;
+    }
+
+    // Skip any value starting at pos; containers are skipped by bracket depth
+    bool skipValue(size_t& pos) const {
+        skipSpace(pos);
+        if (pos >= json_.size()) {
+            return false;
+        }
+        char c = json_[pos];
+        if (c == '"') {
+            return skipString(pos);
+        }
+        if (c != '{' && c != '[') {
+            return skipLiteral(pos);
+        }
+
+        int depth = 0;
+        while (pos < json_.size()) {
+            c = json_[pos];
+            if (c == '"') {
+                if (!skipString(pos)) {
+                    return false;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    ++pos;
+                    return true;
+                }
+            }
+            ++pos;
+        }
+        return false;
+    }
+
+    // pos at an object; on success pos is at the value for key
+    bool enterKey(size_t& pos, std::string_view key) const {
+        skipSpace(pos);
+        if (pos >= json_.size() || json_[pos] != '{') {
+            return false;
+        }
+        ++pos;
+        while (true) {
+            skipSpace(pos);
+            if (pos >= json_.size() || json_[pos] != '"') {
+                return false;
+            }
+            size_t keyStart = pos + 1;
+            if (!skipString(pos)) {
+                return false;
+            }
+            std::string_view name = json_.substr(keyStart, pos - keyStart - 1);
+            skipSpace(pos);
+            if (pos >= json_.size() || json_[pos] != ':') {
+                return false;
+            }
+            ++pos;
+            skipSpace(pos);
+            // Keys with escapes never match; the fallback parser handles those
+            if (name == key) {
+                return true;
+            }
+            if (!skipValue(pos)) {
+                return false;
+            }
+            skipSpace(pos);
+            if (pos < json_.size() && json_[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            return false;
+        }
+    }
+
+    // pos at an array; on success pos is at element `index`
+    bool enterIndex(size_t& pos, int index) const {
+        skipSpace(pos);
+        if (pos >= json_.size() || json_[pos] != '[') {
+            return false;
+        }
+        ++pos;
+        for (int i = 0; ; ++i) {
+            skipSpace(pos);
+            if (pos >= json_.size() || json_[pos] == ']') {
+                return false;
+            }
+            if (i == index) {
+                return true;
+            }
+            if (!skipValue(pos)) {
+                return false;
+            }
+            skipSpace(pos);
+            if (pos < json_.size() && json_[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            return false;
+        }
+    }
+
+private:
+    std::string_view json_;
+};
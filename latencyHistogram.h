@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// HDR-style log-linear latency histogram.
+//
+// Values (microseconds) below 64 get their own bucket; above that every power of
+// two is split into 32 linear sub-buckets, so any recorded value is reported
+// within ~3%. Recording is a relaxed fetch_add into one of a few shards picked
+// per thread, so concurrent handlers don't share a counter line and never lock.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr uint64_t kSubBuckets = 1ULL << kSubBucketBits;      // 32
+    static constexpr int kMaxExponent = 36;                               // ~2^41 us, about 25 days
+    static constexpr size_t kBucketCount = 2 * kSubBuckets + kMaxExponent * kSubBuckets;
+    static constexpr size_t kShards = 8;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts = std::vector<uint64_t>(kBucketCount, 0);
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        void merge(const Snapshot& other) {
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                counts[i] += other.counts[i];
+            }
+            count += other.count;
+            sum += other.sum;
+            max = std::max(max, other.max);
+        }
+
+        // Counts since `earlier` was taken; max stays the all-time max
+        Snapshot since(const Snapshot& earlier) const {
+            Snapshot delta;
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                delta.counts[i] = counts[i] - earlier.counts[i];
+            }
+            delta.count = count - earlier.count;
+            delta.sum = sum - earlier.sum;
+            delta.max = max;
+            return delta;
+        }
+
+        double mean() const {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+        }
+
+        // Value at quantile q (0..1), reported as the midpoint of its bucket
+        uint64_t percentile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    uint64_t low = bucketLowerBound(i);
+                    uint64_t high = bucketLowerBound(i + 1);
+                    return std::min(max, low + (high - low) / 2);
+                }
+            }
+            return max;
+        }
+    };
+
+    void record(uint64_t micros) {
+        Shard& shard = shards_[shardIndex()];
+        shard.counts[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(micros, std::memory_order_relaxed);
+
+        uint64_t current = shard.max.load(std::memory_order_relaxed);
+        while (micros > current &&
+               !shard.max.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        record(static_cast<uint64_t>(micros > 0 ? micros : 0));
+    }
+
+    Snapshot snapshot() const {
+        Snapshot result;
+        for (const auto& shard : shards_) {
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                result.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+            }
+            result.count += shard.count.load(std::memory_order_relaxed);
+            result.sum += shard.sum.load(std::memory_order_relaxed);
+            result.max = std::max(result.max, shard.max.load(std::memory_order_relaxed));
+        }
+        return result;
+    }
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < 2 * kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        int msb = 63 - __builtin_clzll(value);
+        int exponent = msb - kSubBucketBits;
+        if (exponent > kMaxExponent) {
+            return kBucketCount - 1;
+        }
+        uint64_t mantissa = value >> exponent;                  // in [32, 63]
+        return static_cast<size_t>(2 * kSubBuckets + (exponent - 1) * kSubBuckets + (mantissa - kSubBuckets));
+    }
+
+    static uint64_t bucketLowerBound(size_t index) {
+        if (index < 2 * kSubBuckets) {
+            return index;
+        }
+        size_t rest = index - 2 * kSubBuckets;
+        int exponent = static_cast<int>(rest / kSubBuckets) + 1;
+        uint64_t mantissa = kSubBuckets + rest % kSubBuckets;
+        return mantissa << exponent;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBucketCount> counts{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    // Threads are spread round-robin over the shards on their first record
+    static size_t shardIndex() {
+        static std::atomic<size_t> nextShard{0};
+        thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    std::array<Shard, kShards> shards_;
+};
+
+// Named latency series. Series are registered at startup; after that lookups are
+// plain references and recording never takes the registry lock.
+class LatencyRegistry {
+public:
+    LatencyHistogram& series(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : series_) {
+            if (entry.first == name) {
+                return *entry.second;
+            }
+        }
+        series_.emplace_back(name, std::make_unique<LatencyHistogram>());
+        return *series_.back().second;
+    }
+
+    std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> snapshotAll() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> result;
+        result.reserve(series_.size());
+        for (const auto& entry : series_) {
+            result.emplace_back(entry.first, entry.second->snapshot());
+        }
+        return result;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, std::unique_ptr<LatencyHistogram>>> series_;
+};
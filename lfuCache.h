@@ -1,13 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <thread>
+#include <climits>
 #include <cmath>
 
 #include "cachePolicy.h"
+#include "cacheMemory.h"
+#include "coreRouter.h"
+#include "threadCache.h"
+#include "hotKeys.h"
 
 namespace CacheImpl
 {
@@ -25,8 +33,17 @@ namespace CacheImpl
                 std::weak_ptr<Node> prev;
                 std::shared_ptr<Node> next;
 
-                Node()
+                explicit Node(std::pmr::memory_resource* resource)
                     : freq(1)
+                    , key(makeWithResource<Key>(resource))
+                    , value(makeWithResource<Value>(resource))
+                    , next(nullptr)
+                {}
+
+                Node(const Key& key, const Value& value, std::pmr::memory_resource* resource)
+                    : freq(1)
+                    , key(makeWithResource<Key>(resource, key))
+                    , value(makeWithResource<Value>(resource, value))
                     , next(nullptr)
                 {}
             };
@@ -37,11 +54,11 @@ namespace CacheImpl
             NodePtr tail_;
         
         public:
-            explicit FreqList(int n)
+            explicit FreqList(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
                 : freq_(n)
             {
-                head_ = std::make_shared<Node>();
-                tail_ = std::make_shared<Node>();
+                head_ = allocateShared<Node>(resource, resource);
+                tail_ = allocateShared<Node>(resource, resource);
                 head_->next = tail_;
                 tail_->prev = head_;
             }
@@ -85,41 +102,60 @@ namespace CacheImpl
         public:
             using Node = typename FreqList<Key, Value>::Node;
             using NodePtr = std::shared_ptr<Node>;
-            using NodeMap = std::unordered_map<Key, NodePtr>;
+            using NodeMap = std::pmr::unordered_map<Key, NodePtr>;
+            using FreqListPtr = std::shared_ptr<FreqList<Key, Value>>;
 
-            LfuCache(int capacity, int maxAverageNum = 1000000)
+            // 节点、频次链表与哈希表从 resource 分配（见 cacheMemory.h），须比缓存活得久
+            LfuCache(int capacity, int maxAverageNum = 1000000,
+                     std::pmr::memory_resource* resource = std::pmr::get_default_resource())
                 : capacity_(capacity)
                 , minFreq_(1)
                 , maxAverageNum_(maxAverageNum)
                 , curAverageNum_(0)
                 , curTotalNum_(0)
+                , resource_(resource)
+                , nodeMap_(resource)
+                , freqMap_(resource)
             {
                 // 预分配最小频率的 FreqList
-                freqMap_[1] = std::make_unique<FreqList<Key, Value>>(1);
+                freqMap_[1] = makeFreqList(1);
             }
 
             ~LfuCache() override = default;
 
             void put(Key key, Value value) override
             {
-                if (capacity_ == 0)
-                    return ;
-                
+                // capacity_ 可被 resize() 并发修改，须在锁内读取
+                std::lock_guard<std::mutex> lock(mutex_);
+                putUnlocked(key, value);
+            }
+
+            bool get(Key key, Value& value) override
+            {
                 std::lock_guard<std::mutex> lock(mutex_);
+                return getUnlocked(key, value);
+            }
+
+            // 不加分片锁的 put/get：调用方须保证没有其他线程同时访问本分片，
+            // 如 thread-per-core 模式下由 CoreRouter 的核心互斥保证
+            void putUnlocked(const Key& key, const Value& value)
+            {
+                if (capacity_ <= 0)
+                    return ;
+
                 auto it = nodeMap_.find(key);
                 if (it != nodeMap_.end())
                 {
                     it->second->value = value;
-                    getKV(it->second, value);
+                    touch(it->second);
                     return ;
                 }
 
                 addKV(key, value);
             }
 
-            bool get(Key key, Value& value) override
+            bool getUnlocked(const Key& key, Value& value)
             {
-                std::lock_guard<std::mutex> lock(mutex_);
                 auto it = nodeMap_.find(key);
                 if (it != nodeMap_.end())
                 {
@@ -138,19 +174,118 @@ namespace CacheImpl
 
             void purge()
             {
+                std::lock_guard<std::mutex> lock(mutex_);
                 nodeMap_.clear();
                 freqMap_.clear();
                 // 重新创建最小频率的 FreqList
-                freqMap_[1] = std::make_unique<FreqList<Key, Value>>(1);
+                freqMap_[1] = makeFreqList(1);
                 minFreq_ = 1;
                 curAverageNum_ = 0;
                 curTotalNum_ = 0;
             }
 
+            // 运行时调整容量。缩容时本次最多淘汰 kEvictBatch 个，剩余超额由之后的 put 分摊。
+            // 返回仍超出容量的条目数
+            size_t resize(int capacity)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                capacity_ = capacity;
+                return evictOverflow(kEvictBatch);
+            }
+
+            size_t size()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return nodeMap_.size();
+            }
+
+            // 以下供分片迁移（online rehash）使用，频次随条目一起迁移
+
+            // 取出 key 对应的条目及其频次并从本缓存删除
+            bool extract(Key key, Value& value, int& freq)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = nodeMap_.find(key);
+                if (it == nodeMap_.end())
+                    return false;
+
+                NodePtr node = it->second;
+                value = node->value;
+                freq = node->freq;
+                removeNode(node);
+                return true;
+            }
+
+            // 取出任意一个条目（按频次表的哈希顺序，不保证先取高频），用于后台迁移
+            bool extractAny(Key& key, Value& value, int& freq)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto it = freqMap_.begin(); it != freqMap_.end(); ++it)
+                {
+                    if (!it->second || it->second->isEmpty())
+                        continue;
+                    NodePtr node = it->second->getFirstNode();
+                    key = node->key;
+                    value = node->value;
+                    freq = node->freq;
+                    removeNode(node);
+                    return true;
+                }
+                return false;
+            }
+
+            // 按给定频次插入；已存在时保留现有条目
+            void insertWithFreq(const Key& key, const Value& value, int freq)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (capacity_ <= 0 || nodeMap_.count(key))
+                    return ;
+                if (nodeMap_.size() >= static_cast<size_t>(capacity_))
+                    kickOut();
+
+                NodePtr node = allocateShared<Node>(resource_, key, value, resource_);
+                node->freq = std::max(1, freq);
+                nodeMap_[key] = node;
+                addToFreqList(node);
+                minFreq_ = nodeMap_.size() == 1 ? node->freq : std::min(minFreq_, node->freq);
+
+                curTotalNum_ += node->freq;
+                curAverageNum_ = curTotalNum_ / nodeMap_.size();
+            }
+
         private:
+            static constexpr size_t kEvictBatch = 16;
+
+            size_t evictOverflow(size_t maxEvict)
+            {
+                size_t limit = static_cast<size_t>(std::max(capacity_, 0));
+                size_t evicted = 0;
+                while (nodeMap_.size() > limit && evicted < maxEvict)
+                {
+                    kickOut();
+                    ++evicted;
+                }
+                return nodeMap_.size() > limit ? nodeMap_.size() - limit : 0;
+            }
+
+            void removeNode(NodePtr node)
+            {
+                removeFromFreqList(node);
+                nodeMap_.erase(node->key);
+                decreaseFreqNum(node->freq);
+                if (node->freq == minFreq_)
+                    updateMinFreq();
+            }
+
             void getKV(NodePtr node, Value& value)
             {
                 value = node->value;
+                touch(node);
+            }
+
+            // 访问一次：频次加一并移到对应的频次链表
+            void touch(NodePtr node)
+            {
                 removeFromFreqList(node);
                 node->freq++;
                 addToFreqList(node);
@@ -165,23 +300,37 @@ namespace CacheImpl
 
             void addKV(Key key, Value value)
             {
-                if (nodeMap_.size() >= capacity_)
+                if (nodeMap_.size() >= static_cast<size_t>(capacity_))
+                {
                     kickOut();
+                    // 缩容后剩余的超额在这里分批淘汰
+                    evictOverflow(kEvictBatch);
+                }
                 
-                NodePtr node = std::make_shared<Node>();
-                node->key = key;
-                node->value = value;
+                NodePtr node = allocateShared<Node>(resource_, key, value, resource_);
                 nodeMap_[key] = node;
                 addToFreqList(node);
+                // 新条目频次为 1，一定是当前最小频次
+                minFreq_ = 1;
                 increaseFreqNum();
             }
 
             void kickOut()
             {
-                if (freqMap_.empty() || !freqMap_[minFreq_])
+                if (freqMap_.empty())
                     return;
 
-                NodePtr node = freqMap_[minFreq_]->getFirstNode();
+                // minFreq_ 对应的链表可能已被取空（extract / 频次衰减），先校正
+                auto it = freqMap_.find(minFreq_);
+                if (it == freqMap_.end() || !it->second || it->second->isEmpty())
+                {
+                    updateMinFreq();
+                    it = freqMap_.find(minFreq_);
+                    if (it == freqMap_.end() || !it->second || it->second->isEmpty())
+                        return;
+                }
+
+                NodePtr node = it->second->getFirstNode();
                 if (!node)
                     return;
 
@@ -210,12 +359,17 @@ namespace CacheImpl
                 auto freq = node->freq;
                 if (freqMap_.find(freq) == freqMap_.end())
                 {
-                    freqMap_[freq] = std::make_unique<FreqList<Key, Value>>(freq);
+                    freqMap_[freq] = makeFreqList(freq);
                 }
 
                 freqMap_[freq]->addNode(node);
             }
 
+            FreqListPtr makeFreqList(int freq)
+            {
+                return allocateShared<FreqList<Key, Value>>(resource_, freq, resource_);
+            }
+
             void increaseFreqNum()
             {
                 curTotalNum_++;
@@ -243,23 +397,36 @@ namespace CacheImpl
             {
                 if (nodeMap_.empty())
                     return ;
-                
+
+                // 总频次按衰减后的值重新累计，否则平均值一直高于上限，之后每次访问都会重新衰减一遍
+                curTotalNum_ = 0;
                 for (auto it = nodeMap_.begin(); it != nodeMap_.end(); ++it)
                 {
                     if (!it->second)
                         continue;
-                    
+
                     NodePtr node = it->second;
                     removeFromFreqList(node);
                     node->freq = std::max(1, node->freq - maxAverageNum_ / 2);
                     addToFreqList(node);
+                    curTotalNum_ += node->freq;
+                }
+                curAverageNum_ = curTotalNum_ / nodeMap_.size();
+
+                // 顺带删掉空的频次链表，freqMap_ 才不会随最热条目的频次一直增长
+                for (auto it = freqMap_.begin(); it != freqMap_.end();)
+                {
+                    if (it->first != 1 && (!it->second || it->second->isEmpty()))
+                        it = freqMap_.erase(it);
+                    else
+                        ++it;
                 }
                 updateMinFreq();
             }
 
             void updateMinFreq()
             {
-                minFreq_ = INT8_MAX;
+                minFreq_ = INT_MAX;
                 for (const auto& pair : freqMap_)
                 {
                     if (pair.second && !pair.second->isEmpty())
@@ -267,7 +434,7 @@ namespace CacheImpl
                         minFreq_ = std::min(minFreq_, pair.first);
                     }
                 }
-                if (minFreq_ == INT8_MAX)
+                if (minFreq_ == INT_MAX)
                     minFreq_ = 1;
             }
 
@@ -278,35 +445,170 @@ namespace CacheImpl
             int curAverageNum_;
             int curTotalNum_;
             std::mutex mutex_;
+            std::pmr::memory_resource* resource_;
             NodeMap nodeMap_;
-            std::unordered_map<int, std::unique_ptr<FreqList<Key, Value>>> freqMap_;
+            std::pmr::unordered_map<int, FreqListPtr> freqMap_;
     };
 
     template <typename Key, typename Value>
     class HashLfuCache
     {
+        private:
+            using Slice = LfuCache<Key, Value>;
+
+            struct Table
+            {
+                std::vector<std::unique_ptr<SlicePool>> pools;      // 每个分片一个，须在 slices 之后销毁
+                std::vector<std::unique_ptr<Slice>> slices;
+
+                size_t sliceIndex(const Key& key) const
+                {
+                    return std::hash<Key>()(key) % slices.size();
+                }
+
+                Slice& sliceFor(const Key& key) const
+                {
+                    return *slices[sliceIndex(key)];
+                }
+            };
+
         public:
-            HashLfuCache(size_t capacity, int sliceNum, int maxAverageNum = 10)
+            // pooled 为 true 时每个分片从自己的 SlicePool 分配节点（见 cacheMemory.h），否则用全局分配器
+            HashLfuCache(size_t capacity, int sliceNum, int maxAverageNum = 10, bool pooled = true)
                 : capacity_(capacity)
-                , sliceNum_(sliceNum > 0 ? sliceNum : std::thread::hardware_concurrency())
+                , maxAverageNum_(maxAverageNum)
+                , pooled_(pooled)
+                , current_(makeTable(capacity, sliceNum > 0 ? sliceNum : std::thread::hardware_concurrency(),
+                                     maxAverageNum, pooled))
+                , migrating_(false)
+                , sliceCountHint_(current_->slices.size())
+            {}
+
+            void put(Key key, Value value)
+            {
+                if (router_)
+                {
+                    size_t index = current_->sliceIndex(key);
+                    Slice& slice = *current_->slices[index];
+                    withSlice(index, [&]() { slice.putUnlocked(key, value); });
+                    if (l1_.enabled())
+                        l1_.invalidate(key);
+                    return;
+                }
+
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    if (previous_)
+                    {
+                        // 先把旧表中的频次带过来，再写入新值
+                        adoptLocked(key, nullptr);
+                    }
+                    current_->sliceFor(key).put(key, value);
+                }
+                // 写完分片再推进纪元，各线程 L1 中该 key 的旧值随之失效
+                l1_.invalidate(key);
+                migrateIfNeeded();
+            }
+
+            bool get(Key key, Value& value)
             {
-                size_t sliceSize = std::ceil(capacity_ / static_cast<double>(sliceNum_));
-                for (int i = 0; i < sliceNum_; ++i)
+                if (router_)
                 {
-                    lfuSliceCaches_.emplace_back(new LfuCache<Key, Value>(sliceSize, maxAverageNum));
+                    bool found = false;
+                    size_t index = current_->sliceIndex(key);
+                    Slice& slice = *current_->slices[index];
+                    withSlice(index, [&]() { found = slice.getUnlocked(key, value); });
+                    return found;
                 }
+                if (l1_.enabled() || hot_.enabled())
+                {
+                    std::shared_ptr<const Value> shared;
+                    if (!getShared(key, shared))
+                        return false;
+                    value = *shared;
+                    return true;
+                }
+                return load(key, value);
             }
 
-            void put(Key key, Value value)
+            // 命中时共享同一份不可变值；开启 L1 后热点 key 在本线程 L1 命中，不加锁也不拷贝；
+            // 开启热点复制后，被检测为热点的 key 从本线程对应的副本读取，不再挤同一个分片锁
+            bool getShared(const Key& key, std::shared_ptr<const Value>& value)
             {
-                size_t sliceIndex = Hash(key) % sliceNum_;
-                lfuSliceCaches_[sliceIndex]->put(key, value);
+                if (router_)
+                {
+                    bool found = false;
+                    size_t index = current_->sliceIndex(key);
+                    Slice& slice = *current_->slices[index];
+                    withSlice(index, [&]() {
+                        Value loaded;
+                        if (slice.getUnlocked(key, loaded))
+                        {
+                            value = std::make_shared<const Value>(std::move(loaded));
+                            found = true;
+                        }
+                    });
+                    return found;
+                }
+                if (l1_.get(key, value))
+                    return true;
+
+                // 纪元要在查分片之前读取，见 threadCache.h
+                uint64_t epoch = l1_.epochOf(key);
+                size_t hash = std::hash<Key>()(key);
+                if (hot_.enabled())
+                {
+                    size_t slices = sliceCountHint_.load(std::memory_order_relaxed);
+                    hot_.sample(key, hash, hash % slices, slices);
+                    if (hot_.find(key, hash, epoch, value))
+                    {
+                        l1_.fill(key, epoch, value);
+                        return true;
+                    }
+                }
+
+                Value loaded;
+                if (!load(key, loaded))
+                    return false;
+                value = std::make_shared<const Value>(std::move(loaded));
+                l1_.fill(key, epoch, value);
+                if (hot_.enabled())
+                    hot_.offer(key, hash, epoch, value);
+                return true;
             }
 
-            bool get(Key key, Value& value)
+            // 每线程 L1 的条目数，0（默认）为关闭
+            void enableThreadCache(size_t entries)
+            {
+                l1_.setEntries(entries);
+            }
+
+            typename ThreadCache<Key, Value>::Stats threadCacheStats() const
+            {
+                return l1_.stats();
+            }
+
+            // 热点 key 的副本数，0（默认）为关闭；须在开始使用前调用
+            void enableHotKeys(size_t replicas)
+            {
+                hot_.enable(replicas);
+            }
+
+            typename HotKeys<Key, Value>::Stats hotKeyStats() const
+            {
+                return hot_.stats(sliceCountHint_.load(std::memory_order_relaxed));
+            }
+
+            // thread-per-core 模式（见 coreRouter.h）：分片 i 归第 i % 核数 个核心所有，
+            // 对分片的一切访问都在属主核心的互斥下进行：绑在属主核心上的线程直接执行，
+            // 其他核心的线程经 SPSC 队列交给属主线程，未绑核的线程（管理接口、后台刷新）
+            // 投递到属主的收件箱。核心互斥已保证独占，读写走不加分片锁的版本；路由后分片表
+            // 固定，不再支持 reshard，也就不必加表锁。读写不经过 L1 和热点副本。须在开始使用前调用
+            void routeToCores(CoreRouter* router)
             {
-                size_t sliceIndex = Hash(key) % sliceNum_;
-                return lfuSliceCaches_[sliceIndex]->get(key, value);
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                if (!previous_)
+                    router_ = router;
             }
 
             Value get(Key key)
@@ -318,22 +620,221 @@ namespace CacheImpl
 
             void purge()
             {
-                for (auto& cache : lfuSliceCaches_)
+                // 与 migrateStep 相同的加锁顺序；迁移游标须随旧表一起复位，否则下次迁移会跳过分片
+                std::lock_guard<std::mutex> migrateLock(migrateMutex_);
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                for (size_t i = 0; i < current_->slices.size(); ++i)
                 {
-                    cache->purge();
+                    Slice& slice = *current_->slices[i];
+                    withSlice(i, [&]() { slice.purge(); });
                 }
+                previous_.reset();
+                nextSource_ = 0;
+                migrating_ = false;
+                l1_.invalidateAll();
             }
-        
+
+            size_t size()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                size_t total = 0;
+                for (size_t i = 0; i < current_->slices.size(); ++i)
+                {
+                    Slice& slice = *current_->slices[i];
+                    withSlice(i, [&]() { total += slice.size(); });
+                }
+                if (previous_)
+                {
+                    for (auto& cache : previous_->slices)
+                        total += cache->size();
+                }
+                return total;
+            }
+
+            // 运行时调整总容量，按分片均分；缩容由各分片分批淘汰。
+            // 写 capacity_ 须持独占锁，reshard() 与 capacity() 会读取它
+            void resize(size_t capacity)
+            {
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                capacity_ = capacity;
+                size_t sliceSize = sliceCapacity(capacity, current_->slices.size());
+                for (size_t i = 0; i < current_->slices.size(); ++i)
+                {
+                    Slice& slice = *current_->slices[i];
+                    withSlice(i, [&]() { slice.resize(static_cast<int>(sliceSize)); });
+                }
+            }
+
+            // 在线调整分片数：新建分片表后立即切换，旧表中的条目（连同频次）由之后的
+            // 每次操作顺带迁移几个，访问到的条目直接迁入新表。上一次迁移未完成时返回 false
+            bool reshard(int sliceNum)
+            {
+                if (sliceNum <= 0)
+                    return false;
+
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                if (previous_ || router_)
+                    return false;
+                previous_ = std::move(current_);
+                current_ = makeTable(capacity_, sliceNum, maxAverageNum_, pooled_);
+                sliceCountHint_.store(current_->slices.size(), std::memory_order_relaxed);
+                migrating_ = true;
+                return true;
+            }
+
+            size_t capacity()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                return capacity_;
+            }
+
+            int sliceCount()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                return static_cast<int>(current_->slices.size());
+            }
+
+            bool migrating() const
+            {
+                return migrating_.load(std::memory_order_relaxed);
+            }
+
+            // 各分片内存池的合计（迁移期间含旧表）；未开启 pooled 时全为 0
+            SlicePool::Stats memoryStats()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                SlicePool::Stats total{0, 0, 0};
+                for (auto& pool : current_->pools)
+                    total += pool->stats();
+                if (previous_)
+                {
+                    for (auto& pool : previous_->pools)
+                        total += pool->stats();
+                }
+                return total;
+            }
+
+            // 迁移最多 batch 个条目；迁移完成（或未在迁移）时返回 false
+            bool migrateStep(size_t batch = kMigrateBatch)
+            {
+                std::unique_lock<std::mutex> migrateLock(migrateMutex_, std::try_to_lock);
+                if (!migrateLock.owns_lock())
+                    return migrating();
+
+                bool drained = false;
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    if (!previous_)
+                        return false;
+
+                    size_t moved = 0;
+                    while (moved < batch && nextSource_ < previous_->slices.size())
+                    {
+                        Key key;
+                        Value value;
+                        int freq;
+                        if (!previous_->slices[nextSource_]->extractAny(key, value, freq))
+                        {
+                            ++nextSource_;
+                            continue;
+                        }
+                        current_->sliceFor(key).insertWithFreq(key, value, freq);
+                        ++moved;
+                    }
+                    drained = nextSource_ >= previous_->slices.size();
+                }
+
+                if (drained)
+                {
+                    std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                    previous_.reset();
+                    nextSource_ = 0;
+                    migrating_ = false;
+                }
+                return !drained;
+            }
+
         private:
-            size_t Hash(Key key)
+            static constexpr size_t kMigrateBatch = 8;
+
+            static size_t sliceCapacity(size_t capacity, size_t sliceNum)
             {
-                std::hash<Key> hashFunc;
-                return hashFunc(key);
+                return std::ceil(capacity / static_cast<double>(sliceNum));
             }
-        
+
+            static std::unique_ptr<Table> makeTable(size_t capacity, int sliceNum, int maxAverageNum, bool pooled)
+            {
+                auto table = std::make_unique<Table>();
+                size_t sliceSize = sliceCapacity(capacity, sliceNum);
+                for (int i = 0; i < sliceNum; ++i)
+                {
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+                    if (pooled)
+                    {
+                        table->pools.emplace_back(new SlicePool());
+                        resource = table->pools.back()->resource();
+                    }
+                    table->slices.emplace_back(new Slice(static_cast<int>(sliceSize), maxAverageNum, resource));
+                }
+                return table;
+            }
+
+            bool load(const Key& key, Value& value)
+            {
+                bool found;
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    found = current_->sliceFor(key).get(key, value) || adoptLocked(key, &value);
+                }
+                migrateIfNeeded();
+                return found;
+            }
+
+            // 迁移期间把旧表中的 key 连同频次移入新表（计一次访问）；需持有 tableMutex_ 共享锁
+            bool adoptLocked(const Key& key, Value* out)
+            {
+                if (!previous_)
+                    return false;
+
+                Value value;
+                int freq;
+                if (!previous_->sliceFor(key).extract(key, value, freq))
+                    return false;
+                if (out)
+                    *out = value;
+                current_->sliceFor(key).insertWithFreq(key, value, freq + 1);
+                return true;
+            }
+
+            void migrateIfNeeded()
+            {
+                if (migrating_.load(std::memory_order_relaxed))
+                    migrateStep();
+            }
+
+            // 路由模式下在分片 index 的属主核心的互斥下执行 fn，否则直接执行
+            template <typename F>
+            void withSlice(size_t index, F&& fn)
+            {
+                if (router_)
+                    router_->run(index % router_->cores(), fn);
+                else
+                    fn();
+            }
+
         private:
             size_t capacity_;
-            int sliceNum_;
-            std::vector<std::unique_ptr<LfuCache<Key, Value>>> lfuSliceCaches_;
+            int maxAverageNum_;
+            bool pooled_;
+            std::shared_mutex tableMutex_;      // 读写操作持共享锁，只有切换分片表时持独占锁
+            std::mutex migrateMutex_;
+            std::unique_ptr<Table> current_;
+            std::unique_ptr<Table> previous_;   // 迁移中的旧分片表
+            size_t nextSource_ = 0;             // 正在迁移的旧分片，受 migrateMutex_ 保护
+            std::atomic<bool> migrating_;
+            std::atomic<size_t> sliceCountHint_;    // 热点抽样按分片归类用，不加锁读取
+            ThreadCache<Key, Value> l1_;        // 可选的每线程热点缓存；其纪元也用于热点副本
+            HotKeys<Key, Value> hot_;
+            CoreRouter* router_ = nullptr;      // thread-per-core 模式下分片的属主核心
     };
-}
\ No newline at end of file
+}
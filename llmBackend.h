@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "deepseek.h"
+
+// What http_server's /api/message handler talks to: the DeepSeek API or, for
+// offline benchmarking, a MockBackend (mockBackend.h).
+class LlmBackend {
+public:
+    struct Reply {
+        std::string role;
+        std::string content;
+        int promptTokens = 0;
+        int completionTokens = 0;
+        int cacheHitTokens = 0;     // prompt tokens the provider served from its context cache
+    };
+
+    // Earlier turns of the conversation, oldest first ("user" / "assistant")
+    using History = std::vector<DeepSeekChat::Message>;
+
+    // Receives the reply piece by piece when streaming; return false to stop
+    using PieceSink = std::function<bool(std::string_view piece)>;
+
+    // When the caller stops waiting; max() for no deadline
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    virtual ~LlmBackend() = default;
+
+    // Throws BackendError (or std::runtime_error) on failure; BackendError(504)
+    // once the deadline has passed
+    virtual Reply complete(const History& history, const std::string& message, Deadline deadline) = 0;
+
+    // Default: one piece carrying the whole reply
+    virtual Reply stream(const History& history, const std::string& message, Deadline deadline, const PieceSink& sink) {
+        Reply reply = complete(history, message, deadline);
+        sink(reply.content);
+        return reply;
+    }
+
+    virtual const char* name() const = 0;
+
+    // Backend-specific counters for /api/metrics/backend
+    virtual nlohmann::json stats() const { return nlohmann::json::object(); }
+};
+
+// A failure the handler should pass on with a specific HTTP status
+class BackendError : public std::runtime_error {
+public:
+    BackendError(int status, const std::string& what, std::chrono::seconds retryAfter = std::chrono::seconds(0))
+        : std::runtime_error(what), status_(status), retryAfter_(retryAfter) {}
+    int status() const { return status_; }
+    std::chrono::seconds retryAfter() const { return retryAfter_; }      // 0: no Retry-After header
+
+private:
+    int status_;
+    std::chrono::seconds retryAfter_;
+};
+
+// The DeepSeek chat API; concurrent calls share DeepSeekChat's multiplexed connection
+class DeepSeekBackend : public LlmBackend {
+public:
+    DeepSeekBackend(const std::string& apiKey, const DeepSeekRetryOptions& options, const DeepSeekPromptOptions& prompt)
+        : chat_(apiKey, options, prompt) {}
+
+    Reply complete(const History& history, const std::string& message, Deadline deadline) override {
+        DeepSeekChat::Completion completion;
+        try {
+            completion = chat_.sendMessageAsync(history, message, deadline).get();
+        } catch (const CircuitOpenError& e) {
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(e.retryAfter()) + std::chrono::seconds(1);
+            throw BackendError(503, e.what(), seconds);
+        } catch (const std::exception& e) {
+            if (deadline != Deadline::max() && std::chrono::steady_clock::now() >= deadline) {
+                throw BackendError(504, std::string("Deadline exceeded: ") + e.what());
+            }
+            throw;
+        }
+        return {
+            completion.message.role,
+            std::move(completion.message.content),
+            completion.usage.prompt_tokens,
+            completion.usage.completion_tokens,
+            completion.usage.prompt_cache_hit_tokens
+        };
+    }
+
+    const char* name() const override { return "deepseek"; }
+
+    nlohmann::json stats() const override {
+        auto retry = chat_.retryStats();
+        auto usage = chat_.usageTotals();
+        auto breaker = chat_.breakerStats();
+        return {
+            {"calls", retry.calls},
+            {"attempts", retry.attempts},
+            {"retries", retry.retries},
+            {"hedges", retry.hedges},
+            {"hedgesWon", retry.hedgesWon},
+            {"budgetExhausted", retry.budgetExhausted},
+            {"failures", retry.failures},
+            {"hedgeDelayMs", retry.hedgeDelayMs},
+            {"promptTokens", usage.promptTokens},
+            {"completionTokens", usage.completionTokens},
+            {"promptCacheHitTokens", usage.cacheHitTokens},
+            {"promptCacheMissTokens", usage.cacheMissTokens},
+            {"trimmedMessages", usage.trimmedMessages},
+            {"breaker", {
+                {"state", CircuitBreaker::stateName(breaker.state)},
+                {"windowCalls", breaker.calls},
+                {"windowFailures", breaker.failures},
+                {"windowSlow", breaker.slow},
+                {"opened", breaker.opened},
+                {"rejected", breaker.rejected}
+            }}
+        };
+    }
+
+private:
+    DeepSeekChat chat_;
+};
@@ -1,14 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <thread>
 #include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <vector>
 
 #include "cachePolicy.h"
+#include "cacheMemory.h"
 
 namespace CacheImpl
 {
@@ -25,19 +34,22 @@ namespace CacheImpl
             Key key_;
             Value value_;
             size_t accessCount_;
+            uint64_t stamp_;        // 最近一次访问的时间戳，链表内单调递增
             std::weak_ptr<LruNode<Key, Value>> prev_;
 
         public:
-        LruNode(Key key, Value value)
-            : key_(key)
-            , value_(value)
+        LruNode(Key key, Value value, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : key_(makeWithResource<Key>(resource, std::move(key)))
+            , value_(makeWithResource<Value>(resource, std::move(value)))
             , accessCount_(1)
+            , stamp_(0)
         {}
 
         Key getKey() const { return key_; }
         Value getValue() const { return value_; }
         void setValue(const Value& value) { value_ = value; }
         size_t getAccessCount() const { return accessCount_; }
+        uint64_t getStamp() const { return stamp_; }
         void incrementAccessCount() { ++accessCount_; }
 
         friend class LruCache<Key, Value>;
@@ -50,13 +62,18 @@ namespace CacheImpl
         public:
             using LruNodeType = LruNode<Key, Value>;
             using NodePtr = std::shared_ptr<LruNodeType>;
-            using NodeMap = std::unordered_map<Key, NodePtr>;
+            using NodeMap = std::pmr::unordered_map<Key, NodePtr>;
+            // 时间戳 -> 链表中的节点；不共用时钟时迁移来的条目可能与本分片的时间戳相同，故用 multimap
+            using StampIndex = std::pmr::multimap<uint64_t, LruNodeType*>;
 
             // 声明 TraversableLruCache 为友元类
             friend class TraversableLruCache<Key, Value>;
 
-            LruCache(int capacity)
+            // 节点与哈希表从 resource 分配（见 cacheMemory.h），须比缓存活得久
+            LruCache(int capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
                 : capacity_(capacity)
+                , resource_(resource)
+                , nodeMap_(resource)
             {
                 initializedList();
             }
@@ -65,10 +82,11 @@ namespace CacheImpl
 
             void put(Key key, Value value) override
             {
+                // capacity_ 可被 resize() 并发修改，须在锁内读取
+                std::lock_guard<std::mutex> lock(mutex_);
                 if (capacity_ <= 0)
                     return ;
-                
-                std::lock_guard<std::mutex> lock(mutex_);
+
                 auto it = nodeMap_.find(key);
                 if (it != nodeMap_.end())
                 {
@@ -99,6 +117,41 @@ namespace CacheImpl
                 return value;
             }
 
+            // 在锁内原地修改 value（不存在时先插入默认值），避免取出-修改-写回的整体拷贝
+            template <typename Func>
+            void update(Key key, Func&& func)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (capacity_ <= 0)
+                    return ;
+
+                auto it = nodeMap_.find(key);
+                if (it == nodeMap_.end())
+                {
+                    addNode(key, Value());
+                    it = nodeMap_.find(key);
+                }
+                else
+                {
+                    moveToFront(it->second);
+                }
+                func(it->second->value_);
+            }
+
+            // 在锁内以只读方式访问 value
+            template <typename Func>
+            bool visit(Key key, Func&& func)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = nodeMap_.find(key);
+                if (it == nodeMap_.end())
+                    return false;
+
+                moveToFront(it->second);
+                func(static_cast<const Value&>(it->second->value_));
+                return true;
+            }
+
             void remove(Key key)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
@@ -114,14 +167,110 @@ namespace CacheImpl
             {
                 std::lock_guard<std::mutex> lock(mutex_);
                 nodeMap_.clear();
+                if (stampIndex_)
+                    stampIndex_->clear();
                 initializedList();
             }
 
+            // 运行时调整容量。缩容时本次最多淘汰 kEvictBatch 个，剩余超额由之后的 put 分摊，
+            // 避免一次加锁里淘汰大量条目。返回仍超出容量的条目数
+            size_t resize(int capacity)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                capacity_ = capacity;
+                return evictOverflow(kEvictBatch);
+            }
+
+            int capacity()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return capacity_;
+            }
+
+            // 以下供分片迁移（online rehash）使用
+
+            // 取出 key 对应的条目并从本缓存删除
+            bool extract(Key key, Value& value)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = nodeMap_.find(key);
+                if (it == nodeMap_.end())
+                    return false;
+
+                value = it->second->value_;
+                removeNode(it->second);
+                nodeMap_.erase(it);
+                return true;
+            }
+
+            // 最近访问条目的时间戳，为空时返回 0
+            uint64_t newestStamp()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto newest = dummyTail_->prev_.lock();
+                return newest && newest != dummyHead_ ? newest->stamp_ : 0;
+            }
+
+            // 取出最近访问的条目
+            bool extractNewest(Key& key, Value& value, uint64_t& stamp)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto newest = dummyTail_->prev_.lock();
+                if (!newest || newest == dummyHead_)
+                    return false;
+
+                key = newest->key_;
+                value = newest->value_;
+                stamp = newest->stamp_;
+                removeNode(newest);
+                nodeMap_.erase(key);
+                return true;
+            }
+
+            // 保留原时间戳插入到最久未访问的一端；已满或已存在时丢弃。
+            // 调用方保证 stamp 早于本缓存中的所有条目，链表仍按时间戳有序
+            void insertOldest(const Key& key, const Value& value, uint64_t stamp)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (nodeMap_.size() >= static_cast<size_t>(capacity_) || nodeMap_.count(key))
+                    return;
+
+                // 与并发访问交错时可能拿到稍新的条目，压到当前最旧条目之前以保持有序；
+                // 压低后的时间戳落在 nextStamp 留出的空位里
+                NodePtr oldest = dummyHead_->next_;
+                if (oldest != dummyTail_ && stamp >= oldest->stamp_)
+                    stamp = oldest->stamp_ - 1;
+
+                NodePtr node = allocateShared<LruNodeType>(resource_, key, value, resource_);
+                node->stamp_ = stamp;
+                if (stampIndex_)
+                    stampIndex_->emplace(stamp, node.get());
+                node->prev_ = dummyHead_;
+                node->next_ = dummyHead_->next_;
+                dummyHead_->next_->prev_ = node;
+                dummyHead_->next_ = node;
+                nodeMap_[key] = node;
+            }
+
         protected:
+            static constexpr size_t kEvictBatch = 16;
+
+            size_t evictOverflow(size_t maxEvict)
+            {
+                size_t evicted = 0;
+                while (nodeMap_.size() > static_cast<size_t>(std::max(capacity_, 0)) && evicted < maxEvict)
+                {
+                    removeLeastUsed();
+                    ++evicted;
+                }
+                size_t limit = static_cast<size_t>(std::max(capacity_, 0));
+                return nodeMap_.size() > limit ? nodeMap_.size() - limit : 0;
+            }
+
             void initializedList()
             {
-                dummyHead_ = std::make_shared<LruNodeType>(Key(), Value());
-                dummyTail_ = std::make_shared<LruNodeType>(Key(), Value());
+                dummyHead_ = allocateShared<LruNodeType>(resource_, Key(), Value(), resource_);
+                dummyTail_ = allocateShared<LruNodeType>(resource_, Key(), Value(), resource_);
                 dummyHead_->next_ = dummyTail_;
                 dummyTail_->prev_ = dummyHead_;
             }
@@ -137,9 +286,11 @@ namespace CacheImpl
                 if (nodeMap_.size() >= static_cast<size_t>(capacity_))
                 {
                     removeLeastUsed();
+                    // 缩容后剩余的超额在这里分批淘汰
+                    evictOverflow(kEvictBatch);
                 }
 
-                NodePtr newNode = std::make_shared<LruNodeType>(key, value);
+                NodePtr newNode = allocateShared<LruNodeType>(resource_, key, value, resource_);
                 insertNode(newNode);
                 nodeMap_[key] = newNode;
             }
@@ -157,6 +308,8 @@ namespace CacheImpl
                     auto prev = node->prev_.lock();
                     if (prev)
                     {
+                        if (stampIndex_)
+                            unindex(node.get());
                         prev->next_ = node->next_;
                         node->next_->prev_ = prev;
                         node->next_ = nullptr;
@@ -165,8 +318,30 @@ namespace CacheImpl
                 }
             }
 
+            // 单调时钟纳秒数作为时间戳，各分片之间可直接比较。分片共用 clock_（见 HashLruCache）时
+            // 时间戳全局唯一，可单独作为分页游标；取 kStampStride 的整数倍，下方留出的空位给
+            // insertOldest 压低时间戳用，不会与其他条目重复
+            uint64_t nextStamp()
+            {
+                uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count() & ~(kStampStride - 1);
+                if (!clock_)
+                {
+                    lastStamp_ = now > lastStamp_ ? now : lastStamp_ + kStampStride;
+                    return lastStamp_;
+                }
+                uint64_t last = clock_->load(std::memory_order_relaxed);
+                uint64_t next;
+                do
+                {
+                    next = now > last ? now : last + kStampStride;
+                } while (!clock_->compare_exchange_weak(last, next, std::memory_order_relaxed));
+                return next;
+            }
+
             void insertNode(NodePtr node)
             {
+                node->stamp_ = nextStamp();
                 if (!dummyTail_->prev_.expired())
                 {
                     auto prev = dummyTail_->prev_.lock();
@@ -176,6 +351,21 @@ namespace CacheImpl
                         node->prev_ = prev;
                         prev->next_ = node;
                         dummyTail_->prev_ = node;
+                        if (stampIndex_)
+                            stampIndex_->emplace(node->stamp_, node.get());
+                    }
+                }
+            }
+
+            void unindex(LruNodeType* node)
+            {
+                auto range = stampIndex_->equal_range(node->stamp_);
+                for (auto it = range.first; it != range.second; ++it)
+                {
+                    if (it->second == node)
+                    {
+                        stampIndex_->erase(it);
+                        return;
                     }
                 }
             }
@@ -191,10 +381,57 @@ namespace CacheImpl
             }
 
             int capacity_;
+            std::pmr::memory_resource* resource_;
             NodeMap nodeMap_;
             std::mutex mutex_;
             NodePtr dummyHead_;
             NodePtr dummyTail_;
+            static constexpr uint64_t kStampStride = 64;
+
+            uint64_t lastStamp_ = 0;
+            std::atomic<uint64_t>* clock_ = nullptr;    // 各分片共用的时间戳时钟，为空时用 lastStamp_
+            std::unique_ptr<StampIndex> stampIndex_;    // 仅 TraversableLruCache 建立，用于按游标定位
+    };
+
+    // 可按访问顺序遍历的 LRU：从最近访问开始，以时间戳作为游标分页。
+    // 每页只在收集本页时持有锁；翻页期间被再次访问的条目时间戳会超过游标，
+    // 因此不会重复出现，未被访问的条目按原有顺序恰好出现一次。
+    // 额外维护时间戳有序索引，按游标定位为 O(log n)，每页代价与偏移无关。
+    template <typename Key, typename Value>
+    class TraversableLruCache : public LruCache<Key, Value>
+    {
+        public:
+            // clock 非空时与共用它的其他缓存一起分配时间戳，彼此的时间戳不会重复
+            TraversableLruCache(int capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                                std::atomic<uint64_t>* clock = nullptr)
+                : LruCache<Key, Value>(capacity, resource)
+            {
+                this->stampIndex_ = std::make_unique<typename LruCache<Key, Value>::StampIndex>(resource);
+                this->clock_ = clock;
+            }
+
+            // 对时间戳小于 before 的条目，按从新到旧依次调用 func(key, value, stamp)，最多 limit 个
+            template <typename Func>
+            size_t forEachBefore(uint64_t before, size_t limit, Func&& func)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex_);
+                size_t visited = 0;
+                auto it = this->stampIndex_->lower_bound(before);
+                while (it != this->stampIndex_->begin() && visited < limit)
+                {
+                    --it;
+                    auto* node = it->second;
+                    func(static_cast<const Key&>(node->key_), static_cast<const Value&>(node->value_), node->stamp_);
+                    ++visited;
+                }
+                return visited;
+            }
+
+            size_t size()
+            {
+                std::lock_guard<std::mutex> lock(this->mutex_);
+                return this->nodeMap_.size();
+            }
     };
 
     template <typename Key, typename Value>
@@ -274,28 +511,51 @@ namespace CacheImpl
     template <typename Key, typename Value>
     class HashLruCache
     {
-        public:
-            HashLruCache(size_t capacity, int sliceNum)
-                : capacity_(capacity)
-                , sliceNum_(sliceNum > 0 ? sliceNum : std::thread::hardware_concurrency())
+        private:
+            using Slice = TraversableLruCache<Key, Value>;
+
+            struct Table
             {
-                size_t sliceSize = std::ceil(capacity_ / static_cast<double>(sliceNum_));
-                for (int i = 0; i < sliceNum_; ++i)
+                std::vector<std::unique_ptr<SlicePool>> pools;      // 每个分片一个，须在 slices 之后销毁
+                std::vector<std::unique_ptr<Slice>> slices;
+
+                Slice& sliceFor(const Key& key) const
                 {
-                    lruSliceCaches_.emplace_back(new LruCache<Key, Value>(sliceSize));
+                    return *slices[std::hash<Key>()(key) % slices.size()];
                 }
-            }
+            };
+
+        public:
+            // pooled 为 true 时每个分片从自己的 SlicePool 分配节点（见 cacheMemory.h），否则用全局分配器
+            HashLruCache(size_t capacity, int sliceNum, bool pooled = true)
+                : capacity_(capacity)
+                , pooled_(pooled)
+                , clock_(0)
+                , current_(makeTable(capacity, sliceNum > 0 ? sliceNum : std::thread::hardware_concurrency(), pooled, &clock_))
+                , migrating_(false)
+            {}
 
             void put(Key key, Value value)
             {
-                size_t sliceIndex = Hash(key) % sliceNum_;
-                lruSliceCaches_[sliceIndex]->put(key, value);
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    current_->sliceFor(key).put(key, value);
+                    // 旧表中的旧值不能在迁移时覆盖新值
+                    if (previous_)
+                        previous_->sliceFor(key).remove(key);
+                }
+                migrateIfNeeded();
             }
 
             bool get(Key key, Value& value)
             {
-                size_t sliceIndex = Hash(key) % sliceNum_;
-                return lruSliceCaches_[sliceIndex]->get(key, value);
+                bool found;
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    found = current_->sliceFor(key).get(key, value) || adoptLocked(key, &value);
+                }
+                migrateIfNeeded();
+                return found;
             }
 
             Value get(Key key)
@@ -305,31 +565,287 @@ namespace CacheImpl
                 return value;
             }
 
+            template <typename Func>
+            void update(Key key, Func&& func)
+            {
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    adoptLocked(key, nullptr);
+                    current_->sliceFor(key).update(key, std::forward<Func>(func));
+                }
+                migrateIfNeeded();
+            }
+
+            template <typename Func>
+            bool visit(Key key, Func&& func)
+            {
+                bool found;
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    adoptLocked(key, nullptr);
+                    found = current_->sliceFor(key).visit(key, std::forward<Func>(func));
+                }
+                migrateIfNeeded();
+                return found;
+            }
+
             void remove(Key key)
             {
-                size_t sliceIndex = Hash(key) % sliceNum_;
-                lruSliceCaches_[sliceIndex]->remove(key);
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                current_->sliceFor(key).remove(key);
+                if (previous_)
+                    previous_->sliceFor(key).remove(key);
             }
 
             void purge()
             {
-                for (auto& cache : lruSliceCaches_)
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                for (auto& cache : current_->slices)
                 {
                     cache->purge();
                 }
+                previous_.reset();
+                migrating_ = false;
             }
-        
+
+            size_t size()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                size_t total = 0;
+                forEachSliceLocked([&total](Slice& slice) { total += slice.size(); });
+                return total;
+            }
+
+            // 运行时调整总容量，按分片均分；缩容由各分片分批淘汰。
+            // 写 capacity_ 须持独占锁，reshard() 与 capacity() 会读取它
+            void resize(size_t capacity)
+            {
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                capacity_ = capacity;
+                size_t sliceSize = sliceCapacity(capacity, current_->slices.size());
+                for (auto& cache : current_->slices)
+                {
+                    cache->resize(static_cast<int>(sliceSize));
+                }
+            }
+
+            // 在线调整分片数：新建分片表后立即切换，旧表中的条目由之后的每次操作顺带迁移几个
+            // （按时间戳从新到旧，保持 LRU 顺序），访问到的条目则直接迁入新表。
+            // 上一次迁移尚未完成时返回 false
+            bool reshard(int sliceNum)
+            {
+                if (sliceNum <= 0)
+                    return false;
+
+                std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                if (previous_)
+                    return false;
+                previous_ = std::move(current_);
+                current_ = makeTable(capacity_, sliceNum, pooled_, &clock_);
+                migrating_ = true;
+                return true;
+            }
+
+            size_t capacity()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                return capacity_;
+            }
+
+            int sliceCount()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                return static_cast<int>(current_->slices.size());
+            }
+
+            bool migrating() const
+            {
+                return migrating_.load(std::memory_order_relaxed);
+            }
+
+            // 各分片内存池的合计（迁移期间含旧表）；未开启 pooled 时全为 0
+            SlicePool::Stats memoryStats()
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                SlicePool::Stats total{0, 0, 0};
+                for (auto& pool : current_->pools)
+                    total += pool->stats();
+                if (previous_)
+                {
+                    for (auto& pool : previous_->pools)
+                        total += pool->stats();
+                }
+                return total;
+            }
+
+            // 迁移最多 batch 个条目；迁移完成（或未在迁移）时返回 false
+            bool migrateStep(size_t batch = kMigrateBatch)
+            {
+                std::unique_lock<std::mutex> migrateLock(migrateMutex_, std::try_to_lock);
+                if (!migrateLock.owns_lock())
+                    return migrating();
+
+                bool drained = false;
+                {
+                    std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                    if (!previous_)
+                        return false;
+
+                    for (size_t i = 0; i < batch; ++i)
+                    {
+                        // 各旧分片中取时间戳最新的条目，保证迁入的条目整体按时间戳递减
+                        Slice* source = nullptr;
+                        uint64_t newest = 0;
+                        for (auto& cache : previous_->slices)
+                        {
+                            uint64_t stamp = cache->newestStamp();
+                            if (stamp > newest)
+                            {
+                                newest = stamp;
+                                source = cache.get();
+                            }
+                        }
+
+                        Key key;
+                        Value value;
+                        uint64_t stamp;
+                        if (!source || !source->extractNewest(key, value, stamp))
+                        {
+                            drained = true;
+                            break;
+                        }
+                        current_->sliceFor(key).insertOldest(key, value, stamp);
+                    }
+                }
+
+                if (drained)
+                {
+                    std::unique_lock<std::shared_mutex> lock(tableMutex_);
+                    previous_.reset();
+                    migrating_ = false;
+                }
+                return !drained;
+            }
+
+            template <typename Item>
+            struct PageEntry
+            {
+                Key key;
+                uint64_t stamp;
+                Item item;
+            };
+
+            // 按最近访问顺序分页：before 为上一页返回的游标（首页传 UINT64_MAX），
+            // project(key, value) 在分片锁内把条目投影成 Item，避免拷贝整个 value。
+            // 各分片各取 limit 条后按时间戳多路归并；nextCursor 为 0 表示没有更多。
+            // 所有分片共用 clock_，时间戳不会重复，游标只需记时间戳，不会跳过同一时间戳的其他条目。
+            // 迁移期间新旧两张表的分片一起参与归并。
+            template <typename Item, typename Project>
+            std::vector<PageEntry<Item>> page(uint64_t before, size_t limit, Project&& project, uint64_t& nextCursor)
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex_);
+                std::vector<std::vector<PageEntry<Item>>> slices;
+                forEachSliceLocked([&](Slice& slice) {
+                    slices.emplace_back();
+                    auto& entries = slices.back();
+                    entries.reserve(limit);
+                    slice.forEachBefore(before, limit,
+                        [&](const Key& key, const Value& value, uint64_t stamp) {
+                            entries.push_back(PageEntry<Item>{key, stamp, project(key, value)});
+                        });
+                });
+
+                // 每个分片内部已按时间戳降序，用大顶堆取各分片当前最新的条目做多路归并
+                using Head = std::pair<uint64_t, size_t>;   // (stamp, slice)
+                std::priority_queue<Head> heads;
+                std::vector<size_t> positions(slices.size(), 0);
+                for (size_t i = 0; i < slices.size(); ++i)
+                {
+                    if (!slices[i].empty())
+                        heads.emplace(slices[i][0].stamp, i);
+                }
+
+                std::vector<PageEntry<Item>> result;
+                result.reserve(limit);
+                while (!heads.empty() && result.size() < limit)
+                {
+                    size_t slice = heads.top().second;
+                    heads.pop();
+                    result.push_back(std::move(slices[slice][positions[slice]++]));
+                    if (positions[slice] < slices[slice].size())
+                        heads.emplace(slices[slice][positions[slice]].stamp, slice);
+                }
+
+                nextCursor = (result.size() == limit && limit > 0) ? result.back().stamp : 0;
+                return result;
+            }
+
         private:
-            size_t Hash(Key key)
+            static constexpr size_t kMigrateBatch = 8;
+
+            static size_t sliceCapacity(size_t capacity, size_t sliceNum)
             {
-                std::hash<Key> hashFunc;
-                return hashFunc(key);
+                return std::ceil(capacity / static_cast<double>(sliceNum));
             }
-        
+
+            static std::unique_ptr<Table> makeTable(size_t capacity, int sliceNum, bool pooled, std::atomic<uint64_t>* clock)
+            {
+                auto table = std::make_unique<Table>();
+                size_t sliceSize = sliceCapacity(capacity, sliceNum);
+                for (int i = 0; i < sliceNum; ++i)
+                {
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+                    if (pooled)
+                    {
+                        table->pools.emplace_back(new SlicePool());
+                        resource = table->pools.back()->resource();
+                    }
+                    table->slices.emplace_back(new Slice(static_cast<int>(sliceSize), resource, clock));
+                }
+                return table;
+            }
+
+            // 迁移期间把旧表中的 key 移入新表（视为一次访问）；需持有 tableMutex_ 共享锁
+            bool adoptLocked(const Key& key, Value* out)
+            {
+                if (!previous_)
+                    return false;
+
+                Value value;
+                if (!previous_->sliceFor(key).extract(key, value))
+                    return false;
+                if (out)
+                    *out = value;
+                current_->sliceFor(key).put(key, std::move(value));
+                return true;
+            }
+
+            template <typename Func>
+            void forEachSliceLocked(Func&& func)
+            {
+                for (auto& cache : current_->slices)
+                    func(*cache);
+                if (previous_)
+                {
+                    for (auto& cache : previous_->slices)
+                        func(*cache);
+                }
+            }
+
+            void migrateIfNeeded()
+            {
+                if (migrating_.load(std::memory_order_relaxed))
+                    migrateStep();
+            }
+
         private:
             size_t capacity_;
-            int sliceNum_;
-            std::vector<std::unique_ptr<LruCache<Key, Value>>> lruSliceCaches_;
+            bool pooled_;
+            std::shared_mutex tableMutex_;      // 读写操作持共享锁，只有切换分片表时持独占锁
+            std::mutex migrateMutex_;
+            std::atomic<uint64_t> clock_;       // 新旧分片表的所有分片共用，时间戳全局唯一；须在分片表之前构造
+            std::unique_ptr<Table> current_;
+            std::unique_ptr<Table> previous_;   // 迁移中的旧分片表
+            std::atomic<bool> migrating_;
     };
 }
-
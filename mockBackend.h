@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include "cacheKey.h"
+#include "llmBackend.h"
+#include "tokenizer.h"
+
+// A random quantity (milliseconds or tokens) drawn per request.
+//   fixed:200              always 200
+//   lognormal:300,0.5      median 300, sigma 0.5 of the underlying normal
+//   bimodal:80,2000,0.05   80 usually, 2000 with probability 0.05
+struct Distribution {
+    enum class Kind { Fixed, LogNormal, Bimodal };
+
+    Kind kind = Kind::Fixed;
+    double a = 0;       // fixed value, lognormal median, bimodal fast value
+    double b = 0;       // lognormal sigma, bimodal slow value
+    double p = 0;       // bimodal slow probability
+
+    double sample(std::mt19937_64& rng) const {
+        switch (kind) {
+        case Kind::LogNormal:
+            return std::lognormal_distribution<double>(std::log(std::max(a, 1e-9)), b)(rng);
+        case Kind::Bimodal:
+            return std::bernoulli_distribution(p)(rng) ? b : a;
+        default:
+            return a;
+        }
+    }
+
+    static bool parse(const std::string& spec, Distribution& out) {
+        size_t colon = spec.find(':');
+        std::string kind = spec.substr(0, colon);
+        double values[3] = {0, 0, 0};
+        int count = 0;
+        if (colon != std::string::npos) {
+            const char* p = spec.c_str() + colon + 1;
+            while (*p && count < 3) {
+                char* end;
+                values[count++] = std::strtod(p, &end);
+                if (end == p) {
+                    return false;
+                }
+                p = *end == ',' ? end + 1 : end;
+            }
+        }
+
+        Distribution d;
+        if (kind == "fixed" && count == 1) {
+            d.kind = Kind::Fixed;
+        } else if (kind == "lognormal" && count == 2 && values[1] >= 0) {
+            d.kind = Kind::LogNormal;
+        } else if (kind == "bimodal" && count == 3 && values[2] >= 0 && values[2] <= 1) {
+            d.kind = Kind::Bimodal;
+        } else {
+            return false;
+        }
+        if (values[0] < 0 || values[1] < 0) {
+            return false;
+        }
+        d.a = values[0];
+        d.b = values[1];
+        d.p = values[2];
+        out = d;
+        return true;
+    }
+};
+
+struct MockBackendOptions {
+    Distribution latencyMs{Distribution::Kind::LogNormal, 300, 0.5, 0};     // until the first token
+    Distribution replyTokens{Distribution::Kind::LogNormal, 150, 0.6, 0};
+    double errorRate = 0;           // 500s
+    double overloadRate = 0;        // 429s
+    double tokensPerSecond = 0;     // 0: the whole reply arrives after latencyMs
+    uint64_t seed = 1;
+};
+
+// Stand-in for the DeepSeek API with no network. The reply text depends only on
+// the message and the seed, so a cache in front sees stable content; latency,
+// reply length and injected errors are drawn from a generator seeded with the
+// seed and the request number, so a run with the same request order repeats.
+class MockBackend : public LlmBackend {
+public:
+    explicit MockBackend(const MockBackendOptions& options = MockBackendOptions())
+        : options_(options)
+        , requests_(0)
+    {}
+
+    // The history only counts towards promptTokens; the reply depends on the message alone
+    Reply complete(const History& history, const std::string& message, Deadline deadline) override {
+        return stream(history, message, deadline, nullptr);
+    }
+
+    // A draw that would finish after the deadline waits until it and fails with 504
+    Reply stream(const History& history, const std::string& message, Deadline deadline, const PieceSink& sink) override {
+        std::mt19937_64 rng(options_.seed * 0x9E3779B97F4A7C15ULL + requests_.fetch_add(1));
+        auto ttft = std::chrono::microseconds(static_cast<int64_t>(options_.latencyMs.sample(rng) * 1000));
+        size_t tokens = std::max<size_t>(1, static_cast<size_t>(options_.replyTokens.sample(rng)));
+        double roll = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+
+        if (std::chrono::steady_clock::now() + ttft > deadline) {
+            std::this_thread::sleep_until(deadline);
+            throw BackendError(504, "mock: deadline exceeded");
+        }
+        std::this_thread::sleep_for(ttft);
+        if (roll < options_.errorRate) {
+            throw BackendError(500, "mock: injected upstream error");
+        }
+        if (roll < options_.errorRate + options_.overloadRate) {
+            throw BackendError(429, "mock: injected rate limit");
+        }
+
+        // Words from a fixed list, picked by a generator seeded with the message
+        Hash128 digest = hash128(message, options_.seed);
+        std::mt19937_64 words(digest.lo ^ digest.hi);
+        Reply reply{"assistant", {}};
+        reply.content.reserve(tokens * 7);
+        reply.promptTokens = static_cast<int>(Tokenizer::estimate(message));
+        for (const auto& turn : history) {
+            reply.promptTokens += static_cast<int>(Tokenizer::estimate(turn.content));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < tokens; ++i) {
+            std::string piece = i == 0 ? "" : " ";
+            piece += kWords[words() % kWordCount];
+            reply.content += piece;
+
+            if (options_.tokensPerSecond > 0) {
+                auto due = start + std::chrono::microseconds(static_cast<int64_t>((i + 1) * 1e6 / options_.tokensPerSecond));
+                if (due > deadline) {
+                    std::this_thread::sleep_until(deadline);
+                    throw BackendError(504, "mock: deadline exceeded");
+                }
+                std::this_thread::sleep_until(due);
+            }
+            if (sink && !sink(piece)) {
+                break;
+            }
+        }
+        reply.completionTokens = static_cast<int>(tokens);
+        return reply;
+    }
+
+    const char* name() const override { return "mock"; }
+
+private:
+    static constexpr const char* kWords[] = {
+        "the", "cache", "proxy", "returns", "a", "response", "when", "upstream", "is", "slow",
+        "token", "model", "answer", "request", "latency", "and", "of", "to", "in", "server"
+    };
+    static constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+    MockBackendOptions options_;
+    std::atomic<uint64_t> requests_;
+};
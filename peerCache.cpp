@@ -0,0 +1,428 @@
+#include "peerCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const uint8_t kOpGet = 1;
+const uint32_t kMaxFieldLength = 16 * 1024 * 1024;
+
+void putU32(std::string& out, uint32_t value) {
+    char bytes[4] = {
+        static_cast<char>(value & 0xFF),
+        static_cast<char>((value >> 8) & 0xFF),
+        static_cast<char>((value >> 16) & 0xFF),
+        static_cast<char>((value >> 24) & 0xFF)
+    };
+    out.append(bytes, 4);
+}
+
+uint32_t getU32(const unsigned char* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* buffer, size_t length) {
+    char* data = static_cast<char*>(buffer);
+    while (length > 0) {
+        ssize_t n = ::recv(fd, data, length, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readU32(int fd, uint32_t& value) {
+    unsigned char bytes[4];
+    if (!readAll(fd, bytes, 4)) {
+        return false;
+    }
+    value = getU32(bytes);
+    return true;
+}
+
+bool readField(int fd, std::string& out) {
+    uint32_t length;
+    if (!readU32(fd, length) || length > kMaxFieldLength) {
+        return false;
+    }
+    out.resize(length);
+    return length == 0 || readAll(fd, &out[0], length);
+}
+
+void setTimeouts(int fd, int timeoutMs) {
+    timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+void setNoDelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+}
+
+bool PeerAddress::parse(const std::string& text, PeerAddress& address) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) {
+        return false;
+    }
+    int port = std::atoi(text.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    address.host = text.substr(0, colon);
+    address.port = port;
+    return true;
+}
+
+// HashRing
+
+uint64_t HashRing::hash(std::string_view data) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    // FNV alone clusters similar keys ("peer#1", "peer#2"); finish with a 64-bit mixer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void HashRing::add(const std::string& peer) {
+    size_t index = peers_.size();
+    peers_.push_back(peer);
+    for (int i = 0; i < virtualNodes_; ++i) {
+        ring_[hash(peer + "#" + std::to_string(i))] = index;
+    }
+}
+
+const std::string& HashRing::owner(std::string_view key) const {
+    static const std::string none;
+    if (ring_.empty()) {
+        return none;
+    }
+    auto it = ring_.lower_bound(hash(key));
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return peers_[it->second];
+}
+
+// PeerClient
+
+PeerClient::PeerClient(const PeerAddress& address, int timeoutMs, size_t maxIdle)
+    : address_(address)
+    , timeoutMs_(timeoutMs)
+    , maxIdle_(maxIdle)
+{}
+
+PeerClient::~PeerClient() {
+    for (int fd : idle_) {
+        ::close(fd);
+    }
+}
+
+int PeerClient::connectSocket() {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (::getaddrinfo(address_.host.c_str(), std::to_string(address_.port).c_str(), &hints, &result) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        setTimeouts(fd, timeoutMs_);
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(result);
+
+    if (fd >= 0) {
+        setNoDelay(fd);
+    }
+    return fd;
+}
+
+bool PeerClient::roundTrip(int fd, const std::string& request, PeerReply& reply) {
+    if (!writeAll(fd, request.data(), request.size())) {
+        return false;
+    }
+
+    unsigned char header[13];
+    if (!readAll(fd, header, sizeof(header)) || header[0] > static_cast<uint8_t>(PeerReply::Status::Unavailable)) {
+        return false;
+    }
+    reply.status = static_cast<PeerReply::Status>(header[0]);
+    reply.ageMs = getU32(header + 1);
+    reply.retryAfterMs = getU32(header + 5);
+
+    uint32_t contentLength = getU32(header + 9);
+    if (contentLength > kMaxFieldLength) {
+        return false;
+    }
+    reply.content.resize(contentLength);
+    if (contentLength > 0 && !readAll(fd, &reply.content[0], contentLength)) {
+        return false;
+    }
+    return readField(fd, reply.role);
+}
+
+bool PeerClient::get(const std::string& key, const std::string& message, PeerReply& reply) {
+    std::string request;
+    request.reserve(9 + key.size() + message.size());
+    request.push_back(static_cast<char>(kOpGet));
+    putU32(request, static_cast<uint32_t>(key.size()));
+    request.append(key);
+    putU32(request, static_cast<uint32_t>(message.size()));
+    request.append(message);
+
+    // A pooled connection may have been closed by the peer; retry once on a new one
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        int fd = -1;
+        bool reused = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                fd = idle_.back();
+                idle_.pop_back();
+                reused = true;
+            }
+        }
+        if (fd < 0) {
+            fd = connectSocket();
+            if (fd < 0) {
+                return false;
+            }
+        }
+
+        if (roundTrip(fd, request, reply)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_.size() < maxIdle_) {
+                idle_.push_back(fd);
+            } else {
+                ::close(fd);
+            }
+            return true;
+        }
+
+        ::close(fd);
+        if (!reused) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// PeerServer
+
+PeerServer::PeerServer(int port, Handler handler)
+    : port_(port)
+    , handler_(std::move(handler))
+    , listenFd_(-1)
+    , running_(false)
+{}
+
+PeerServer::~PeerServer() {
+    stop();
+}
+
+bool PeerServer::start() {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        return false;
+    }
+
+    int one = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port_));
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd_, 128) != 0) {
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    acceptThread_ = std::thread(&PeerServer::acceptLoop, this);
+    return true;
+}
+
+void PeerServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    ::shutdown(listenFd_, SHUT_RDWR);
+    ::close(listenFd_);
+    if (acceptThread_.joinable()) {
+        acceptThread_.join();
+    }
+
+    // Unblock connection threads stuck in recv, wait for them to leave the map,
+    // then join them so none still runs on this object once stop() returns
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (auto& entry : connections_) {
+            ::shutdown(entry.second.fd, SHUT_RDWR);
+        }
+        idleCond_.wait(lock, [this] { return connections_.empty(); });
+    }
+    joinFinished();
+}
+
+void PeerServer::joinFinished() {
+    std::vector<std::thread> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished.swap(finished_);
+    }
+    for (auto& thread : finished) {
+        thread.join();
+    }
+}
+
+void PeerServer::acceptLoop() {
+    while (running_.load()) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        setNoDelay(fd);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_.load()) {
+                ::close(fd);
+                break;
+            }
+            uint64_t id = nextConnection_++;
+            Connection& connection = connections_[id];
+            connection.fd = fd;
+            connection.thread = std::thread(&PeerServer::serve, this, id, fd);
+        }
+        joinFinished();
+    }
+}
+
+void PeerServer::serve(uint64_t id, int fd) {
+    std::string key;
+    std::string message;
+    std::string response;
+    PeerReply reply;
+    while (running_.load()) {
+        uint8_t op;
+        if (!readAll(fd, &op, 1) || op != kOpGet || !readField(fd, key) || !readField(fd, message)) {
+            break;
+        }
+
+        reply = PeerReply();
+        try {
+            handler_(key, message, reply);
+        } catch (...) {
+            reply = PeerReply();
+            reply.status = PeerReply::Status::Unavailable;
+        }
+
+        response.clear();
+        response.push_back(static_cast<char>(reply.status));
+        putU32(response, reply.ageMs);
+        putU32(response, reply.retryAfterMs);
+        putU32(response, static_cast<uint32_t>(reply.content.size()));
+        response.append(reply.content);
+        putU32(response, static_cast<uint32_t>(reply.role.size()));
+        response.append(reply.role);
+        if (!writeAll(fd, response.data(), response.size())) {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = connections_.find(id);
+        finished_.push_back(std::move(it->second.thread));
+        connections_.erase(it);
+        if (connections_.empty()) {
+            idleCond_.notify_all();
+        }
+    }
+    ::close(fd);
+}
+
+// PeerGroup
+
+PeerGroup::PeerGroup(const PeerAddress& self, const std::vector<PeerAddress>& peers, int virtualNodes, int timeoutMs)
+    : self_(self.str())
+    , ring_(virtualNodes)
+{
+    // Same insertion order on every process is not required: ring points depend only on names
+    ring_.add(self_);
+    for (const auto& peer : peers) {
+        std::string name = peer.str();
+        if (name == self_ || clients_.count(name)) {
+            continue;
+        }
+        ring_.add(name);
+        clients_.emplace(name, std::make_unique<PeerClient>(peer, timeoutMs));
+    }
+}
+
+bool PeerGroup::fetch(const std::string& key, const std::string& message, PeerReply& reply) {
+    auto it = clients_.find(ring_.owner(key));
+    return it != clients_.end() && it->second->get(key, message, reply);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// groupcache-style peer mode for the response cache.
+//
+// Every proxy in the group is started with the same static peer list. A key is
+// owned by one peer picked on a consistent-hash ring; non-owners ask the owner
+// over a small binary protocol and the owner answers from its cache or loads
+// from the upstream once (single-flight), so each prompt costs one upstream
+// call per group instead of one per replica.
+//
+// Wire format (little endian), one request/response per frame, connections are
+// reused:
+//   request:  u8 op | u32 keyLength | key | u32 messageLength | message
+//   response: u8 status | u32 ageMs | u32 retryAfterMs | u32 contentLength | content | u32 roleLength | role
+
+struct PeerAddress {
+    std::string host;
+    int port = 0;
+
+    std::string str() const { return host + ":" + std::to_string(port); }
+    bool operator==(const PeerAddress& other) const { return host == other.host && port == other.port; }
+
+    // "host:port"
+    static bool parse(const std::string& text, PeerAddress& address);
+};
+
+struct PeerReply {
+    enum class Status : uint8_t {
+        Ok = 0,
+        Unavailable = 1        // owner's upstream is failing or overloaded
+    };
+
+    Status status = Status::Ok;
+    uint32_t ageMs = 0;         // time since the owner stored the entry
+    uint32_t retryAfterMs = 0;
+    std::string content;
+    std::string role;
+};
+
+// Consistent-hash ring with virtual nodes. Uses its own hash (FNV-1a + mix) so
+// every process, whatever its standard library, agrees on the owner.
+class HashRing {
+public:
+    explicit HashRing(int virtualNodes = 64) : virtualNodes_(virtualNodes) {}
+
+    void add(const std::string& peer);
+    const std::string& owner(std::string_view key) const;
+    bool empty() const { return ring_.empty(); }
+
+    static uint64_t hash(std::string_view data);
+
+private:
+    int virtualNodes_;
+    std::vector<std::string> peers_;
+    std::map<uint64_t, size_t> ring_;     // point -> index into peers_
+};
+
+// Pooled connections to one peer. Thread-safe; a call that fails on a reused
+// connection is retried once on a fresh one.
+class PeerClient {
+public:
+    PeerClient(const PeerAddress& address, int timeoutMs, size_t maxIdle = 8);
+    ~PeerClient();
+
+    // False on transport errors (peer down, timeout, bad frame). message is the
+    // /api/message body the owner posts upstream if it has to load the key.
+    bool get(const std::string& key, const std::string& message, PeerReply& reply);
+
+private:
+    int connectSocket();
+    bool roundTrip(int fd, const std::string& request, PeerReply& reply);
+
+    PeerAddress address_;
+    int timeoutMs_;
+    size_t maxIdle_;
+    std::mutex mutex_;
+    std::vector<int> idle_;
+};
+
+// Accepts peer connections and serves Get requests, one thread per connection.
+class PeerServer {
+public:
+    using Handler = std::function<void(const std::string& key, const std::string& message, PeerReply& reply)>;
+
+    PeerServer(int port, Handler handler);
+    ~PeerServer();
+
+    bool start();
+    void stop();
+
+private:
+    struct Connection {
+        int fd;
+        std::thread thread;
+    };
+
+    void acceptLoop();
+    void serve(uint64_t id, int fd);
+    void joinFinished();
+
+    int port_;
+    Handler handler_;
+    int listenFd_;
+    std::atomic<bool> running_;
+    std::thread acceptThread_;
+    std::mutex mutex_;
+    std::condition_variable idleCond_;
+    // Open connections by id. A connection leaves the map before its fd is
+    // closed, so stop() never shuts down an fd number the kernel has reused.
+    std::unordered_map<uint64_t, Connection> connections_;
+    // Threads whose connection has ended, joined by the accept loop or stop()
+    std::vector<std::thread> finished_;
+    uint64_t nextConnection_ = 0;
+};
+
+// The static group as seen from one process: who owns a key and how to reach it.
+class PeerGroup {
+public:
+    PeerGroup() = default;
+    PeerGroup(const PeerAddress& self, const std::vector<PeerAddress>& peers, int virtualNodes, int timeoutMs);
+
+    bool enabled() const { return !ring_.empty(); }
+    bool isLocal(std::string_view key) const { return !enabled() || ring_.owner(key) == self_; }
+
+    // Ask the owner of key; false if it could not be reached
+    bool fetch(const std::string& key, const std::string& message, PeerReply& reply);
+
+    const std::string& ownerOf(std::string_view key) const { return ring_.owner(key); }
+    size_t size() const { return clients_.size() + (enabled() ? 1 : 0); }
+
+private:
+    std::string self_;
+    HashRing ring_;
+    std::unordered_map<std::string, std::unique_ptr<PeerClient>> clients_;
+};
+
+// Collapses concurrent loads of the same key into one call whose result every
+// caller receives.
+template <typename Value>
+class SingleFlight {
+public:
+    template <typename Fn>
+    Value run(const std::string& key, Fn&& load) {
+        std::shared_ptr<Call> call;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = calls_.find(key);
+            if (it == calls_.end()) {
+                call = std::make_shared<Call>();
+                calls_.emplace(key, call);
+                leader = true;
+            } else {
+                call = it->second;
+            }
+        }
+
+        if (!leader) {
+            std::unique_lock<std::mutex> lock(call->mutex);
+            call->cond.wait(lock, [&call] { return call->done; });
+            return call->value;
+        }
+
+        Value value;
+        try {
+            value = load();
+        } catch (...) {
+            finish(key, call, Value());
+            throw;
+        }
+        finish(key, call, value);
+        return value;
+    }
+
+private:
+    struct Call {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool done = false;
+        Value value;
+    };
+
+    void finish(const std::string& key, const std::shared_ptr<Call>& call, const Value& value) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.erase(key);
+        }
+        {
+            std::lock_guard<std::mutex> lock(call->mutex);
+            call->value = value;
+            call->done = true;
+        }
+        call->cond.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Call>> calls_;
+};
@@ -0,0 +1,367 @@
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cmdLine.h"
+#include "latencyHistogram.h"
+#include "cachedResponse.h"
+
+// Open-loop load generator for proxy_server.
+//
+// Requests are scheduled at a fixed rate (request i is due at start + i/rate) and
+// handed to whichever connection is free. Latency is measured from the scheduled
+// time, not from when the request was actually sent, so a stalled server is
+// charged for the requests that queued up behind it (no coordinated omission).
+//
+//   proxy_bench --mock-port=8888 --mock-delay-ms=300 --rate=500 &      # or run upstream_stub
+//   proxy_server --upstream-host=127.0.0.1 --upstream-port=8888 &
+//   proxy_bench --target=127.0.0.1:8889 --rate=500 --duration-s=30 --distinct=2000 --zipf=1.1
+//
+// Prompts come from a Zipf distribution over --distinct synthetic questions, or
+// from --prompts=file.jsonl (one JSON object per line; "message", else "body",
+// else "title" is sent). Hit rate is read from the proxy's /api/metrics/latency
+// counters before and after the measured window.
+
+using Clock = std::chrono::steady_clock;
+
+// Ranks 0..n-1 with P(k) proportional to 1/(k+1)^s
+class ZipfSampler {
+public:
+    ZipfSampler(size_t n, double s) : cdf_(n) {
+        double total = 0;
+        for (size_t k = 0; k < n; ++k) {
+            total += 1.0 / std::pow(static_cast<double>(k + 1), s);
+            cdf_[k] = total;
+        }
+        for (double& p : cdf_) {
+            p /= total;
+        }
+    }
+
+    size_t sample(std::mt19937_64& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return std::min<size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin(), cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+bool loadPrompts(const std::string& path, std::vector<std::string>& prompts) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        auto json = nlohmann::json::parse(line, nullptr, false);
+        if (json.is_discarded() || !json.is_object()) {
+            continue;
+        }
+        for (const char* field : {"message", "body", "title"}) {
+            if (json.contains(field) && json[field].is_string()) {
+                prompts.push_back(json[field].get<std::string>());
+                break;
+            }
+        }
+    }
+    return !prompts.empty();
+}
+
+// Cache counters from the proxy; false if the endpoint is unavailable
+bool readProxyCounters(const std::string& host, int port, uint64_t& hits, uint64_t& misses) {
+    httplib::Client client(host, port);
+    client.set_connection_timeout(2);
+    auto res = client.Get("/api/metrics/latency");
+    if (!res || res->status != 200) {
+        return false;
+    }
+    auto json = nlohmann::json::parse(res->body, nullptr, false);
+    if (json.is_discarded() || !json.contains("cache")) {
+        return false;
+    }
+    hits = json["cache"].value("hits", uint64_t(0));
+    misses = json["cache"].value("misses", uint64_t(0));
+    return true;
+}
+
+// In-process stand-in for http_server, same contract as upstream_stub
+class MockUpstream {
+public:
+    // Each call holds a worker for the whole delay, so the pool needs at least
+    // rate x delay threads or the benchmark measures the mock's queue
+    MockUpstream(int port, std::chrono::milliseconds delay, int threads) : port_(port), delay_(delay), calls_(0) {
+        server_.new_task_queue = [threads]() { return new httplib::ThreadPool(threads); };
+        server_.Get("/api/hello", [](const httplib::Request&, httplib::Response& res) {
+            res.set_content("{\"message\":\"Hello from proxy_bench mock\"}", "application/json");
+        });
+        server_.Post("/api/message", [this](const httplib::Request& req, httplib::Response& res) {
+            std::string message;
+            std::string conversationId;
+            parseMessageRequest(req.body, message, conversationId);
+            size_t n = ++calls_;
+            std::this_thread::sleep_for(delay_);
+
+            std::string body = "{\"content\":\"mock reply #" + std::to_string(n) + ": ";
+            JsonScanner::appendEscaped(body, message);
+            body += "\",\"role\":\"assistant\"}";
+            res.set_content(body, "application/json");
+        });
+    }
+
+    ~MockUpstream() {
+        server_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void start() {
+        thread_ = std::thread([this]() { server_.listen("0.0.0.0", port_); });
+        server_.wait_until_ready();
+    }
+
+    size_t calls() const { return calls_.load(); }
+
+private:
+    int port_;
+    std::chrono::milliseconds delay_;
+    std::atomic<size_t> calls_;
+    httplib::Server server_;
+    std::thread thread_;
+};
+
+nlohmann::json latencyJson(const LatencyHistogram::Snapshot& snapshot) {
+    return {
+        {"count", snapshot.count},
+        {"mean_us", snapshot.mean()},
+        {"p50_us", snapshot.percentile(0.50)},
+        {"p90_us", snapshot.percentile(0.90)},
+        {"p99_us", snapshot.percentile(0.99)},
+        {"p999_us", snapshot.percentile(0.999)},
+        {"max_us", snapshot.max}
+    };
+}
+
+void printLatency(const std::string& name, const LatencyHistogram::Snapshot& snapshot) {
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+              << " p50=" << std::setw(9) << snapshot.percentile(0.50) / 1000.0 << "ms"
+              << " p90=" << std::setw(9) << snapshot.percentile(0.90) / 1000.0 << "ms"
+              << " p99=" << std::setw(9) << snapshot.percentile(0.99) / 1000.0 << "ms"
+              << " p999=" << std::setw(9) << snapshot.percentile(0.999) / 1000.0 << "ms"
+              << " max=" << std::setw(9) << snapshot.max / 1000.0 << "ms\n";
+}
+
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+
+    std::unique_ptr<MockUpstream> mock;
+    if (args.has("mock-port")) {
+        // --mock-threads, else sized for --rate (1000 req/s if not given) with 50% headroom
+        auto delay = std::chrono::milliseconds(args.getInt("mock-delay-ms", 200));
+        double mockRate = args.getDouble("rate", 1000.0);
+        int threads = static_cast<int>(args.getInt("mock-threads",
+            static_cast<long long>(std::ceil(mockRate * delay.count() / 1000.0 * 1.5)) + 8));
+        mock = std::make_unique<MockUpstream>(static_cast<int>(args.getInt("mock-port", 8888)), delay, std::max(threads, 1));
+        mock->start();
+        std::cout << "Mock upstream on port " << args.getInt("mock-port", 8888) << " with "
+                  << std::max(threads, 1) << " worker threads\n";
+        if (!args.has("target")) {
+            // Mock only: keep serving until killed, e.g. for a proxy started by hand
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(60));
+            }
+        }
+    }
+
+    std::string target = args.get("target", "127.0.0.1:8889");
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "--target must be host:port\n";
+        return 1;
+    }
+    std::string host = target.substr(0, colon);
+    int port = std::atoi(target.c_str() + colon + 1);
+
+    double rate = args.getDouble("rate", 200.0);
+    auto duration = std::chrono::seconds(args.getInt("duration-s", 10));
+    auto warmup = std::chrono::seconds(args.getInt("warmup-s", 2));
+    int connections = static_cast<int>(args.getInt("connections", 64));
+    // 0: every request starts a new conversation, so keys depend on the message only
+    int conversations = static_cast<int>(args.getInt("conversations", 0));
+
+    std::vector<std::string> prompts;
+    if (args.has("prompts")) {
+        if (!loadPrompts(args.get("prompts", ""), prompts)) {
+            std::cerr << "No prompts in " << args.get("prompts", "") << "\n";
+            return 1;
+        }
+    } else {
+        size_t distinct = static_cast<size_t>(args.getInt("distinct", 1000));
+        for (size_t i = 0; i < distinct; ++i) {
+            prompts.push_back("Question " + std::to_string(i) + ": how does cache entry " + std::to_string(i) + " work?");
+        }
+    }
+    ZipfSampler zipf(prompts.size(), args.getDouble("zipf", 1.0));
+
+    if (rate <= 0 || connections <= 0) {
+        std::cerr << "--rate and --connections must be positive\n";
+        return 1;
+    }
+
+    LatencyHistogram latency;       // scheduled time -> response, what a user would see
+    LatencyHistogram service;       // send -> response
+    LatencyHistogram lag;           // scheduled time -> send, generator falling behind
+    std::atomic<uint64_t> next{0};
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> transportErrors{0};
+
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+    Clock::time_point measureFrom = start + warmup;
+    Clock::time_point end = measureFrom + duration;
+    auto interval = std::chrono::duration<double>(1.0 / rate);
+
+    uint64_t hitsBefore = 0;
+    uint64_t missesBefore = 0;
+    size_t mockCallsBefore = 0;
+    std::atomic<bool> baselineTaken{false};
+
+    std::cout << "Target " << target << ": " << rate << " req/s for " << duration.count() << "s (+" << warmup.count()
+              << "s warmup), " << connections << " connections, " << prompts.size() << " prompts\n";
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < connections; ++w) {
+        workers.emplace_back([&, w]() {
+            httplib::Client client(host, port);
+            client.set_connection_timeout(5);
+            client.set_read_timeout(120);
+            client.set_keep_alive(true);
+            std::mt19937_64 rng(0x9E3779B97F4A7C15ULL * (w + 1));
+
+            while (true) {
+                uint64_t i = next.fetch_add(1);
+                auto scheduled = start + std::chrono::duration_cast<Clock::duration>(interval * static_cast<double>(i));
+                if (scheduled >= end) {
+                    break;
+                }
+                std::this_thread::sleep_until(scheduled);
+
+                // The first request of the measured window snapshots the proxy counters
+                if (scheduled >= measureFrom && !baselineTaken.exchange(true)) {
+                    readProxyCounters(host, port, hitsBefore, missesBefore);
+                    mockCallsBefore = mock ? mock->calls() : 0;
+                }
+
+                std::string conversationId = conversations > 0 ? "bench-" + std::to_string(rng() % conversations)
+                                                                : "bench-" + std::to_string(i);
+                std::string body = "{\"message\":\"";
+                JsonScanner::appendEscaped(body, prompts[zipf.sample(rng)]);
+                body += "\",\"conversationId\":\"" + conversationId + "\"}";
+
+                auto sent = Clock::now();
+                auto res = client.Post("/api/message", body, "application/json");
+                auto done = Clock::now();
+                if (scheduled < measureFrom) {
+                    continue;
+                }
+
+                latency.record(done - scheduled);
+                service.record(done - sent);
+                lag.record(sent - scheduled);
+                if (!res) {
+                    ++transportErrors;
+                } else if (res->status >= 400) {
+                    ++errors;
+                } else {
+                    ++ok;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - measureFrom).count();
+
+    uint64_t hitsAfter = 0;
+    uint64_t missesAfter = 0;
+    bool haveCounters = baselineTaken.load() && readProxyCounters(host, port, hitsAfter, missesAfter);
+    uint64_t hits = hitsAfter - hitsBefore;
+    uint64_t misses = missesAfter - missesBefore;
+
+    auto latencySnapshot = latency.snapshot();
+    auto serviceSnapshot = service.snapshot();
+    auto lagSnapshot = lag.snapshot();
+    uint64_t completed = ok + errors + transportErrors;
+
+    nlohmann::json report = {
+        {"target", target},
+        {"rate", rate},
+        {"durationS", elapsed},
+        {"connections", connections},
+        {"prompts", prompts.size()},
+        {"completed", completed},
+        {"ok", ok.load()},
+        {"httpErrors", errors.load()},
+        {"transportErrors", transportErrors.load()},
+        {"rps", completed / elapsed},
+        {"latency", latencyJson(latencySnapshot)},
+        {"service", latencyJson(serviceSnapshot)},
+        {"sendLag", latencyJson(lagSnapshot)}
+    };
+    if (haveCounters) {
+        report["cache"] = {
+            {"hits", hits},
+            {"misses", misses},
+            {"hitRate", hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses)}
+        };
+    }
+    if (mock) {
+        report["upstreamCalls"] = mock->calls() - mockCallsBefore;
+    }
+
+    if (args.has("json")) {
+        std::string path = args.get("json", "");
+        if (path.empty() || path == "true") {
+            std::cout << report.dump(2) << "\n";
+        } else {
+            std::ofstream(path) << report.dump(2) << "\n";
+            std::cout << "Wrote " << path << "\n";
+        }
+        return 0;
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "completed=" << completed << " ok=" << ok.load() << " http_errors=" << errors.load()
+              << " transport_errors=" << transportErrors.load() << " rps=" << completed / elapsed << "\n";
+    printLatency("latency", latencySnapshot);
+    printLatency("service time", serviceSnapshot);
+    if (haveCounters) {
+        std::cout << "hit rate " << std::setprecision(2)
+                  << (hits + misses == 0 ? 0.0 : hits * 100.0 / (hits + misses)) << "% (" << hits << " hits, "
+                  << misses << " misses)\n";
+    }
+    if (mock) {
+        std::cout << "upstream calls " << mock->calls() - mockCallsBefore << "\n";
+    }
+    // Latency is still correct when the generator falls behind, but the offered rate was lower
+    if (lagSnapshot.percentile(0.99) > 10000) {
+        std::cout << "warning: p99 send lag " << lagSnapshot.percentile(0.99) / 1000.0
+                  << "ms, all connections were busy; raise --connections\n";
+    }
+    return 0;
+}
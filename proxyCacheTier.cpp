@@ -0,0 +1,167 @@
+#include "proxyCacheTier.h"
+#include <algorithm>
+#include "cacheKey.h"
+#include "jsonScanner.h"
+
+ProxyCacheTier::ProxyCacheTier(const Options& options)
+    : options_(options)
+    , responses_(options.capacity, options.slices, 10, options.slicePools)
+    , sessions_(options.sessionCapacity, options.sessionSlices, options.sessionLimits, options.slicePools)
+    , maxCacheTokens_(options.maxCacheTokens)
+{
+    responses_.enableThreadCache(options_.threadCacheEntries);
+    responses_.enableHotKeys(options_.hotKeyReplicas);
+    if (!options_.tokenizerFile.empty()) {
+        // Stays in estimate mode if the file can't be read; callers check hasMerges()
+        tokenizer_.loadMerges(options_.tokenizerFile);
+    }
+}
+
+ProxyCacheTier::Lookup ProxyCacheTier::prepare(const std::string& message, const std::string& conversationId) {
+    Lookup lookup;
+    lookup.inputTokens = static_cast<int>(tokenizer_.count(message));
+    lookup.cacheable = lookup.inputTokens <= maxCacheTokens_.load(std::memory_order_relaxed);
+    // Keyed on the normalized message plus a hash of the conversation's last
+    // turns, so follow-ups in different chats don't collide
+    if (lookup.cacheable) {
+        lookup.key = buildCacheKey(sessions_.context(conversationId), message);
+    }
+    return lookup;
+}
+
+bool ProxyCacheTier::find(const Lookup& lookup, Clock::time_point now, std::shared_ptr<const CachedResponse>& out,
+                          FreshnessPolicy::State& state) {
+    if (!lookup.cacheable || !responses_.getShared(lookup.key, out)) {
+        return false;
+    }
+    state = options_.freshness.classify(out->storedAt, now);
+    return true;
+}
+
+bool ProxyCacheTier::store(const Lookup& lookup, const CachedResponse& entry) {
+    if (!lookup.cacheable) {
+        return false;
+    }
+    responses_.put(lookup.key, entry);
+    return true;
+}
+
+nlohmann::json ProxyCacheTier::statsJson() {
+    nlohmann::json out = stats_.toJson();
+    out["entries"] = responses_.size();
+    auto l1 = responses_.threadCacheStats();
+    uint64_t lookups = l1.hits + l1.misses;
+    out["l1"] = {
+        {"entries", options_.threadCacheEntries},
+        {"hits", l1.hits},
+        {"misses", l1.misses},
+        {"hitRate", lookups == 0 ? 0.0 : l1.hits * 100.0 / lookups}
+    };
+    // hottestSliceShare: sampled reads landing on the busiest slice, in percent
+    auto hot = responses_.hotKeyStats();
+    uint64_t sampled = 0;
+    uint64_t hottest = 0;
+    for (uint64_t count : hot.sliceSamples) {
+        sampled += count;
+        hottest = std::max(hottest, count);
+    }
+    out["hotKeys"] = {
+        {"replicas", options_.hotKeyReplicas},
+        {"active", hot.hot},
+        {"promoted", hot.promoted},
+        {"demoted", hot.demoted},
+        {"replicaHits", hot.replicaHits},
+        {"hottestSliceShare", sampled == 0 ? 0.0 : hottest * 100.0 / sampled}
+    };
+    // Bytes the cache uses vs bytes its slice pools hold; fragmentation in percent
+    auto memory = responses_.memoryStats();
+    memory += sessions_.memoryStats();
+    out["memory"] = {
+        {"slicePools", options_.slicePools},
+        {"inUseBytes", memory.inUse},
+        {"heldBytes", memory.held},
+        {"fragmentation", memory.fragmentation() * 100.0}
+    };
+    return out;
+}
+
+void ProxyCacheTier::recordExchange(const std::string& conversationId, const std::string& message, std::string_view reply) {
+    sessions_.appendExchange(conversationId, message, reply);
+}
+
+std::string ProxyCacheTier::upstreamBody(const std::string& message, const std::string& conversationId) {
+    CacheImpl::SessionStore::View history;
+    bool haveHistory = !conversationId.empty() && sessions_.view(conversationId, history);
+
+    std::string body;
+    body.reserve(message.size() + conversationId.size() + (haveHistory ? history.bytes() + history.turns().size() * 40 : 0) + 64);
+    body += "{\"message\":\"";
+    JsonScanner::appendEscaped(body, message);
+    body += "\",\"conversationId\":\"";
+    JsonScanner::appendEscaped(body, conversationId);
+    body += "\",\"history\":[";
+    if (haveHistory) {
+        bool first = true;
+        for (const auto& turn : history.turns()) {
+            body += first ? "{\"role\":\"" : ",{\"role\":\"";
+            body += turn.role == CacheImpl::SessionStore::Role::User ? "user" : "assistant";
+            body += "\",\"content\":\"";
+            JsonScanner::appendEscaped(body, turn.content);
+            body += "\"}";
+            first = false;
+        }
+    }
+    body += "]}";
+    return body;
+}
+
+nlohmann::json ProxyCacheTier::sessionPage(uint64_t cursor, size_t limit) {
+    uint64_t nextCursor = 0;
+    auto page = sessions_.list(cursor, limit, nextCursor);
+
+    nlohmann::json sessions = nlohmann::json::array();
+    for (const auto& session : page) {
+        sessions.push_back({
+            {"id", session.id},
+            {"messageCount", session.messageCount},
+            {"bytes", session.bytes},
+            {"idleMs", session.idleMs},
+            {"preview", session.preview}
+        });
+    }
+
+    nlohmann::json response;
+    response["sessions"] = std::move(sessions);
+    response["total"] = sessions_.size();
+    if (nextCursor != 0) {
+        // 游标是 64 位整数，用字符串返回以免 JavaScript 丢精度
+        response["nextCursor"] = std::to_string(nextCursor);
+    }
+    return response;
+}
+
+bool ProxyCacheTier::sessionDetail(const std::string& conversationId, nlohmann::json& out) {
+    CacheImpl::SessionStore::View history;
+    if (!sessions_.view(conversationId, history)) {
+        return false;
+    }
+
+    nlohmann::json messages = nlohmann::json::array();
+    nlohmann::json turns = nlohmann::json::array();
+    for (const auto& turn : history.turns()) {
+        bool fromUser = turn.role == CacheImpl::SessionStore::Role::User;
+        if (fromUser) {
+            messages.push_back(turn.content);
+        }
+        turns.push_back({
+            {"role", fromUser ? "user" : "assistant"},
+            {"content", turn.content}
+        });
+    }
+
+    out = nlohmann::json::object();
+    out["messages"] = std::move(messages);
+    out["lastResponse"] = history.lastResponse();
+    out["turns"] = std::move(turns);
+    return true;
+}
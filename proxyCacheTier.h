@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "cachedResponse.h"
+#include "lfuCache.h"
+#include "sessionStore.h"
+#include "staleWhileRevalidate.h"
+#include "tokenizer.h"
+
+// Cache statistics
+struct CacheStats {
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> stale_hits{0};      // served while a refresh runs (or the upstream failed)
+    std::atomic<size_t> fail_fast{0};       // misses rejected by the negative cache
+    std::atomic<size_t> shed{0};            // misses rejected by the admission controller
+    std::atomic<size_t> peer_hits{0};       // misses answered by the owning peer
+    std::atomic<size_t> peer_served{0};     // requests from other peers answered here
+    std::atomic<size_t> circuit_open{0};    // misses refused while the upstream breaker was open
+    std::atomic<size_t> deadline_exceeded{0};   // misses whose request deadline ran out
+    std::atomic<size_t> total_entries{0};
+
+    double getHitRate() const {
+        size_t h = hits.load(), m = misses.load();
+        return (h + m) == 0 ? 0.0 : (h * 100.0 / (h + m));
+    }
+
+    nlohmann::json toJson() const {
+        return {
+            {"hits", hits.load()},
+            {"misses", misses.load()},
+            {"staleHits", stale_hits.load()},
+            {"failFast", fail_fast.load()},
+            {"shed", shed.load()},
+            {"peerHits", peer_hits.load()},
+            {"peerServed", peer_served.load()},
+            {"circuitOpen", circuit_open.load()},
+            {"deadlineExceeded", deadline_exceeded.load()},
+            {"hitRate", getHitRate()}
+        };
+    }
+};
+
+struct ProxyCacheTierOptions {
+    size_t capacity = 1000;
+    int slices = 4;
+    int maxCacheTokens = 256;           // longer messages are never cached
+    FreshnessPolicy freshness;
+    size_t sessionCapacity = 1000;
+    int sessionSlices = 4;
+    CacheImpl::SessionStore::Limits sessionLimits;
+    std::string tokenizerFile;          // DeepSeek tokenizer.json / merges.txt; empty: estimate
+    size_t threadCacheEntries = 0;      // per-thread L1 in front of the response cache; 0: off
+    size_t hotKeyReplicas = 8;          // read-only copies of detected hot keys; 0: off
+    bool slicePools = true;             // per-slice memory pools for cache and session nodes
+};
+
+// The caching half of proxy_server, for any process that answers /api/message:
+// token gating, context-aware keys, the response cache (replies kept
+// pre-serialized), the session store and the hit/miss counters.
+//
+// proxy_server puts it in front of an http_server over HTTP; http_server
+// --cache-tier runs it in-process, so a hit costs no extra hop. Upstream calls,
+// admission control and peers stay with the caller.
+class ProxyCacheTier {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Options = ProxyCacheTierOptions;
+    using ResponseCache = CacheImpl::HashLfuCache<std::string, CachedResponse>;
+
+    // Cache identity of one request
+    struct Lookup {
+        int inputTokens = 0;
+        bool cacheable = false;         // within maxCacheTokens
+        std::string key;                // empty when not cacheable
+    };
+
+    explicit ProxyCacheTier(const Options& options);
+
+    ProxyCacheTier(const ProxyCacheTier&) = delete;
+    ProxyCacheTier& operator=(const ProxyCacheTier&) = delete;
+
+    // Count tokens and, if cacheable, build the key from the message and the
+    // conversation's recent turns
+    Lookup prepare(const std::string& message, const std::string& conversationId);
+
+    // Cached reply (shared, never modified) and its freshness at `now`; false on a miss
+    bool find(const Lookup& lookup, Clock::time_point now, std::shared_ptr<const CachedResponse>& out,
+              FreshnessPolicy::State& state);
+
+    // Keep an upstream reply; false if the request wasn't cacheable
+    bool store(const Lookup& lookup, const CachedResponse& entry);
+
+    // Append the exchange to the conversation (it feeds the next keys)
+    void recordExchange(const std::string& conversationId, const std::string& message, std::string_view reply);
+
+    // Body for an upstream /api/message call: message, conversationId and history
+    std::string upstreamBody(const std::string& message, const std::string& conversationId);
+
+    // /api/session/list and /api/session/:id payloads; false if the session is unknown
+    nlohmann::json sessionPage(uint64_t cursor, size_t limit);
+    bool sessionDetail(const std::string& conversationId, nlohmann::json& out);
+
+    ResponseCache& responses() { return responses_; }
+    CacheImpl::SessionStore& sessions() { return sessions_; }
+    const Tokenizer& tokenizer() const { return tokenizer_; }
+    const FreshnessPolicy& freshness() const { return options_.freshness; }
+    CacheStats& stats() { return stats_; }
+
+    // stats() plus entry count, the per-thread L1 hit rate, hot-key replication
+    // and slice pool memory
+    nlohmann::json statsJson();
+    std::atomic<int>& maxCacheTokens() { return maxCacheTokens_; }
+
+private:
+    Options options_;
+    ResponseCache responses_;
+    CacheImpl::SessionStore sessions_;
+    Tokenizer tokenizer_;
+    CacheStats stats_;
+    std::atomic<int> maxCacheTokens_;
+};
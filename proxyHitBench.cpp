@@ -0,0 +1,132 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+#include "lfuCache.h"
+#include "cachedResponse.h"
+
+using namespace CacheImpl;
+
+// Timer class
+class Timer {
+public:
+    Timer() : start_(std::chrono::high_resolution_clock::now()) {}
+
+    double elapsed() {
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start_).count();
+    }
+
+private:
+    std::chrono::time_point<std::chrono::high_resolution_clock> start_;
+};
+
+// Cache hit path as proxy_server handled it before: DOM parse, DOM build, dump
+std::string legacyHit(HashLfuCache<std::string, CachedResponse>& cache, const std::string& requestBody) {
+    auto json = nlohmann::json::parse(requestBody);
+    std::string message = json["message"];
+    std::string conversationId = json.value("conversationId", "");
+
+    CachedResponse cached;
+    if (!cache.get(message, cached)) {
+        return {};
+    }
+
+    nlohmann::json response;
+    response["conversationId"] = conversationId;
+    response["content"] = cached.content;
+    response["role"] = cached.role;
+    return response.dump();
+}
+
+// Current hit path: on-demand field scan, pre-serialized body splice
+std::string scannedHit(HashLfuCache<std::string, CachedResponse>& cache, const std::string& requestBody) {
+    std::string message;
+    std::string conversationId;
+    parseMessageRequest(requestBody, message, conversationId);
+
+    CachedResponse cached;
+    if (!cache.get(message, cached)) {
+        return {};
+    }
+
+    std::string body;
+    renderCachedResponse(cached, conversationId, body);
+    return body;
+}
+
+// Shared value, from the per-thread L1 when the cache has one: no lock, no copy
+std::string sharedHit(HashLfuCache<std::string, CachedResponse>& cache, const std::string& requestBody) {
+    std::string message;
+    std::string conversationId;
+    parseMessageRequest(requestBody, message, conversationId);
+
+    std::shared_ptr<const CachedResponse> cached;
+    if (!cache.getShared(message, cached)) {
+        return {};
+    }
+
+    std::string body;
+    renderCachedResponse(*cached, conversationId, body);
+    return body;
+}
+
+void runCase(const std::string& name, int iterations,
+             HashLfuCache<std::string, CachedResponse>& cache, const std::string& requestBody,
+             std::string (*hit)(HashLfuCache<std::string, CachedResponse>&, const std::string&)) {
+    size_t bytes = 0;
+    Timer timer;
+    for (int i = 0; i < iterations; ++i) {
+        bytes += hit(cache, requestBody).size();
+    }
+    double ms = timer.elapsed();
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << (ms * 1000.0 / iterations) << " us/hit"
+              << "  (" << bytes / iterations << " bytes)\n";
+}
+
+bool sameResponse(const std::string& a, const std::string& b) {
+    return nlohmann::json::parse(a) == nlohmann::json::parse(b);
+}
+
+int main() {
+    const int ITERATIONS = 200000;
+
+    HashLfuCache<std::string, CachedResponse> cache(1000, 4);
+    HashLfuCache<std::string, CachedResponse> l1Cache(1000, 4);
+    l1Cache.enableThreadCache(256);
+
+    struct Case {
+        std::string name;
+        std::string message;
+        std::string reply;
+    };
+    std::vector<Case> cases = {
+        {"short reply", "hello", "Hello! How can I help you today?"},
+        {"escaped reply", "你好", "你好！我是 \"DeepSeek\" 助手。\n\n- 回答问题\n- 写代码\t等等"},
+        {"1 KiB reply", "what can you do", std::string(1024, 'x')},
+        {"8 KiB reply", "explain LRU", std::string(8192, 'y')},
+    };
+
+    for (const auto& c : cases) {
+        cache.put(c.message, makeCachedResponse(c.reply, "assistant"));
+        l1Cache.put(c.message, makeCachedResponse(c.reply, "assistant"));
+
+        nlohmann::json request = {{"message", c.message}, {"conversationId", "conv-1234567890"}};
+        std::string requestBody = request.dump();
+
+        if (!sameResponse(legacyHit(cache, requestBody), scannedHit(cache, requestBody))) {
+            std::cout << "Mismatch for " << c.name << "\n";
+            return 1;
+        }
+
+        std::cout << "\n=== " << c.name << " ===\n";
+        runCase("legacy (DOM + dump)", ITERATIONS, cache, requestBody, legacyHit);
+        runCase("scan + splice", ITERATIONS, cache, requestBody, scannedHit);
+        runCase("scan + splice, L1", ITERATIONS, l1Cache, requestBody, sharedHit);
+    }
+
+    return 0;
+}
@@ -3,43 +3,249 @@
 #include <string>
 #include <nlohmann/json.hpp>
 #include <filesystem>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <memory>
 #include "lfuCache.h"
 #include <atomic>
 #include "lruCache.h"
+#include "sessionStore.h"
+#include "asyncLogger.h"
+#include "tokenizer.h"
+#include "staticAssets.h"
+#include "latencyHistogram.h"
+#include "cachedResponse.h"
+#include "staleWhileRevalidate.h"
+#include "admissionController.h"
+#include "peerCache.h"
+#include "cmdLine.h"
+#include "proxyCacheTier.h"
+#include "cacheKey.h"
+#include "circuitBreaker.h"
+#include "coreServers.h"
+#include "requestParams.h"
 
-// Cache response structure
-struct CachedResponse {
-    std::string content;
-    std::string role;
+// Latency series recorded by the /api/message handler, one per outcome.
+// upstream is the time spent waiting on http_server, proxy_overhead the rest of a miss.
+struct MessageLatency {
+    LatencyHistogram& cacheHit;
+    LatencyHistogram& staleHit;
+    LatencyHistogram& failFast;
+    LatencyHistogram& shed;
+    LatencyHistogram& admissionWait;
+    LatencyHistogram& peer;
+    LatencyHistogram& upstreamOk;
+    LatencyHistogram& upstreamError;
+    LatencyHistogram& jsonParse;
+    LatencyHistogram& upstream;
+    LatencyHistogram& proxyOverhead;
 };
 
-// Cache statistics
-struct CacheStats {
-    size_t hits = 0;
-    size_t misses = 0;
-    size_t total_entries = 0;
-    
-    double getHitRate() const {
-        return (hits + misses) == 0 ? 0.0 : (hits * 100.0 / (hits + misses));
+// Upstream http_server address, switchable at runtime through /api/admin/cache.
+// Upstream calls use a client per thread (each request sets its own read
+// timeout from its deadline), rebuilt when the address changes; the shared
+// client is for one-off calls.
+class UpstreamTarget {
+public:
+    UpstreamTarget(const std::string& host, int port) : generation_(0) {
+        set(host, port);
+    }
+
+    void set(const std::string& host, int port) {
+        auto client = makeClient(host, port);
+        std::lock_guard<std::mutex> lock(mutex_);
+        host_ = host;
+        port_ = port;
+        shared_ = std::move(client);
+        ++generation_;
+    }
+
+    std::string address() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return host_ + ":" + std::to_string(port_);
+    }
+
+    // Held for the duration of one call, so a switch never closes a client in use
+    std::shared_ptr<httplib::Client> shared() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return shared_;
+    }
+
+    httplib::Client& local() {
+        thread_local std::unique_ptr<httplib::Client> client;
+        thread_local uint64_t client_generation = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!client || client_generation != generation_) {
+            client = makeClient(host_, port_);
+            client_generation = generation_;
+        }
+        return *client;
+    }
+
+private:
+    static std::unique_ptr<httplib::Client> makeClient(const std::string& host, int port) {
+        auto client = std::make_unique<httplib::Client>(host, port);
+        client->set_connection_timeout(5);
+        client->set_read_timeout(60);
+        client->set_write_timeout(60);
+        client->set_keep_alive(true);
+        client->set_default_headers({
+            {"Connection", "keep-alive"},
+            {"Keep-Alive", "timeout=60"}
+        });
+        return client;
     }
-};
 
-// 会话历史结构
-struct SessionHistory {
-    std::vector<std::string> messages;
-    std::string lastResponse;
+    mutable std::mutex mutex_;
+    std::string host_;
+    int port_;
+    std::shared_ptr<httplib::Client> shared_;
+    uint64_t generation_;
 };
 
-int main() {
+bool isLoopback(const std::string& address) {
+    return address == "127.0.0.1" || address == "::1" || address == "::ffff:127.0.0.1";
+}
+
+nlohmann::json latencyToJson(const LatencyHistogram::Snapshot& snapshot, bool with_buckets) {
+    nlohmann::json series = {
+        {"count", snapshot.count},
+        {"mean_us", snapshot.mean()},
+        {"p50_us", snapshot.percentile(0.50)},
+        {"p90_us", snapshot.percentile(0.90)},
+        {"p99_us", snapshot.percentile(0.99)},
+        {"p999_us", snapshot.percentile(0.999)},
+        {"max_us", snapshot.max}
+    };
+    if (with_buckets) {
+        // Sparse [index, count] pairs; snapshots from several proxies merge by adding counts
+        nlohmann::json buckets = nlohmann::json::array();
+        for (size_t i = 0; i < snapshot.counts.size(); ++i) {
+            if (snapshot.counts[i] != 0) {
+                buckets.push_back({i, snapshot.counts[i]});
+            }
+        }
+        series["sum_us"] = snapshot.sum;
+        series["buckets"] = std::move(buckets);
+    }
+    return series;
+}
+
+// Who to bill: X-Client-Id if the caller sets one, else its address
+std::string clientId(const httplib::Request& req) {
+    std::string id = req.get_header_value("X-Client-Id");
+    return id.empty() ? req.remote_addr : id;
+}
+
+// Respond to a miss that can't (or shouldn't) reach the upstream: the expired entry if
+// there is one, otherwise `status` (503 by default) with Retry-After.
+void serveWithoutUpstream(httplib::Response& res, const CachedResponse* expired, const std::string& conversationId,
+                          std::chrono::steady_clock::duration retry_after, const std::string& reason, int status = 503) {
+    if (expired) {
+        std::string body;
+        renderCachedResponse(*expired, conversationId, body);
+        res.set_header("Warning", "111 - \"Revalidation Failed\"");
+        res.set_content(std::move(body), "application/json");
+        return;
+    }
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(retry_after).count() + 1;
+    nlohmann::json error = {
+        {"error", reason}
+    };
+    res.status = status;
+    res.set_header("Retry-After", std::to_string(seconds));
+    res.set_content(error.dump(), "application/json");
+}
+
+// Split "a,b,c" peer lists; false if any entry is not host:port
+bool parsePeerList(const std::string& text, std::vector<PeerAddress>& peers) {
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        PeerAddress address;
+        if (!item.empty()) {
+            if (!PeerAddress::parse(item, address)) {
+                return false;
+            }
+            peers.push_back(address);
+        }
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
     try {
-        httplib::Server svr;
+        CommandLine args(argc, argv);
 
-        // Set CORS headers
-        svr.set_default_headers({
-            {"Access-Control-Allow-Origin", "*"},
-            {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
-            {"Access-Control-Allow-Headers", "Content-Type"}
-        });
+        // Cache entry windows, e.g. --fresh-ttl-ms=60000 --stale-ttl-ms=600000 --negative-ttl-ms=2000
+        FreshnessPolicy freshness;
+        freshness.fresh = std::chrono::milliseconds(args.getInt("fresh-ttl-ms", freshness.fresh.count()));
+        freshness.stale = std::chrono::milliseconds(args.getInt("stale-ttl-ms", freshness.stale.count()));
+        freshness.negative = std::chrono::milliseconds(args.getInt("negative-ttl-ms", freshness.negative.count()));
+        freshness.failFastAfter = static_cast<int>(args.getInt("fail-fast-after", freshness.failFastAfter));
+        std::string upstream_host = args.get("upstream-host", "172.18.0.10");
+        int upstream_port = static_cast<int>(args.getInt("upstream-port", 8888));
+        int http_port = static_cast<int>(args.getInt("port", 8889));
+
+        // Peer mode: --self=127.0.0.1:9901 --peers=127.0.0.1:9901,127.0.0.1:9902,127.0.0.1:9903
+        // (the same list on every proxy; --self is this proxy's peer RPC address)
+        PeerGroup peer_group;
+        PeerAddress peer_self;
+        if (args.has("peers")) {
+            std::vector<PeerAddress> peers;
+            if (!PeerAddress::parse(args.get("self", ""), peer_self) || !parsePeerList(args.get("peers", ""), peers)) {
+                std::cerr << "Peer mode needs --self=host:port and --peers=host:port,..." << std::endl;
+                return 1;
+            }
+            peer_group = PeerGroup(peer_self, peers,
+                                   static_cast<int>(args.getInt("peer-vnodes", 64)),
+                                   static_cast<int>(args.getInt("peer-timeout-ms", 65000)));
+        }
+
+        // Concurrency limit on upstream calls, e.g. --max-concurrency=64 --admission-queue=32 --admission-wait-ms=1000
+        AdmissionController::Options admission_options;
+        admission_options.initialLimit = static_cast<int>(args.getInt("initial-concurrency", admission_options.initialLimit));
+        admission_options.maxLimit = static_cast<int>(args.getInt("max-concurrency", admission_options.maxLimit));
+        admission_options.maxQueued = static_cast<size_t>(args.getInt("admission-queue", admission_options.maxQueued));
+        admission_options.maxWait = std::chrono::milliseconds(args.getInt("admission-wait-ms", admission_options.maxWait.count()));
+
+        // End-to-end deadline of a miss: --request-timeout-ms, or less if the client
+        // sends X-Deadline-Ms. What is left goes to http_server in the same header.
+        auto request_timeout = std::chrono::milliseconds(args.getInt("request-timeout-ms", 60000));
+
+        // Breaker on the upstream, e.g. --breaker-failure-rate=0.5 --breaker-min-requests=20
+        // --breaker-slow-ms=20000 --breaker-open-ms=5000
+        CircuitBreakerOptions breaker_options;
+        breaker_options.failureRate = args.getDouble("breaker-failure-rate", breaker_options.failureRate);
+        breaker_options.minCalls = static_cast<size_t>(args.getInt("breaker-min-requests", breaker_options.minCalls));
+        breaker_options.slowCall = std::chrono::milliseconds(args.getInt("breaker-slow-ms", breaker_options.slowCall.count()));
+        breaker_options.openFor = std::chrono::milliseconds(args.getInt("breaker-open-ms", breaker_options.openFor.count()));
+        CircuitBreaker upstream_breaker(breaker_options);
+
+        // Token spend and what cache hits save, in USD per million tokens, e.g.
+        //   --price-input=0.27 --price-cached-input=0.07 --price-output=1.10
+        UsageAccounting::Options usage_options;
+        usage_options.pricing.inputCacheMiss = args.getDouble("price-input", usage_options.pricing.inputCacheMiss);
+        usage_options.pricing.inputCacheHit = args.getDouble("price-cached-input", usage_options.pricing.inputCacheHit);
+        usage_options.pricing.output = args.getDouble("price-output", usage_options.pricing.output);
+        usage_options.maxKeys = static_cast<size_t>(args.getInt("usage-max-keys", usage_options.maxKeys));
+        UsageAccounting usage(usage_options);
+
+        // Per-request logging goes through the async logger, startup messages stay on stdout
+        AsyncLogger::Options log_options;
+        log_options.path = "proxy_server.log";
+        AsyncLogger::instance().start(log_options);
+
+        // Routes are collected here and mounted on the server (one per core with --cores)
+        RouteSet routes;
 
         // Set static file directory
         std::string exe_path = std::filesystem::current_path().string();
@@ -51,77 +257,230 @@ int main() {
             std::filesystem::create_directories(static_path);
         }
         
-        if (!svr.set_mount_point("/", static_path)) {
-            std::cout << "Failed to set static directory" << std::endl;
-            return 1;
+        // Static files are served from memory (gzip + ETag); the route is registered last
+        StaticAssets static_assets(static_path);
+        static_assets.load();
+        if (args.getBool("watch-static", false) && !static_assets.watch()) {
+            std::cout << "Failed to watch static directory, changes need a restart" << std::endl;
         }
 
-        // Create main server client
-        httplib::Client main_server("172.18.0.10", 8888);
-        
-        // Configure client
-        main_server.set_connection_timeout(5);
-        main_server.set_read_timeout(60);
-        main_server.set_write_timeout(60);
-        main_server.set_keep_alive(true);
-        main_server.set_default_headers({
-            {"Connection", "keep-alive"},
-            {"Keep-Alive", "timeout=60"}
-        });
+        // Main server client (address can be switched through /api/admin/cache)
+        UpstreamTarget upstream(upstream_host, upstream_port);
 
-        // Create cache (capacity 1000, 4 slices)
-        CacheImpl::HashLfuCache<std::string, CachedResponse> response_cache_{1000, 4};
-        const int MAX_CACHE_TOKEN = 64;
-        CacheStats cache_stats;
-
-        // 创建会话历史LRU缓存，容量为1000个会话
-        CacheImpl::HashLruCache<std::string, SessionHistory> session_cache(1000, 4);
-
-        // Token calculation function
-        auto calculateTokens = [](const std::string& content) -> int {
-            int tokens = 0;
-            std::string current_word;
-            
-            for (char c : content) {
-                if (std::isspace(c)) {
-                    if (!current_word.empty()) {
-                        if (current_word.length() == 1 && (unsigned char)current_word[0] > 127) {
-                            tokens += 1;
-                        } else {
-                            tokens += (current_word.length() + 3) / 4;
-                        }
-                        current_word.clear();
-                    }
-                } else {
-                    current_word += c;
-                }
+        // Response cache, sessions and token gating (proxyCacheTier.h); capacity, slice
+        // count and the token limit can be changed later through /api/admin/cache.
+        ProxyCacheTier::Options tier_options;
+        tier_options.capacity = static_cast<size_t>(args.getInt("cache-capacity", 1000));
+        tier_options.slices = static_cast<int>(args.getInt("cache-slices", 4));
+        // Context-aware keys make longer multi-turn prompts safe to cache
+        tier_options.maxCacheTokens = static_cast<int>(args.getInt("max-cache-tokens", 256));
+        tier_options.freshness = freshness;
+        // 会话存储，容量为1000个会话，每个会话最多保留200条消息 / 256KB
+        tier_options.sessionLimits.maxMessages = 200;
+        tier_options.sessionLimits.maxBytes = 256 * 1024;
+        tier_options.sessionLimits.contextTurns = static_cast<size_t>(args.getInt("cache-context-turns", tier_options.sessionLimits.contextTurns));
+        // Per-thread L1 for the hottest keys, e.g. --l1-entries=256 (0: off)
+        tier_options.threadCacheEntries = static_cast<size_t>(args.getInt("l1-entries", 0));
+        // Copies of keys that dominate their slice, e.g. --hot-key-replicas=8 (0: off)
+        tier_options.hotKeyReplicas = static_cast<size_t>(args.getInt("hot-key-replicas", tier_options.hotKeyReplicas));
+        // Per-slice memory pools for cache and session nodes; --slice-pools=0 uses the global heap
+        tier_options.slicePools = args.getBool("slice-pools", tier_options.slicePools);
+        // Token counting: fast UTF-8 estimate, or exact BPE when a DeepSeek
+        // tokenizer.json / merges.txt is given through DEEPSEEK_TOKENIZER_FILE
+        if (const char* tokenizer_file = std::getenv("DEEPSEEK_TOKENIZER_FILE")) {
+            tier_options.tokenizerFile = tokenizer_file;
+        }
+        // Thread-per-core mode, e.g. --cores=32: one listener per pinned CPU (SO_REUSEPORT)
+        // with --core-workers threads each, and every core owning a share of the cache
+        // slices. The slice count is rounded up to a multiple of the cores; the L1 and
+        // hot-key replicas are off, since each key already lives on one core.
+        std::vector<int> core_cpus = CoreRouter::availableCpus();
+        size_t cores = static_cast<size_t>(std::max(0LL, args.getInt("cores", 0)));
+        if (cores > core_cpus.size()) {
+            std::cout << "Only " << core_cpus.size() << " CPUs available, using " << core_cpus.size() << " cores" << std::endl;
+            cores = core_cpus.size();
+        }
+        core_cpus.resize(cores);
+        int core_workers = static_cast<int>(args.getInt("core-workers", 8));
+        if (cores > 0) {
+            tier_options.slices = static_cast<int>((std::max<size_t>(tier_options.slices, 1) + cores - 1) / cores * cores);
+            tier_options.threadCacheEntries = 0;
+            tier_options.hotKeyReplicas = 0;
+        }
+        ProxyCacheTier cache_tier(tier_options);
+        if (!tier_options.tokenizerFile.empty()) {
+            if (cache_tier.tokenizer().hasMerges()) {
+                std::cout << "Loaded " << cache_tier.tokenizer().mergeCount() << " BPE merges from " << tier_options.tokenizerFile << std::endl;
+            } else {
+                std::cout << "Failed to load tokenizer file " << tier_options.tokenizerFile << ", using estimate" << std::endl;
             }
-            
-            if (!current_word.empty()) {
-                if (current_word.length() == 1 && (unsigned char)current_word[0] > 127) {
-                    tokens += 1;
-                } else {
-                    tokens += (current_word.length() + 3) / 4;
-                }
+        }
+        auto& response_cache_ = cache_tier.responses();
+        auto& session_store = cache_tier.sessions();
+        auto& max_cache_tokens = cache_tier.maxCacheTokens();
+        auto& cache_stats = cache_tier.stats();
+
+        std::unique_ptr<CoreRouter> core_router;
+        if (cores > 0) {
+            core_router = std::make_unique<CoreRouter>(core_cpus);
+            core_router->start();
+            response_cache_.routeToCores(core_router.get());
+            std::cout << "Thread-per-core: " << cores << " cores, " << core_workers << " workers and "
+                      << tier_options.slices / cores << " cache slices each" << std::endl;
+        }
+
+        // Latency histograms per route and outcome
+        LatencyRegistry latency;
+        MessageLatency message_latency{
+            latency.series("message.cache_hit"),
+            latency.series("message.stale_hit"),
+            latency.series("message.fail_fast"),
+            latency.series("message.shed"),
+            latency.series("message.admission_wait"),
+            latency.series("message.peer"),
+            latency.series("message.upstream_ok"),
+            latency.series("message.upstream_error"),
+            latency.series("message.json_parse"),
+            latency.series("message.upstream"),
+            latency.series("message.proxy_overhead")
+        };
+        LatencyHistogram& session_latency = latency.series("session.get");
+        LatencyHistogram& session_list_latency = latency.series("session.list");
+
+        // Print cache statistics (one debug line, filtered out at the default level)
+        auto printCacheStats = [&cache_stats, &response_cache_]() {
+            LOG_DEBUG("event=cache_stats capacity=%zu entries=%zu hits=%zu misses=%zu hit_rate=%.2f",
+                      response_cache_.capacity(), cache_stats.total_entries.load(), cache_stats.hits.load(), cache_stats.misses.load(),
+                      cache_stats.getHitRate());
+        };
+
+        // Recent upstream failures, per message and backend-wide
+        NegativeCache negative_cache(1000, freshness);
+
+        // Cache hits never go through the limiter; only upstream calls do
+        AdmissionController admission(admission_options);
+
+        // Upstream call made outside a client request (stale refresh, peer load). With
+        // wait=false it only runs if the limiter has a free slot. Stores a 2xx reply in
+        // response_cache_; false with retry_after set if it could not run, failed or got
+        // an error status.
+        // body is the /api/message request the miss would have sent (ProxyCacheTier::upstreamBody).
+        auto load_upstream = [&response_cache_, &negative_cache, &admission, &usage, &upstream_breaker](httplib::Client& client, const std::string& key, const std::string& body, bool wait,
+                                                                             CachedResponse& loaded, std::chrono::steady_clock::duration& retry_after) {
+            AdmissionController::Permit permit;
+            auto load_started = std::chrono::steady_clock::now();
+            auto deadline = wait ? std::chrono::steady_clock::time_point::max() : load_started;
+            if (admission.acquire(deadline, permit, retry_after) != AdmissionController::Decision::Admitted) {
+                LOG_DEBUG("event=load_skipped reason=overload");
+                return false;
+            }
+            if (!upstream_breaker.allow(std::chrono::steady_clock::now(), retry_after)) {
+                permit.release(AdmissionController::Outcome::Ignore, std::chrono::steady_clock::duration::zero());
+                LOG_DEBUG("event=load_skipped reason=circuit_open");
+                return false;
+            }
+
+            auto load_res = client.Post("/api/message", body, "application/json");
+            auto load_elapsed = std::chrono::steady_clock::now() - load_started;
+            upstream_breaker.record(load_res && load_res->status < 500 && load_res->status != 429, load_elapsed, std::chrono::steady_clock::now());
+            if (!load_res || load_res->status >= 500) {
+                permit.release(AdmissionController::Outcome::Dropped, load_elapsed);
+                negative_cache.recordFailure(key, std::chrono::steady_clock::now());
+                negative_cache.failing(key, std::chrono::steady_clock::now(), retry_after);
+                LOG_WARN("event=load_failed status=%d", load_res ? load_res->status : 0);
+                return false;
+            }
+            if (load_res->status == 429) {
+                // The upstream is shedding load: back off, and pass on how long it asked us to wait
+                permit.release(AdmissionController::Outcome::Dropped, load_elapsed);
+                uint64_t seconds = 1;
+                parseUnsigned(load_res->get_header_value("Retry-After"), seconds);
+                retry_after = std::chrono::seconds(std::min<uint64_t>(seconds, 60));
+                LOG_WARN("event=load_throttled retry_after_s=%llu", static_cast<unsigned long long>(seconds));
+                return false;
             }
-            
-            return tokens;
+            permit.release(AdmissionController::Outcome::Success, load_elapsed);
+            if (load_res->status < 200 || load_res->status >= 300) {
+                // An error reply is not an answer to cache or hand to peers
+                retry_after = std::chrono::steady_clock::duration::zero();
+                LOG_WARN("event=load_rejected status=%d", load_res->status);
+                return false;
+            }
+            negative_cache.recordSuccess(key);
+
+            std::string assistant_reply;
+            std::string role;
+            parseUpstreamReply(load_res->body, assistant_reply, role);
+            loaded = makeCachedResponse(std::move(assistant_reply), std::move(role));
+            parseUpstreamUsage(load_res->body, loaded.usage);
+            usage.recordSpent("", "(background)", loaded.usage);
+            response_cache_.put(key, loaded);
+            LOG_DEBUG("event=load_done status=%d bytes=%zu", load_res->status, loaded.content.size());
+            return true;
         };
 
-        // Print cache statistics
-        auto printCacheStats = [&cache_stats]() {
-            std::cout << "\nCache Statistics:" << std::endl;
-            std::cout << "Total Capacity: 1000" << std::endl;
-            std::cout << "Current Entries: " << cache_stats.total_entries << std::endl;
-            std::cout << "Cache Hits: " << cache_stats.hits << std::endl;
-            std::cout << "Cache Misses: " << cache_stats.misses << std::endl;
-            std::cout << "Hit Rate: " << cache_stats.getHitRate() << "%" << std::endl;
-            std::cout << "------------------------" << std::endl;
+        // Background revalidation of stale entries, on its own connection so it never
+        // competes with request threads for the shared client. Refreshes only use spare capacity.
+        CacheRefresher refresher(256, [&upstream, &load_upstream](const std::string& key, const std::string& body) {
+            CachedResponse refreshed;
+            std::chrono::steady_clock::duration retry_after;
+            load_upstream(upstream.local(), key, body, false, refreshed, retry_after);
+        });
+
+        // Keys owned by other peers: a small local copy of what the owners returned
+        CacheImpl::LruCache<std::string, CachedResponse> peer_hot_cache(static_cast<int>(args.getInt("peer-hot-cache", 256)));
+
+        // Owner side of peer mode: answer from response_cache_, or load once per key
+        // however many peers ask at the same time
+        SingleFlight<PeerReply> peer_loads;
+        auto fill_peer_reply = [](const CachedResponse& entry, std::chrono::steady_clock::time_point now, PeerReply& reply) {
+            reply.status = PeerReply::Status::Ok;
+            reply.ageMs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.storedAt).count());
+            reply.content = entry.content;
+            reply.role = entry.role;
         };
+        PeerServer peer_server(peer_self.port, [&](const std::string& key, const std::string& body, PeerReply& reply) {
+            cache_stats.peer_served++;
+            auto now = std::chrono::steady_clock::now();
+            CachedResponse cached;
+            bool have_cached = response_cache_.get(key, cached);
+            if (have_cached) {
+                auto state = freshness.classify(cached.storedAt, now);
+                if (state != FreshnessPolicy::State::Expired) {
+                    if (state == FreshnessPolicy::State::Stale) {
+                        refresher.schedule(key, body);
+                    }
+                    usage.recordAvoided("", "(peer)", cached.usage);
+                    fill_peer_reply(cached, now, reply);
+                    return;
+                }
+            }
+
+            reply = peer_loads.run(key, [&]() {
+                PeerReply loaded_reply;
+                std::chrono::steady_clock::duration retry_after{};
+                CachedResponse loaded;
+                if (!negative_cache.failing(key, now, retry_after)) {
+                    // One upstream connection per peer connection thread
+                    if (load_upstream(upstream.local(), key, body, true, loaded, retry_after)) {
+                        fill_peer_reply(loaded, std::chrono::steady_clock::now(), loaded_reply);
+                        return loaded_reply;
+                    }
+                }
+                if (have_cached) {
+                    fill_peer_reply(cached, std::chrono::steady_clock::now(), loaded_reply);
+                    return loaded_reply;
+                }
+                loaded_reply.status = PeerReply::Status::Unavailable;
+                loaded_reply.retryAfterMs = static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(retry_after).count());
+                return loaded_reply;
+            });
+        });
 
         // Try to connect to main server
         std::cout << "Connecting to main server..." << std::endl;
-        auto test_res = main_server.Get("/api/hello");
+        auto test_res = upstream.shared()->Get("/api/hello");
         if (!test_res) {
             std::cerr << "Failed to connect to main server" << std::endl;
             return 1;
@@ -129,87 +488,257 @@ int main() {
         std::cout << "Connected to main server" << std::endl;
 
         // Handle message POST request
-        svr.Post("/api/message", [&main_server, &response_cache_, &calculateTokens, &cache_stats, &printCacheStats, &session_cache](const httplib::Request &req, httplib::Response &res) {
+        routes.Post("/api/message", [&upstream, &cache_tier, &response_cache_, &cache_stats, &printCacheStats, &session_store, &message_latency,
+                                  &freshness, &negative_cache, &refresher, &admission, &peer_group, &peer_hot_cache, &max_cache_tokens, &usage,
+                                  &upstream_breaker, request_timeout](const httplib::Request &req, httplib::Response &res) {
+            auto started = std::chrono::steady_clock::now();
             try {
-                auto json = nlohmann::json::parse(req.body);
-                std::string message = json["message"];
-                std::string conversationId = json.value("conversationId", "");
-                
-                SessionHistory history;
-                if (session_cache.get(conversationId, history)) {
-                    history.messages.push_back(message);
-                } else {
-                    history.messages = {message};
+                std::string message;
+                std::string conversationId;
+                parseMessageRequest(req.body, message, conversationId);
+                std::string client = clientId(req);
+
+                // Relative milliseconds, so proxy and client clocks don't have to agree;
+                // an invalid header is ignored rather than shedding the request
+                auto budget = request_timeout;
+                std::chrono::milliseconds client_budget;
+                if (parseDeadlineMs(req.get_header_value("X-Deadline-Ms"), client_budget)) {
+                    budget = std::min(budget, client_budget);
                 }
+                auto deadline = started + budget;
 
-                std::cout << "Received message: " << message << std::endl;
-                std::cout << "Conversation ID: " << conversationId << std::endl;
+                auto lookup = cache_tier.prepare(message, conversationId);
+                int input_tokens = lookup.inputTokens;
+                LOG_INFO("event=message conversation=%s bytes=%zu tokens=%d",
+                         conversationId.c_str(), message.size(), input_tokens);
+                LOG_DEBUG("event=message_text conversation=%s text=%.120s",
+                          conversationId.c_str(), message.c_str());
 
-                int input_tokens = calculateTokens(message);
-                std::cout << "Input tokens: " << input_tokens << std::endl;
+                int cache_token_limit = max_cache_tokens.load(std::memory_order_relaxed);
+                bool cacheable = lookup.cacheable;
+                const std::string& cache_key = lookup.key;
+                // In peer mode keys owned elsewhere only live in the hot cache, and only
+                // while fresh: the owner takes care of revalidation
+                bool remote = cacheable && !peer_group.isLocal(cache_key);
+                // Local keys come back shared (and, with --l1-entries, from this thread's L1)
+                std::shared_ptr<const CachedResponse> cached_response;
+                bool have_cached = false;
+                if (cacheable && remote) {
+                    CachedResponse hot;
+                    have_cached = peer_hot_cache.get(cache_key, hot);
+                    if (have_cached) {
+                        cached_response = std::make_shared<const CachedResponse>(std::move(hot));
+                    }
+                } else if (cacheable) {
+                    have_cached = response_cache_.getShared(cache_key, cached_response);
+                }
+                if (have_cached) {
+                    auto state = freshness.classify(cached_response->storedAt, started);
+                    if (state == FreshnessPolicy::State::Fresh || (state == FreshnessPolicy::State::Stale && !remote)) {
+                        bool stale = state == FreshnessPolicy::State::Stale;
+                        if (stale) {
+                            // Serve now, revalidate in the background (at most once per key)
+                            cache_stats.stale_hits++;
+                            bool scheduled = refresher.schedule(cache_key, cache_tier.upstreamBody(message, conversationId));
+                            LOG_INFO("event=cache_stale conversation=%s refresh=%d", conversationId.c_str(), scheduled);
+                        } else {
+                            LOG_INFO("event=cache_hit conversation=%s", conversationId.c_str());
+                        }
+                        cache_stats.hits++;
 
-                CachedResponse cached_response;
-                if (input_tokens <= MAX_CACHE_TOKEN && response_cache_.get(message, cached_response)) {
-                    cache_stats.hits++;
-                    std::cout << "[Cache Hit] Retrieved from cache" << std::endl;
-                    
-                    nlohmann::json response;
-                    response["conversationId"] = conversationId;
-                    response["content"] = cached_response.content;
-                    response["role"] = cached_response.role;
-                    
-                    res.set_content(response.dump(), "application/json");
-                    std::cout << "Response sent from cache" << std::endl;
-                    
-                    printCacheStats();
+                        std::string body;
+                        renderCachedResponse(*cached_response, conversationId, body);
+                        res.set_content(std::move(body), "application/json");
 
-                    history.lastResponse = cached_response.content;
-                    session_cache.put(conversationId, history);
-                    return;
+                        printCacheStats();
+
+                        usage.recordAvoided(conversationId, client, cached_response->usage);
+                        session_store.appendExchange(conversationId, message, cached_response->content);
+                        (stale ? message_latency.staleHit : message_latency.cacheHit).record(std::chrono::steady_clock::now() - started);
+                        return;
+                    }
                 }
 
                 cache_stats.misses++;
-                std::cout << "[Cache Miss] Forwarding to main server" << std::endl;
+                LOG_INFO("event=cache_miss conversation=%s expired=%d", conversationId.c_str(), have_cached);
+
+                // Expired entries are kept around to answer when the upstream fails
+                const CachedResponse* expired = have_cached ? cached_response.get() : nullptr;
+
+                // Whoever ends up calling the upstream (this thread, the owning peer)
+                // forwards the conversation, not just the last message
+                std::string upstream_body = cache_tier.upstreamBody(message, conversationId);
+                // Prompts too long to cache have no cache key; their failures are
+                // remembered per body so one bad prompt doesn't fail fast all the others
+                std::string failure_key = cacheable ? cache_key : buildBodyKey(upstream_body);
+
+                if (remote) {
+                    auto peer_started = std::chrono::steady_clock::now();
+                    PeerReply peer_reply;
+                    if (peer_group.fetch(cache_key, upstream_body, peer_reply)) {
+                        message_latency.peer.record(std::chrono::steady_clock::now() - peer_started);
+                        if (peer_reply.status == PeerReply::Status::Ok) {
+                            cache_stats.peer_hits++;
+                            LOG_INFO("event=peer_hit conversation=%s owner=%s age_ms=%u", conversationId.c_str(),
+                                     peer_group.ownerOf(cache_key).c_str(), peer_reply.ageMs);
+
+                            CachedResponse entry = makeCachedResponse(std::move(peer_reply.content), std::move(peer_reply.role));
+                            entry.storedAt -= std::chrono::milliseconds(peer_reply.ageMs);
+                            if (freshness.classify(entry.storedAt, started) == FreshnessPolicy::State::Fresh) {
+                                peer_hot_cache.put(cache_key, entry);
+                            }
+
+                            std::string body;
+                            renderCachedResponse(entry, conversationId, body);
+                            res.set_content(std::move(body), "application/json");
+                            session_store.appendExchange(conversationId, message, entry.content);
+                            return;
+                        }
+
+                        LOG_INFO("event=peer_unavailable conversation=%s owner=%s", conversationId.c_str(),
+                                 peer_group.ownerOf(cache_key).c_str());
+                        serveWithoutUpstream(res, expired, conversationId, std::chrono::milliseconds(peer_reply.retryAfterMs),
+                                             "Upstream unavailable");
+                        if (expired) {
+                            session_store.appendExchange(conversationId, message, expired->content);
+                        }
+                        return;
+                    }
+                    // Owner unreachable: fall back to calling the upstream directly
+                    LOG_WARN("event=peer_unreachable owner=%s", peer_group.ownerOf(cache_key).c_str());
+                }
+
+                std::chrono::steady_clock::duration retry_after;
+                if (negative_cache.failing(failure_key, started, retry_after)) {
+                    cache_stats.fail_fast++;
+                    LOG_INFO("event=fail_fast conversation=%s retry_after_ms=%lld", conversationId.c_str(),
+                             static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(retry_after).count()));
+                    serveWithoutUpstream(res, expired, conversationId, retry_after, "Upstream recently failed");
+                    if (expired) {
+                        session_store.appendExchange(conversationId, message, expired->content);
+                    }
+                    message_latency.failFast.record(std::chrono::steady_clock::now() - started);
+                    return;
+                }
+
+                // Wait for an upstream slot (bounded by --admission-wait-ms and the deadline) or shed the request
+                AdmissionController::Permit permit;
+                auto decision = admission.acquire(deadline, permit, retry_after);
+                auto admitted_at = std::chrono::steady_clock::now();
+                if (decision != AdmissionController::Decision::Admitted) {
+                    bool queue_full = decision == AdmissionController::Decision::QueueFull;
+                    cache_stats.shed++;
+                    LOG_WARN("event=shed conversation=%s reason=%s retry_after_ms=%lld", conversationId.c_str(),
+                             queue_full ? "queue_full" : "deadline",
+                             static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(retry_after).count()));
+                    serveWithoutUpstream(res, expired, conversationId, retry_after, "Server overloaded", queue_full ? 429 : 503);
+                    if (expired) {
+                        session_store.appendExchange(conversationId, message, expired->content);
+                    }
+                    message_latency.shed.record(admitted_at - started);
+                    return;
+                }
+                message_latency.admissionWait.record(admitted_at - started);
+
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - admitted_at);
+                if (remaining.count() <= 0) {
+                    cache_stats.deadline_exceeded++;
+                    LOG_WARN("event=deadline_exceeded conversation=%s stage=admission", conversationId.c_str());
+                    permit.release(AdmissionController::Outcome::Ignore, std::chrono::steady_clock::duration::zero());
+                    serveWithoutUpstream(res, expired, conversationId, {}, "Deadline exceeded", 504);
+                    if (expired) {
+                        session_store.appendExchange(conversationId, message, expired->content);
+                    }
+                    message_latency.upstreamError.record(admitted_at - started);
+                    return;
+                }
+
+                // Upstream failing or too slow: answer from the expired entry or 503 right away
+                if (!upstream_breaker.allow(admitted_at, retry_after)) {
+                    cache_stats.circuit_open++;
+                    LOG_INFO("event=circuit_open conversation=%s retry_after_ms=%lld", conversationId.c_str(),
+                             static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(retry_after).count()));
+                    permit.release(AdmissionController::Outcome::Ignore, std::chrono::steady_clock::duration::zero());
+                    serveWithoutUpstream(res, expired, conversationId, retry_after, "Upstream circuit open");
+                    if (expired) {
+                        session_store.appendExchange(conversationId, message, expired->content);
+                    }
+                    message_latency.failFast.record(std::chrono::steady_clock::now() - started);
+                    return;
+                }
 
                 httplib::Headers headers = {
                     {"Content-Type", "application/json"},
                     {"Connection", "keep-alive"},
-                    {"Keep-Alive", "timeout=60"}
+                    {"Keep-Alive", "timeout=60"},
+                    {"X-Client-Id", client},
+                    {"X-Deadline-Ms", std::to_string(remaining.count())}
                 };
 
-                auto main_res = main_server.Post("/api/message", headers, req.body, "application/json");
-                
-                if (main_res) {
-                    std::cout << "Main server status: " << main_res->status << std::endl;
-                    
-                    auto response_json = nlohmann::json::parse(main_res->body);
+                // The read timeout is what is left of the deadline, so neither hop keeps
+                // working for a client that has already given up
+                auto upstream_started = std::chrono::steady_clock::now();
+                httplib::Client& main_server = upstream.local();
+                main_server.set_read_timeout(remaining.count() / 1000, (remaining.count() % 1000) * 1000);
+                auto main_res = main_server.Post("/api/message", headers, upstream_body, "application/json");
+                auto upstream_elapsed = std::chrono::steady_clock::now() - upstream_started;
+                message_latency.upstream.record(upstream_elapsed);
+
+                // Running out of our own deadline says nothing about the upstream's health
+                bool out_of_time = std::chrono::steady_clock::now() >= deadline && (!main_res || main_res->status == 504);
+                if (out_of_time) {
+                    cache_stats.deadline_exceeded++;
+                    permit.release(AdmissionController::Outcome::Ignore, upstream_elapsed);
+                    LOG_WARN("event=deadline_exceeded conversation=%s stage=upstream", conversationId.c_str());
+                    serveWithoutUpstream(res, expired, conversationId, {}, "Deadline exceeded", 504);
+                    if (expired) {
+                        session_store.appendExchange(conversationId, message, expired->content);
+                    }
+                    message_latency.upstreamError.record(std::chrono::steady_clock::now() - started);
+                    return;
+                }
+                upstream_breaker.record(main_res && main_res->status < 500 && main_res->status != 429, upstream_elapsed,
+                                        std::chrono::steady_clock::now());
+
+                if (!main_res || main_res->status >= 500) {
+                    // Remember the failure so the next misses don't wait on a sick backend
+                    negative_cache.recordFailure(failure_key, std::chrono::steady_clock::now());
+                    permit.release(AdmissionController::Outcome::Dropped, upstream_elapsed);
+                } else if (main_res->status == 429) {
+                    permit.release(AdmissionController::Outcome::Dropped, upstream_elapsed);
+                } else {
+                    negative_cache.recordSuccess(failure_key);
+                    permit.release(AdmissionController::Outcome::Success, upstream_elapsed);
+                }
+
+                if (main_res && main_res->status >= 500 && expired) {
+                    LOG_WARN("event=upstream_error status=%d served=expired", main_res->status);
+                    serveWithoutUpstream(res, expired, conversationId, {}, "");
+                    session_store.appendExchange(conversationId, message, expired->content);
+                    message_latency.upstreamError.record(std::chrono::steady_clock::now() - started);
+                } else if (main_res) {
+                    LOG_INFO("event=upstream_response status=%d bytes=%zu",
+                             main_res->status, main_res->body.size());
                     
                     std::string assistant_reply;
                     std::string role;
-                    if (response_json.contains("content") && !response_json["content"].is_null()) {
-                        assistant_reply = response_json["content"];
-                        role = response_json.value("role", "assistant");
-                    } else if (response_json.contains("response") && !response_json["response"].is_null()) {
-                        assistant_reply = response_json["response"];
-                        role = "assistant";
-                    } else {
-                        assistant_reply = "(No valid content from main server)";
-                        role = "assistant";
-                    }
-                    
-                    if (input_tokens <= MAX_CACHE_TOKEN) {
-                        CachedResponse cache_entry{assistant_reply, role};
-                        response_cache_.put(message, cache_entry);
-                        std::cout << "[Cache Add] Response added to cache" << std::endl;
+                    parseUpstreamReply(main_res->body, assistant_reply, role);
+
+                    // The cache entry doubles as the serialized response
+                    CachedResponse cache_entry = makeCachedResponse(assistant_reply, role);
+                    parseUpstreamUsage(main_res->body, cache_entry.usage);
+                    usage.recordSpent(conversationId, client, cache_entry.usage);
+                    if (main_res->status < 200 || main_res->status >= 300) {
+                        LOG_DEBUG("event=cache_skip status=%d", main_res->status);
+                    } else if (remote) {
+                        peer_hot_cache.put(cache_key, cache_entry);
+                    } else if (cacheable) {
+                        response_cache_.put(cache_key, cache_entry);
+                        LOG_DEBUG("event=cache_add tokens=%d", input_tokens);
                     } else {
-                        std::cout << "[Cache Skip] Input tokens exceed limit" << std::endl;
+                        LOG_DEBUG("event=cache_skip tokens=%d limit=%d", input_tokens, cache_token_limit);
                     }
                     
-                    nlohmann::json response;
-                    response["conversationId"] = conversationId;
-                    response["content"] = assistant_reply;
-                    response["role"] = role;
-                    
                     res.status = main_res->status;
                     
                     for (const auto& header : main_res->headers) {
@@ -218,23 +747,41 @@ int main() {
                         }
                     }
                     
-                    res.set_content(response.dump(), "application/json");
-                    std::cout << "Response forwarded to client" << std::endl;
+                    std::string body;
+                    renderCachedResponse(cache_entry, conversationId, body);
+                    res.set_content(std::move(body), "application/json");
                     
                     printCacheStats();
 
-                    history.lastResponse = assistant_reply;
-                    session_cache.put(conversationId, history);
+                    session_store.appendExchange(conversationId, message, assistant_reply);
+
+                    auto elapsed = std::chrono::steady_clock::now() - started;
+                    (main_res->status >= 500 ? message_latency.upstreamError : message_latency.upstreamOk).record(elapsed);
+                    message_latency.proxyOverhead.record(elapsed - upstream_elapsed);
+                } else if (expired) {
+                    LOG_WARN("event=upstream_unavailable conversation=%s served=expired", conversationId.c_str());
+                    serveWithoutUpstream(res, expired, conversationId, {}, "");
+                    session_store.appendExchange(conversationId, message, expired->content);
+                    message_latency.upstreamError.record(std::chrono::steady_clock::now() - started);
                 } else {
-                    std::cout << "No response from main server" << std::endl;
+                    LOG_WARN("event=upstream_unavailable conversation=%s", conversationId.c_str());
                     nlohmann::json error = {
                         {"error", "No response from main server"}
                     };
                     res.status = 502;
                     res.set_content(error.dump(), "application/json");
+                    message_latency.upstreamError.record(std::chrono::steady_clock::now() - started);
                 }
+            } catch (const nlohmann::json::parse_error& e) {
+                LOG_WARN("event=json_parse_error error=\"%s\"", e.what());
+                nlohmann::json error = {
+                    {"error", std::string("Error processing message: ") + e.what()}
+                };
+                res.status = 500;
+                res.set_content(error.dump(), "application/json");
+                message_latency.jsonParse.record(std::chrono::steady_clock::now() - started);
             } catch (const std::exception& e) {
-                std::cerr << "Error processing message: " << e.what() << std::endl;
+                LOG_ERROR("event=message_error error=\"%s\"", e.what());
                 nlohmann::json error = {
                     {"error", std::string("Error processing message: ") + e.what()}
                 };
@@ -243,16 +790,40 @@ int main() {
             }
         });
 
-        svr.Get("/api/session/:id", [&session_cache](const httplib::Request &req, httplib::Response &res) {
+        // 注册在 /api/session/:id 之前，否则 "list" 会被当作会话 ID 匹配
+        routes.Get("/api/session/list", [&cache_tier, &session_list_latency](const httplib::Request &req, httplib::Response &res) {
+            auto started = std::chrono::steady_clock::now();
+            uint64_t cursor = 0;
+            uint64_t limit = 50;
+            if ((req.has_param("cursor") && !parseUnsigned(req.get_param_value("cursor"), cursor)) ||
+                (req.has_param("limit") && !parseUnsigned(req.get_param_value("limit"), limit))) {
+                res.status = 400;
+                res.set_content(nlohmann::json{{"error", "cursor and limit must be non-negative integers"}}.dump(), "application/json");
+                return;
+            }
+            limit = std::max<uint64_t>(1, std::min<uint64_t>(limit, 500));
+            try {
+
+                auto response = cache_tier.sessionPage(cursor, limit);
+                res.set_content(response.dump(), "application/json");
+                session_list_latency.record(std::chrono::steady_clock::now() - started);
+            } catch (const std::exception& e) {
+                res.status = 500;
+                nlohmann::json error = {
+                    {"error", std::string("Error retrieving session list: ") + e.what()}
+                };
+                res.set_content(error.dump(), "application/json");
+            }
+        });
+
+        routes.Get("/api/session/:id", [&cache_tier, &session_latency](const httplib::Request &req, httplib::Response &res) {
+            auto started = std::chrono::steady_clock::now();
             try {
                 std::string conversationId = req.path_params.at("id");
-                SessionHistory history;
-                
-                if (session_cache.get(conversationId, history)) {
-                    nlohmann::json response;
-                    response["messages"] = history.messages;
-                    response["lastResponse"] = history.lastResponse;
+                nlohmann::json response;
+                if (cache_tier.sessionDetail(conversationId, response)) {
                     res.set_content(response.dump(), "application/json");
+                    session_latency.record(std::chrono::steady_clock::now() - started);
                 } else {
                     res.status = 404;
                     nlohmann::json error = {
@@ -269,24 +840,210 @@ int main() {
             }
         });
 
-        svr.Get("/api/session/list", [&session_cache](const httplib::Request &req, httplib::Response &res) {
+        // Upstream spend and what cache hits avoided, per conversation and client:
+        // ?top=N, ?conversation=ID, ?client=ID
+        routes.Get("/api/usage", [&usage](const httplib::Request &req, httplib::Response &res) {
+            uint64_t top = 10;
+            if (req.has_param("top") && !parseUnsigned(req.get_param_value("top"), top)) {
+                res.status = 400;
+                res.set_content(nlohmann::json{{"error", "top must be a non-negative integer"}}.dump(), "application/json");
+                return;
+            }
+            // The top-N tables are built under the shard locks, so keep N small
+            top = std::max<uint64_t>(1, std::min<uint64_t>(top, 100));
+            auto report = usage.report(top, req.get_param_value("conversation"), req.get_param_value("client"));
+            res.set_content(report.dump(), "application/json");
+        });
+
+        // Latency histograms; ?buckets=1 adds the raw buckets so snapshots can be merged
+        routes.Get("/api/metrics/latency", [&latency, &cache_tier, &admission, &upstream_breaker, &core_router](const httplib::Request &req, httplib::Response &res) {
+            bool with_buckets = req.has_param("buckets") && req.get_param_value("buckets") == "1";
+            nlohmann::json series = nlohmann::json::object();
+            for (const auto& entry : latency.snapshotAll()) {
+                series[entry.first] = latencyToJson(entry.second, with_buckets);
+            }
+
+            nlohmann::json response;
+            response["series"] = std::move(series);
+            response["cache"] = cache_tier.statsJson();
+            auto admission_stats = admission.stats();
+            response["admission"] = {
+                {"limit", admission_stats.limit},
+                {"inFlight", admission_stats.inFlight},
+                {"queued", admission_stats.queued},
+                {"minRttUs", admission_stats.minRttUs},
+                {"smoothedRttUs", admission_stats.smoothedRttUs},
+                {"admitted", admission_stats.admitted},
+                {"rejectedQueueFull", admission_stats.rejectedFull},
+                {"rejectedDeadline", admission_stats.rejectedDeadline}
+            };
+            auto breaker_stats = upstream_breaker.stats(std::chrono::steady_clock::now());
+            response["breaker"] = {
+                {"state", CircuitBreaker::stateName(breaker_stats.state)},
+                {"windowCalls", breaker_stats.calls},
+                {"windowFailures", breaker_stats.failures},
+                {"windowSlow", breaker_stats.slow},
+                {"opened", breaker_stats.opened},
+                {"rejected", breaker_stats.rejected}
+            };
+            if (core_router) {
+                // Per core: calls run locally, sent to and served for other cores, and
+                // forwards that waited for a full ring
+                nlohmann::json cores = nlohmann::json::array();
+                for (const auto& core : core_router->stats()) {
+                    cores.push_back({{"cpu", core.cpu}, {"local", core.local}, {"forwarded", core.forwarded},
+                                     {"served", core.served}, {"backlogged", core.backlogged}});
+                }
+                response["cores"] = std::move(cores);
+            }
+            response["subBucketBits"] = LatencyHistogram::kSubBucketBits;
+            res.set_content(response.dump(), "application/json");
+        });
+
+        // Runtime cache configuration, loopback only. POST any of
+        //   {"capacity": 5000, "slices": 8, "maxCacheTokens": 512, "upstream": "host:port"}
+        // Shrinking evicts a batch per cache operation and a new slice count is migrated
+        // a few entries per operation, so the cache keeps serving (and keeps its entries).
+        auto cache_config = [&response_cache_, &max_cache_tokens, &upstream]() {
+            return nlohmann::json{
+                {"capacity", response_cache_.capacity()},
+                {"slices", response_cache_.sliceCount()},
+                {"entries", response_cache_.size()},
+                {"migrating", response_cache_.migrating()},
+                {"maxCacheTokens", max_cache_tokens.load()},
+                {"upstream", upstream.address()}
+            };
+        };
+
+        routes.Get("/api/admin/cache", [&cache_config](const httplib::Request &req, httplib::Response &res) {
+            if (!isLoopback(req.remote_addr)) {
+                res.status = 403;
+                res.set_content(nlohmann::json{{"error", "Admin endpoints are loopback only"}}.dump(), "application/json");
+                return;
+            }
+            res.set_content(cache_config().dump(), "application/json");
+        });
+
+        routes.Post("/api/admin/cache", [&cache_config, &response_cache_, &max_cache_tokens, &upstream, &core_router](const httplib::Request &req, httplib::Response &res) {
+            if (!isLoopback(req.remote_addr)) {
+                res.status = 403;
+                res.set_content(nlohmann::json{{"error", "Admin endpoints are loopback only"}}.dump(), "application/json");
+                return;
+            }
             try {
-                nlohmann::json response;
-                nlohmann::json sessions = nlohmann::json::array();
-                
-                response["sessions"] = sessions;
-                res.set_content(response.dump(), "application/json");
+                auto json = nlohmann::json::parse(req.body);
+
+                // Validate everything before applying anything
+                PeerAddress upstream_address;
+                if (json.contains("upstream") && !PeerAddress::parse(json["upstream"].get<std::string>(), upstream_address)) {
+                    throw std::invalid_argument("upstream must be host:port");
+                }
+                if (json.contains("capacity") && json["capacity"].get<long long>() <= 0) {
+                    throw std::invalid_argument("capacity must be positive");
+                }
+                if (json.contains("slices") && json["slices"].get<int>() <= 0) {
+                    throw std::invalid_argument("slices must be positive");
+                }
+                if (json.contains("slices") && core_router && json["slices"].get<int>() != response_cache_.sliceCount()) {
+                    throw std::invalid_argument("slices are fixed in thread-per-core mode");
+                }
+                if (json.contains("maxCacheTokens") && json["maxCacheTokens"].get<int>() < 0) {
+                    throw std::invalid_argument("maxCacheTokens must not be negative");
+                }
+
+                if (json.contains("slices") && json["slices"].get<int>() != response_cache_.sliceCount() &&
+                    !response_cache_.reshard(json["slices"].get<int>())) {
+                    res.status = 409;
+                    res.set_content(nlohmann::json{{"error", "A reshard is still migrating"}}.dump(), "application/json");
+                    return;
+                }
+                if (json.contains("capacity")) {
+                    response_cache_.resize(json["capacity"].get<size_t>());
+                }
+                if (json.contains("maxCacheTokens")) {
+                    max_cache_tokens = json["maxCacheTokens"].get<int>();
+                }
+                if (json.contains("upstream")) {
+                    upstream.set(upstream_address.host, upstream_address.port);
+                }
+
+                auto config = cache_config();
+                LOG_INFO("event=cache_reconfigured config=%s", config.dump().c_str());
+                res.set_content(config.dump(), "application/json");
             } catch (const std::exception& e) {
-                res.status = 500;
-                nlohmann::json error = {
-                    {"error", std::string("Error retrieving session list: ") + e.what()}
-                };
-                res.set_content(error.dump(), "application/json");
+                res.status = 400;
+                res.set_content(nlohmann::json{{"error", std::string("Invalid cache config: ") + e.what()}}.dump(), "application/json");
+            }
+        });
+
+        // Checked before summary_thread exists, so failing here can return: the refresher
+        // and the core router stop their threads in their destructors
+        if (peer_group.enabled()) {
+            if (!peer_server.start()) {
+                std::cerr << "Failed to listen for peers on port " << peer_self.port << std::endl;
+                return 1;
+            }
+            std::cout << "Peer cache: " << peer_group.size() << " peers, serving as " << peer_self.str() << std::endl;
+        }
+
+        // Periodic summary: one line per series that saw traffic in the last window
+        std::atomic<bool> summary_running{true};
+        std::thread summary_thread([&latency, &summary_running]() {
+            const int WINDOW_SECONDS = 10;
+            auto previous = latency.snapshotAll();
+            while (summary_running.load()) {
+                for (int i = 0; i < WINDOW_SECONDS && summary_running.load(); ++i) {
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                }
+                auto current = latency.snapshotAll();
+                for (size_t i = 0; i < current.size() && i < previous.size(); ++i) {
+                    auto window = current[i].second.since(previous[i].second);
+                    if (window.count == 0) {
+                        continue;
+                    }
+                    LOG_INFO("event=latency_summary series=%s window_s=%d n=%llu mean_us=%.0f p50_us=%llu p99_us=%llu p999_us=%llu",
+                             current[i].first.c_str(), WINDOW_SECONDS,
+                             static_cast<unsigned long long>(window.count), window.mean(),
+                             static_cast<unsigned long long>(window.percentile(0.50)),
+                             static_cast<unsigned long long>(window.percentile(0.99)),
+                             static_cast<unsigned long long>(window.percentile(0.999)));
+                }
+                previous = std::move(current);
             }
         });
 
-        std::cout << "Proxy server running on http://0.0.0.0:8889" << std::endl;
-        svr.listen("0.0.0.0", 8889); 
+        auto setup_server = [&routes, &static_assets](httplib::Server& svr) {
+            // Set CORS headers
+            svr.set_default_headers({
+                {"Access-Control-Allow-Origin", "*"},
+                {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
+                {"Access-Control-Allow-Headers", "Content-Type"}
+            });
+            routes.mount(svr);
+            static_assets.mount(svr);
+        };
+
+        std::cout << "Proxy server running on http://0.0.0.0:" << http_port << std::endl;
+        if (core_router) {
+            CoreServers servers(core_cpus, core_workers);
+            if (!servers.listen("0.0.0.0", http_port, setup_server)) {
+                std::cerr << "Failed to listen on port " << http_port << std::endl;
+            }
+        } else {
+            httplib::Server svr;
+            setup_server(svr);
+            svr.listen("0.0.0.0", http_port);
+        }
+
+        peer_server.stop();
+        refresher.stop();
+        if (core_router) {
+            core_router->stop();
+        }
+        static_assets.stop();
+        summary_running = false;
+        summary_thread.join();
+        AsyncLogger::instance().stop();
 
     } catch (const std::exception& e) {
         std::cerr << "Proxy server initialization error: " << e.what() << std::endl;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Strict parsing for numbers that arrive in query strings and headers: digits
+// only, no sign, no trailing junk, no overflow. Anything else is rejected so the
+// handler can answer 400 (or ignore a header) instead of throwing.
+inline bool parseUnsigned(const std::string& text, uint64_t& value) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (errno == ERANGE || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// Longest budget an X-Deadline-Ms header may ask for; larger values are clamped
+const uint64_t kMaxDeadlineMs = 10 * 60 * 1000;
+
+// X-Deadline-Ms: milliseconds the caller will still wait. False for a missing,
+// malformed or zero value, which the caller treats as "no deadline" rather than
+// shedding the request; otherwise the budget, clamped to kMaxDeadlineMs.
+inline bool parseDeadlineMs(const std::string& text, std::chrono::milliseconds& budget) {
+    uint64_t ms = 0;
+    if (!parseUnsigned(text, ms) || ms == 0) {
+        return false;
+    }
+    budget = std::chrono::milliseconds(std::min(ms, kMaxDeadlineMs));
+    return true;
+}
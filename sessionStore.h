@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lruCache.h"
+#include "cacheKey.h"
+
+namespace CacheImpl
+{
+    struct SessionLimits
+    {
+        size_t maxMessages = 200;          // 超出后从最旧的消息开始丢弃
+        size_t maxBytes = 256 * 1024;
+        size_t chunkSize = 4096;
+        size_t contextTurns = 2;           // 参与缓存键上下文哈希的最近轮数（一问一答算两轮），0 表示不区分上下文
+    };
+
+    // 会话存储：消息正文写入每个会话自己的 arena 块，追加在分片锁内原地完成，
+    // 读取时返回持有块引用的只读视图，不再整体拷贝 SessionHistory。
+    class SessionStore
+    {
+        public:
+            enum class Role : uint8_t
+            {
+                User,
+                Assistant
+            };
+
+            struct Turn
+            {
+                Role role;
+                std::string_view content;
+            };
+
+            using Limits = SessionLimits;
+
+        private:
+            struct Chunk
+            {
+                explicit Chunk(size_t capacity)
+                    : data(new char[capacity])
+                    , capacity(capacity)
+                    , used(0)
+                {}
+
+                std::unique_ptr<char[]> data;
+                size_t capacity;
+                size_t used;
+            };
+
+            using ChunkPtr = std::shared_ptr<Chunk>;
+
+        public:
+            // 只读视图：持有引用到的 arena 块，会话之后被追加、裁剪或淘汰都不影响视图
+            class View
+            {
+                public:
+                    const std::vector<Turn>& turns() const { return turns_; }
+                    size_t bytes() const { return bytes_; }
+
+                    std::string_view lastResponse() const
+                    {
+                        for (auto it = turns_.rbegin(); it != turns_.rend(); ++it)
+                        {
+                            if (it->role == Role::Assistant)
+                                return it->content;
+                        }
+                        return {};
+                    }
+
+                private:
+                    friend class SessionStore;
+                    std::vector<std::shared_ptr<const Chunk>> chunks_;
+                    std::vector<Turn> turns_;
+                    size_t bytes_ = 0;
+            };
+
+            class Session
+            {
+                public:
+                    Session() = default;
+
+                    // 拷贝与原会话共享已写入的块，但不再向共享的尾块追加
+                    Session(const Session& other)
+                        : chunks_(other.chunks_)
+                        , records_(other.records_)
+                        , chunkBase_(other.chunkBase_)
+                        , bytes_(other.bytes_)
+                        , tailWritable_(false)
+                        , window_(other.window_)
+                        , context_(other.context_)
+                    {}
+
+                    Session& operator=(const Session& other)
+                    {
+                        chunks_ = other.chunks_;
+                        records_ = other.records_;
+                        chunkBase_ = other.chunkBase_;
+                        bytes_ = other.bytes_;
+                        tailWritable_ = false;
+                        window_ = other.window_;
+                        context_ = other.context_;
+                        return *this;
+                    }
+
+                    size_t messageCount() const { return records_.size(); }
+                    size_t bytes() const { return bytes_; }
+
+                    // 最近 contextTurns 轮的滚动哈希，与消息裁剪无关
+                    const Hash128& context() const { return context_.value(); }
+
+                    // 第一条消息的前 maxBytes 字节，截断在 UTF-8 字符边界上
+                    std::string preview(size_t maxBytes) const
+                    {
+                        if (records_.empty())
+                            return {};
+                        const Record& record = records_.front();
+                        const char* data = chunks_[record.chunk - chunkBase_]->data.get() + record.offset;
+                        size_t length = std::min(record.length, maxBytes);
+                        while (length > 0 && length < record.length &&
+                               (static_cast<unsigned char>(data[length]) & 0xC0) == 0x80)
+                        {
+                            --length;
+                        }
+                        return std::string(data, length);
+                    }
+
+                    void append(Role role, std::string_view content, const Limits& limits)
+                    {
+                        Chunk* chunk = chunks_.empty() ? nullptr : chunks_.back().get();
+                        if (!chunk || !tailWritable_ || chunk->capacity - chunk->used < content.size())
+                        {
+                            chunks_.push_back(std::make_shared<Chunk>(std::max(limits.chunkSize, content.size())));
+                            chunk = chunks_.back().get();
+                            tailWritable_ = true;
+                        }
+
+                        if (!content.empty())
+                            std::memcpy(chunk->data.get() + chunk->used, content.data(), content.size());
+                        records_.push_back(Record{chunkBase_ + chunks_.size() - 1, chunk->used,
+                                                  content.size(), role});
+                        chunk->used += content.size();
+                        bytes_ += content.size();
+
+                        Hash128 digest = hash128(content, static_cast<uint64_t>(role) + 1);
+                        context_.push(digest);
+                        window_.push_back(digest);
+                        if (window_.size() > limits.contextTurns)
+                        {
+                            context_.drop(window_.front(), limits.contextTurns);
+                            window_.pop_front();
+                        }
+
+                        trim(limits);
+                    }
+
+                    void fill(View& view) const
+                    {
+                        view.chunks_.assign(chunks_.begin(), chunks_.end());
+                        view.turns_.clear();
+                        view.turns_.reserve(records_.size());
+                        for (const auto& record : records_)
+                        {
+                            const Chunk& chunk = *chunks_[record.chunk - chunkBase_];
+                            view.turns_.push_back(Turn{record.role,
+                                std::string_view(chunk.data.get() + record.offset, record.length)});
+                        }
+                        view.bytes_ = bytes_;
+                    }
+
+                private:
+                    struct Record
+                    {
+                        size_t chunk;       // 块的绝对序号，减去 chunkBase_ 得到下标
+                        size_t offset;
+                        size_t length;
+                        Role role;
+                    };
+
+                    // 按条数和字节数裁剪，至少保留最新一条
+                    void trim(const Limits& limits)
+                    {
+                        while (records_.size() > 1 &&
+                               (records_.size() > limits.maxMessages || bytes_ > limits.maxBytes))
+                        {
+                            bytes_ -= records_.front().length;
+                            records_.pop_front();
+                        }
+
+                        // 释放不再被任何记录引用的旧块
+                        while (!records_.empty() && chunkBase_ < records_.front().chunk)
+                        {
+                            chunks_.pop_front();
+                            ++chunkBase_;
+                        }
+                    }
+
+                    std::deque<ChunkPtr> chunks_;
+                    std::deque<Record> records_;
+                    size_t chunkBase_ = 0;
+                    size_t bytes_ = 0;
+                    bool tailWritable_ = true;
+                    std::deque<Hash128> window_;    // 上下文窗口内各轮的摘要
+                    ContextHash context_;
+            };
+
+            SessionStore(size_t capacity, int sliceNum, Limits limits = Limits(), bool pooled = true)
+                : limits_(limits)
+                , sessions_(capacity, sliceNum, pooled)
+            {}
+
+            void append(const std::string& id, Role role, std::string_view content)
+            {
+                sessions_.update(id, [&](Session& session) {
+                    session.append(role, content, limits_);
+                });
+            }
+
+            // 一问一答在同一次加锁内写入，读者不会看到只有提问的中间状态
+            void appendExchange(const std::string& id, std::string_view question, std::string_view answer)
+            {
+                sessions_.update(id, [&](Session& session) {
+                    session.append(Role::User, question, limits_);
+                    session.append(Role::Assistant, answer, limits_);
+                });
+            }
+
+            bool view(const std::string& id, View& out)
+            {
+                return sessions_.visit(id, [&out](const Session& session) {
+                    session.fill(out);
+                });
+            }
+
+            // 会话当前的上下文哈希；会话不存在时为全零
+            Hash128 context(const std::string& id)
+            {
+                Hash128 result;
+                sessions_.visit(id, [&result](const Session& session) {
+                    result = session.context();
+                });
+                return result;
+            }
+
+            void remove(const std::string& id)
+            {
+                sessions_.remove(id);
+            }
+
+            struct Summary
+            {
+                std::string id;
+                size_t messageCount;
+                size_t bytes;
+                uint64_t idleMs;
+                std::string preview;
+            };
+
+            // 按最近活跃顺序分页列出会话；cursor 为 0 表示第一页，返回的 nextCursor 为 0 表示结束
+            std::vector<Summary> list(uint64_t cursor, size_t limit, uint64_t& nextCursor)
+            {
+                struct Item
+                {
+                    size_t messageCount;
+                    size_t bytes;
+                    std::string preview;
+                };
+
+                auto entries = sessions_.template page<Item>(cursor == 0 ? UINT64_MAX : cursor, limit,
+                    [](const std::string&, const Session& session) {
+                        return Item{session.messageCount(), session.bytes(), session.preview(80)};
+                    }, nextCursor);
+
+                uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+
+                std::vector<Summary> result;
+                result.reserve(entries.size());
+                for (auto& entry : entries)
+                {
+                    uint64_t idleMs = now > entry.stamp ? (now - entry.stamp) / 1000000 : 0;
+                    result.push_back(Summary{std::move(entry.key), entry.item.messageCount, entry.item.bytes,
+                                             idleMs, std::move(entry.item.preview)});
+                }
+                return result;
+            }
+
+            size_t size()
+            {
+                return sessions_.size();
+            }
+
+            // 会话节点所在分片内存池的占用；消息内容在 Session 自己的 chunk 里，不计入
+            SlicePool::Stats memoryStats()
+            {
+                return sessions_.memoryStats();
+            }
+
+            const Limits& limits() const { return limits_; }
+
+        private:
+            Limits limits_;
+            HashLruCache<std::string, Session> sessions_;
+    };
+}
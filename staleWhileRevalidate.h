@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#include "lruCache.h"
+
+// Age windows for cached upstream responses:
+//   [0, fresh)              served as is
+//   [fresh, fresh + stale)  served immediately while a background refresh runs
+//   beyond that             expired, only used if the upstream call fails
+// Upstream failures are remembered for `negative` so repeated misses fail fast.
+struct FreshnessPolicy {
+    using Clock = std::chrono::steady_clock;
+
+    enum class State {
+        Fresh,
+        Stale,
+        Expired
+    };
+
+    std::chrono::milliseconds fresh{std::chrono::minutes(5)};
+    std::chrono::milliseconds stale{std::chrono::hours(1)};
+    std::chrono::milliseconds negative{std::chrono::seconds(5)};
+    int failFastAfter = 3;              // consecutive upstream failures before all misses fail fast
+
+    State classify(Clock::time_point storedAt, Clock::time_point now) const {
+        auto age = now - storedAt;
+        if (age < fresh) {
+            return State::Fresh;
+        }
+        if (age < fresh + stale) {
+            return State::Stale;
+        }
+        return State::Expired;
+    }
+};
+
+// Single background worker that revalidates stale keys. A key is queued at most
+// once at a time, and the queue is bounded so a burst of stale hits can't turn
+// into a burst of upstream calls.
+class CacheRefresher {
+public:
+    // key identifies the cache entry, message is what to send upstream
+    using RefreshFn = std::function<void(const std::string& key, const std::string& message)>;
+
+    CacheRefresher(size_t maxQueued, RefreshFn refresh)
+        : maxQueued_(maxQueued)
+        , refresh_(std::move(refresh))
+        , running_(true)
+        , worker_(&CacheRefresher::run, this)
+    {}
+
+    ~CacheRefresher() {
+        stop();
+    }
+
+    // False if the key is already queued or running, or the queue is full
+    bool schedule(const std::string& key, const std::string& message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_ || queue_.size() >= maxQueued_ || !inFlight_.insert(key).second) {
+                return false;
+            }
+            queue_.emplace_back(key, message);
+        }
+        cond_.notify_one();
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+        cond_.notify_one();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::pair<std::string, std::string> item;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+                if (!running_) {
+                    return;
+                }
+                item = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            try {
+                refresh_(item.first, item.second);
+            } catch (...) {
+                // A failed refresh leaves the stale entry in place
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            inFlight_.erase(item.first);
+        }
+    }
+
+    size_t maxQueued_;
+    RefreshFn refresh_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::pair<std::string, std::string>> queue_;
+    std::unordered_set<std::string> inFlight_;
+    bool running_;
+    std::thread worker_;
+};
+
+// Remembers recent upstream failures, per key (bounded LRU) and for the backend as
+// a whole once failures are consecutive, so misses can fail fast for a short while.
+class NegativeCache {
+public:
+    using Clock = FreshnessPolicy::Clock;
+
+    NegativeCache(size_t capacity, const FreshnessPolicy& policy)
+        : policy_(policy)
+        , keys_(static_cast<int>(capacity))
+        , consecutiveFailures_(0)
+        , backendFailingUntil_(0)
+    {}
+
+    // True if key (or the whole backend) failed recently; retryAfter is the time left
+    bool failing(const std::string& key, Clock::time_point now, Clock::duration& retryAfter) {
+        Clock::rep backendUntil = backendFailingUntil_.load(std::memory_order_relaxed);
+        if (now.time_since_epoch().count() < backendUntil) {
+            retryAfter = Clock::duration(backendUntil) - now.time_since_epoch();
+            return true;
+        }
+
+        Clock::time_point until;
+        if (keys_.get(key, until) && now < until) {
+            retryAfter = until - now;
+            return true;
+        }
+        return false;
+    }
+
+    void recordFailure(const std::string& key, Clock::time_point now) {
+        Clock::time_point until = now + policy_.negative;
+        keys_.put(key, until);
+
+        if (consecutiveFailures_.fetch_add(1, std::memory_order_relaxed) + 1 >= policy_.failFastAfter) {
+            backendFailingUntil_.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+        }
+    }
+
+    void recordSuccess(const std::string& key) {
+        consecutiveFailures_.store(0, std::memory_order_relaxed);
+        keys_.remove(key);
+    }
+
+private:
+    const FreshnessPolicy& policy_;
+    CacheImpl::LruCache<std::string, Clock::time_point> keys_;
+    std::atomic<int> consecutiveFailures_;
+    std::atomic<Clock::rep> backendFailingUntil_;
+};
@@ -0,0 +1,351 @@
+#include "staticAssets.h"
+
+#include <httplib.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asyncLogger.h"
+#include "cacheKey.h"
+
+// One file, copied into memory at load. A streamed response holds the asset
+// until it is done, so a reload can't free the body under it.
+struct StaticAssets::Asset {
+    std::string contentType;
+    std::string etag;
+    std::string gzipEtag;
+    std::string identity;
+    std::string gzip;
+    bool streamed = false;
+
+    const char* data() const { return identity.data(); }
+    size_t size() const { return identity.size(); }
+};
+
+namespace {
+
+const char* contentTypeFor(const std::string& extension) {
+    static const std::unordered_map<std::string, const char*> types = {
+        {".html", "text/html; charset=utf-8"},
+        {".htm", "text/html; charset=utf-8"},
+        {".js", "application/javascript; charset=utf-8"},
+        {".mjs", "application/javascript; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".json", "application/json"},
+        {".map", "application/json"},
+        {".svg", "image/svg+xml"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".xml", "application/xml"},
+        {".wasm", "application/wasm"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".webp", "image/webp"},
+        {".ico", "image/x-icon"},
+        {".woff2", "font/woff2"}
+    };
+    auto it = types.find(extension);
+    return it == types.end() ? "application/octet-stream" : it->second;
+}
+
+// Images, fonts and wasm are already compressed or rarely shrink enough to matter
+bool compressible(const std::string& contentType) {
+    return contentType.compare(0, 5, "text/") == 0 || contentType.find("javascript") != std::string::npos ||
+           contentType.find("json") != std::string::npos || contentType.find("xml") != std::string::npos;
+}
+
+bool gzipCompress(const char* data, size_t size, int level, std::string& out) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // 15 window bits + 16 selects the gzip wrapper
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, size));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+std::string strongEtag(const char* data, size_t size, const char* suffix) {
+    static const char* hex = "0123456789abcdef";
+    Hash128 digest = hash128(std::string_view(data, size));
+    std::string etag = "\"";
+    for (uint64_t lane : {digest.hi, digest.lo}) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            etag.push_back(hex[(lane >> shift) & 0xF]);
+        }
+    }
+    etag += suffix;
+    etag.push_back('"');
+    return etag;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// If-None-Match: "*" or a list of (possibly weak) tags; weak comparison applies
+bool etagMatches(const std::string& header, const std::string& etag, const std::string& gzipEtag) {
+    std::string_view rest(header);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view tag = trim(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        if (tag.size() > 2 && tag.compare(0, 2, "W/") == 0) {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag || (!gzipEtag.empty() && tag == gzipEtag)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// True unless Accept-Encoding lists neither gzip nor "*", or gives the match q=0
+bool acceptsGzip(const std::string& header) {
+    bool star = false;
+    bool gzip = false;
+    bool gzipRefused = false;
+    std::string_view rest(header);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view item = trim(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+
+        size_t semicolon = item.find(';');
+        std::string_view coding = trim(item.substr(0, semicolon));
+        bool refused = false;
+        if (semicolon != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semicolon + 1));
+            if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                refused = std::strtod(std::string(param.substr(2)).c_str(), nullptr) <= 0.0;
+            }
+        }
+        if (coding.size() == 4 && strncasecmp(coding.data(), "gzip", 4) == 0) {
+            gzip = !refused;
+            gzipRefused = refused;
+        } else if (coding == "*") {
+            star = !refused;
+        }
+    }
+    return gzip || (star && !gzipRefused);
+}
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+}
+
+StaticAssets::StaticAssets(std::string root, const StaticAssetOptions& options)
+    : root_(std::move(root))
+    , options_(options)
+    , assets_(std::make_shared<AssetMap>())
+    , stats_{0, 0, 0, 0}
+    , watching_(false)
+{}
+
+StaticAssets::~StaticAssets() {
+    stop();
+}
+
+StaticAssets::Stats StaticAssets::load() {
+    namespace fs = std::filesystem;
+    auto assets = std::make_shared<AssetMap>();
+    Stats stats{0, 0, 0, 0};
+
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(root_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) {
+            continue;
+        }
+        std::string path = it->path().string();
+        std::string url = "/" + it->path().lexically_relative(root_).generic_string();
+
+        auto asset = std::make_shared<Asset>();
+        asset->contentType = contentTypeFor(it->path().extension().string());
+        if (!readFile(path, asset->identity)) {
+            LOG_WARN("event=static_skip path=%s error=\"%s\"", path.c_str(), std::strerror(errno));
+            continue;
+        }
+        if (asset->size() >= options_.streamThreshold) {
+            asset->streamed = true;
+            ++stats.streamed;
+        }
+
+        asset->etag = strongEtag(asset->data(), asset->size(), "");
+        if (asset->size() >= options_.minCompressSize && compressible(asset->contentType)) {
+            std::string gzip;
+            // Keep the variant only if it saves at least a tenth
+            if (gzipCompress(asset->data(), asset->size(), options_.compressionLevel, gzip) &&
+                gzip.size() < asset->size() - asset->size() / 10) {
+                asset->gzip = std::move(gzip);
+                asset->gzipEtag = strongEtag(asset->data(), asset->size(), "-gz");
+            }
+        }
+
+        ++stats.files;
+        stats.bytes += asset->size();
+        stats.gzipBytes += asset->gzip.size();
+        (*assets)[url] = asset;
+        if (it->path().filename() == "index.html") {
+            std::string directory = url.substr(0, url.size() - std::strlen("index.html"));
+            (*assets)[directory] = asset;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assets_ = std::move(assets);
+        stats_ = stats;
+    }
+    LOG_INFO("event=static_loaded root=%s files=%zu bytes=%zu gzip_bytes=%zu streamed=%zu",
+             root_.c_str(), stats.files, stats.bytes, stats.gzipBytes, stats.streamed);
+    return stats;
+}
+
+std::shared_ptr<const StaticAssets::AssetMap> StaticAssets::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return assets_;
+}
+
+std::shared_ptr<const StaticAssets::Asset> StaticAssets::find(const std::string& path) const {
+    auto assets = snapshot();
+    auto it = assets->find(path);
+    return it == assets->end() ? nullptr : it->second;
+}
+
+StaticAssets::Stats StaticAssets::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool StaticAssets::serve(const httplib::Request& req, httplib::Response& res) const {
+    auto asset = find(req.path);
+    if (!asset) {
+        return false;
+    }
+
+    bool gzip = !asset->gzip.empty() && acceptsGzip(req.get_header_value("Accept-Encoding"));
+    res.set_header("Cache-Control", "no-cache");
+    res.set_header("ETag", gzip ? asset->gzipEtag : asset->etag);
+    if (!asset->gzip.empty()) {
+        res.set_header("Vary", "Accept-Encoding");
+    }
+
+    if (req.has_header("If-None-Match") && etagMatches(req.get_header_value("If-None-Match"), asset->etag, asset->gzipEtag)) {
+        res.status = 304;
+        return true;
+    }
+
+    if (gzip) {
+        res.set_header("Content-Encoding", "gzip");
+        res.set_content(asset->gzip.data(), asset->gzip.size(), asset->contentType);
+    } else if (asset->streamed) {
+        // Written straight from the loaded copy; the provider keeps the asset alive
+        // even if a reload replaces it meanwhile
+        res.set_content_provider(asset->size(), asset->contentType,
+                                 [asset](size_t offset, size_t length, httplib::DataSink& sink) {
+                                     const size_t kChunk = 256 * 1024;
+                                     return sink.write(asset->data() + offset, std::min(length, kChunk));
+                                 });
+    } else {
+        res.set_content(asset->identity.data(), asset->identity.size(), asset->contentType);
+    }
+    return true;
+}
+
+void StaticAssets::mount(httplib::Server& svr) {
+    svr.Get(R"(/.*)", [this](const httplib::Request& req, httplib::Response& res) {
+        if (!serve(req, res)) {
+            res.status = 404;
+            res.set_content("Not Found", "text/plain");
+        }
+    });
+}
+
+bool StaticAssets::watch() {
+    if (watching_.load()) {
+        return true;
+    }
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    watching_ = true;
+    watchThread_ = std::thread(&StaticAssets::watchLoop, this, fd);
+    return true;
+}
+
+void StaticAssets::stop() {
+    if (watching_.exchange(false) && watchThread_.joinable()) {
+        watchThread_.join();
+    }
+}
+
+void StaticAssets::watchLoop(int fd) {
+    namespace fs = std::filesystem;
+    const uint32_t kEvents = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+    // inotify is not recursive: watch every directory, again after each reload
+    // since new directories may have appeared
+    auto addWatches = [this, fd, kEvents]() {
+        std::error_code ec;
+        ::inotify_add_watch(fd, root_.c_str(), kEvents);
+        for (fs::recursive_directory_iterator it(root_, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                ::inotify_add_watch(fd, it->path().c_str(), kEvents);
+            }
+        }
+    };
+    addWatches();
+
+    alignas(inotify_event) char buffer[4096];
+    pollfd pfd{fd, POLLIN, 0};
+    while (watching_.load()) {
+        if (::poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+        // Editors write files in several steps; wait until the directory is quiet
+        bool changed = false;
+        do {
+            while (::read(fd, buffer, sizeof(buffer)) > 0) {
+                changed = true;
+            }
+        } while (watching_.load() && ::poll(&pfd, 1, 100) > 0);
+
+        if (changed && watching_.load()) {
+            addWatches();
+            load();
+        }
+    }
+    ::close(fd);
+}
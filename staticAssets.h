@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace httplib {
+struct Request;
+struct Response;
+class Server;
+}
+
+struct StaticAssetOptions {
+    size_t streamThreshold = 256 * 1024;    // bodies at least this large are streamed, not copied per response
+    size_t minCompressSize = 512;           // smaller files are not worth a gzip variant
+    int compressionLevel = 9;               // done once per load, so spend the CPU
+};
+
+// Static files held in memory for the web UI.
+//
+// load() reads everything under the root once, keeps a gzip variant of text
+// assets that actually shrink, and gives each representation a strong ETag
+// (content hash). Requests are answered from memory: If-None-Match gets a 304,
+// Accept-Encoding picks the gzip body. Every file is copied into memory, never
+// mapped, so rewriting or truncating it on disk can't fault a response or make a
+// body disagree with its ETag; large bodies are streamed from that copy instead
+// of being copied again per response. watch() reloads the set when inotify
+// reports a change; requests in flight keep the old files alive until they finish.
+class StaticAssets {
+public:
+    struct Stats {
+        size_t files;
+        size_t bytes;           // identity bodies
+        size_t gzipBytes;       // gzip variants
+        size_t streamed;        // files at or above streamThreshold
+    };
+
+    explicit StaticAssets(std::string root, const StaticAssetOptions& options = StaticAssetOptions());
+    ~StaticAssets();
+
+    StaticAssets(const StaticAssets&) = delete;
+    StaticAssets& operator=(const StaticAssets&) = delete;
+
+    // (Re)read the root directory; the new set replaces the old one atomically
+    Stats load();
+
+    // Answer a GET/HEAD for path; false if there is no such asset
+    bool serve(const httplib::Request& req, httplib::Response& res) const;
+
+    // Register a catch-all GET on svr. Routes are matched in registration order, so
+    // call this after the API handlers.
+    void mount(httplib::Server& svr);
+
+    // Reload on changes under the root (inotify); false if the watch can't be set up
+    bool watch();
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Asset;
+    using AssetMap = std::unordered_map<std::string, std::shared_ptr<const Asset>>;
+
+    std::shared_ptr<const AssetMap> snapshot() const;
+    std::shared_ptr<const Asset> find(const std::string& path) const;
+    void watchLoop(int fd);
+
+    std::string root_;
+    StaticAssetOptions options_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const AssetMap> assets_;
+    Stats stats_;
+    std::atomic<bool> watching_;
+    std::thread watchThread_;
+};
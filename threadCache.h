@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace CacheImpl
+{
+    // 每线程一份的小型 L1 缓存（2 路组相联），放在分片缓存前面，热点 key 命中时
+    // 不加锁也不拷贝值：条目持有不可变值的 shared_ptr。
+    //
+    // 失效靠纪元（epoch）：key 按哈希落到 kStripes 个纪元计数器之一，写入或删除时
+    // 该计数器加一，L1 条目记录填充时读到的纪元，不相等即视为失效。填充方必须在
+    // 查下层缓存之前调用 epochOf 取纪元，写入方在写完下层之后调用 invalidate，这样
+    // 与写入并发读到的旧值必然带着旧纪元。纪元按 key 哈希分条，一次写入只让同一条上
+    // 的 L1 条目失效，而不是清空所有线程的 L1。
+    //
+    // 线程表以实例编号为下标存放在 thread_local 数组里；实例销毁后，各线程里的旧表
+    // 要到线程退出时才释放。
+    template <typename Key, typename Value>
+    class ThreadCache
+    {
+        public:
+            using ValuePtr = std::shared_ptr<const Value>;
+
+            struct Stats
+            {
+                uint64_t hits;
+                uint64_t misses;
+            };
+
+            ThreadCache()
+                : id_(nextId()->fetch_add(1, std::memory_order_relaxed))
+                , entries_(0)
+                , hits_(0)
+                , misses_(0)
+            {
+                for (auto& epoch : epochs_)
+                    epoch.store(1, std::memory_order_relaxed);
+            }
+
+            ThreadCache(const ThreadCache&) = delete;
+            ThreadCache& operator=(const ThreadCache&) = delete;
+
+            // 每线程条目数（向上取 2 的幂），0 表示关闭；运行时修改后各线程下次访问时重建
+            void setEntries(size_t entries)
+            {
+                entries_.store(entries, std::memory_order_relaxed);
+            }
+
+            bool enabled() const
+            {
+                return entries_.load(std::memory_order_relaxed) > 0;
+            }
+
+            uint64_t epochOf(const Key& key) const
+            {
+                return epochs_[stripeOf(std::hash<Key>()(key))].load(std::memory_order_acquire);
+            }
+
+            void invalidate(const Key& key)
+            {
+                epochs_[stripeOf(std::hash<Key>()(key))].fetch_add(1, std::memory_order_release);
+            }
+
+            void invalidateAll()
+            {
+                for (auto& epoch : epochs_)
+                    epoch.fetch_add(1, std::memory_order_release);
+            }
+
+            // 命中时返回值；每 kTouchEvery 次命中有一次按未命中返回，让下层缓存的访问频次
+            // 跟得上，最热的 key 才不会在下层被当成冷数据淘汰
+            bool get(const Key& key, ValuePtr& value)
+            {
+                Table* table = localTable();
+                if (!table)
+                    return false;
+
+                size_t hash = std::hash<Key>()(key);
+                uint64_t epoch = epochs_[stripeOf(hash)].load(std::memory_order_acquire);
+                Set& set = table->sets[hash & table->mask];
+                for (int way = 0; way < 2; ++way)
+                {
+                    Entry& entry = set.ways[way];
+                    if (entry.value && entry.hash == hash && entry.epoch == epoch && entry.key == key)
+                    {
+                        set.recent = way;
+                        if (++entry.hits % kTouchEvery == 0)
+                            break;
+                        value = entry.value;
+                        count(*table, true);
+                        return true;
+                    }
+                }
+                count(*table, false);
+                return false;
+            }
+
+            // 放入下层缓存命中的值；epoch 是查下层之前 epochOf 的返回值
+            void fill(const Key& key, uint64_t epoch, ValuePtr value)
+            {
+                Table* table = localTable();
+                if (!table)
+                    return;
+
+                size_t hash = std::hash<Key>()(key);
+                Set& set = table->sets[hash & table->mask];
+                int victim = 1 - set.recent;
+                for (int way = 0; way < 2; ++way)
+                {
+                    if (set.ways[way].value && set.ways[way].hash == hash && set.ways[way].key == key)
+                    {
+                        victim = way;
+                        break;
+                    }
+                }
+                Entry& entry = set.ways[victim];
+                entry.hash = hash;
+                entry.epoch = epoch;
+                entry.key = key;
+                entry.value = std::move(value);
+                entry.hits = 0;
+                set.recent = victim;
+            }
+
+            // 各线程每 kFlushEvery 次访问汇总一次，数字略有滞后
+            Stats stats() const
+            {
+                return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed)};
+            }
+
+        private:
+            static constexpr size_t kStripes = 64;
+            static constexpr uint32_t kTouchEvery = 32;
+            static constexpr uint32_t kFlushEvery = 256;
+
+            struct Entry
+            {
+                size_t hash = 0;
+                uint64_t epoch = 0;
+                uint32_t hits = 0;
+                Key key{};
+                ValuePtr value;
+            };
+
+            struct Set
+            {
+                Entry ways[2];
+                int recent = 0;         // 最近命中的路，替换另一路
+            };
+
+            struct Table
+            {
+                size_t entries = 0;
+                size_t mask = 0;
+                std::vector<Set> sets;
+                uint32_t hits = 0;      // 未汇总的计数
+                uint32_t misses = 0;
+            };
+
+            static std::atomic<size_t>* nextId()
+            {
+                static std::atomic<size_t> id{0};
+                return &id;
+            }
+
+            static size_t stripeOf(size_t hash)
+            {
+                // 组下标用低位，纪元分条用高位，两者互不相关
+                return (hash >> 20) % kStripes;
+            }
+
+            Table* localTable()
+            {
+                size_t entries = entries_.load(std::memory_order_relaxed);
+                if (entries == 0)
+                    return nullptr;
+
+                thread_local std::vector<std::unique_ptr<Table>> tables;
+                if (tables.size() <= id_)
+                    tables.resize(id_ + 1);
+                std::unique_ptr<Table>& table = tables[id_];
+                if (!table || table->entries != entries)
+                {
+                    size_t sets = 1;
+                    while (sets * 2 < entries)
+                        sets <<= 1;
+                    table.reset(new Table());
+                    table->entries = entries;
+                    table->mask = sets - 1;
+                    table->sets.resize(sets);
+                }
+                return table.get();
+            }
+
+            void count(Table& table, bool hit)
+            {
+                ++(hit ? table.hits : table.misses);
+                if (table.hits + table.misses >= kFlushEvery)
+                {
+                    hits_.fetch_add(table.hits, std::memory_order_relaxed);
+                    misses_.fetch_add(table.misses, std::memory_order_relaxed);
+                    table.hits = 0;
+                    table.misses = 0;
+                }
+            }
+
+        private:
+            const size_t id_;
+            std::atomic<size_t> entries_;
+            std::atomic<uint64_t> epochs_[kStripes];
+            std::atomic<uint64_t> hits_;
+            std::atomic<uint64_t> misses_;
+    };
+}
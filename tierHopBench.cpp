@@ -0,0 +1,136 @@
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "cmdLine.h"
+#include "latencyHistogram.h"
+#include "jsonScanner.h"
+
+// One hop vs two hops for the same cache.
+//
+//   http_server --backend=mock --mock-latency=fixed:0 --port=8888 &                  # behind the proxy
+//   proxy_server --upstream-host=127.0.0.1 --upstream-port=8888 --port=8889 &
+//   http_server --backend=mock --mock-latency=fixed:0 --port=8890 --cache-tier &     # in-process tier
+//   tier_hop_bench --two-hop=127.0.0.1:8889 --one-hop=127.0.0.1:8890 --distinct=500 --repeats=10
+//
+// Each target gets --distinct new messages (misses), then the same messages
+// --repeats times (hits), one request at a time over a kept-alive connection.
+// Every request starts a new conversation so the context part of the key is
+// the same on each repeat. With a zero-latency mock the miss numbers are the
+// cost of the hops themselves.
+
+using Clock = std::chrono::steady_clock;
+
+struct HopResult {
+    LatencyHistogram miss;
+    LatencyHistogram hit;
+    size_t errors = 0;
+};
+
+bool splitAddress(const std::string& address, std::string& host, int& port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    port = std::atoi(address.c_str() + colon + 1);
+    return port > 0;
+}
+
+void runTarget(const std::string& name, const std::string& address, size_t distinct, size_t repeats,
+               uint64_t nonce, HopResult& result) {
+    std::string host;
+    int port;
+    if (!splitAddress(address, host, port)) {
+        std::cerr << "Bad address for " << name << ": " << address << "\n";
+        return;
+    }
+    httplib::Client client(host, port);
+    client.set_keep_alive(true);
+    client.set_read_timeout(60);
+
+    std::vector<std::string> messages;
+    messages.reserve(distinct);
+    for (size_t i = 0; i < distinct; ++i) {
+        messages.push_back("hop bench question " + std::to_string(nonce) + " #" + std::to_string(i));
+    }
+
+    uint64_t conversation = 0;
+    auto send = [&](const std::string& message, LatencyHistogram& histogram) {
+        std::string body = "{\"message\":\"";
+        JsonScanner::appendEscaped(body, message);
+        body += "\",\"conversationId\":\"" + name + "-" + std::to_string(nonce) + "-" + std::to_string(conversation++) + "\"}";
+        auto started = Clock::now();
+        auto res = client.Post("/api/message", body, "application/json");
+        if (!res || res->status != 200) {
+            ++result.errors;
+            return;
+        }
+        histogram.record(Clock::now() - started);
+    };
+
+    for (const auto& message : messages) {
+        send(message, result.miss);
+    }
+    for (size_t round = 0; round < repeats; ++round) {
+        for (const auto& message : messages) {
+            send(message, result.hit);
+        }
+    }
+}
+
+void printLatency(const std::string& name, const LatencyHistogram::Snapshot& snapshot) {
+    std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+              << " n=" << std::setw(7) << snapshot.count
+              << " p50=" << std::setw(8) << snapshot.percentile(0.50) << "us"
+              << " p90=" << std::setw(8) << snapshot.percentile(0.90) << "us"
+              << " p99=" << std::setw(8) << snapshot.percentile(0.99) << "us"
+              << " mean=" << std::setw(8) << snapshot.mean() << "us\n";
+}
+
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    std::string twoHop = args.get("two-hop", "127.0.0.1:8889");
+    std::string oneHop = args.get("one-hop", "127.0.0.1:8890");
+    size_t distinct = static_cast<size_t>(args.getInt("distinct", 500));
+    size_t repeats = static_cast<size_t>(args.getInt("repeats", 10));
+    // Fresh messages per run, so a second run doesn't start out warm
+    uint64_t nonce = std::random_device{}();
+
+    HopResult two;
+    HopResult one;
+    runTarget("two", twoHop, distinct, repeats, nonce, two);
+    runTarget("one", oneHop, distinct, repeats, nonce, one);
+
+    auto twoMiss = two.miss.snapshot();
+    auto twoHit = two.hit.snapshot();
+    auto oneMiss = one.miss.snapshot();
+    auto oneHit = one.hit.snapshot();
+    printLatency("two-hop miss", twoMiss);
+    printLatency("one-hop miss", oneMiss);
+    printLatency("two-hop hit", twoHit);
+    printLatency("one-hop hit", oneHit);
+    std::cout << "errors two-hop=" << two.errors << " one-hop=" << one.errors << "\n";
+    if (twoMiss.count > 0 && oneMiss.count > 0) {
+        std::cout << std::setprecision(1) << "extra hop on a miss: p50 "
+                  << twoMiss.percentile(0.50) - oneMiss.percentile(0.50) << "us, mean "
+                  << twoMiss.mean() - oneMiss.mean() << "us\n";
+    }
+
+    if (args.has("json")) {
+        auto series = [](const LatencyHistogram::Snapshot& s) {
+            return nlohmann::json{{"count", s.count}, {"p50_us", s.percentile(0.50)}, {"p90_us", s.percentile(0.90)},
+                                  {"p99_us", s.percentile(0.99)}, {"mean_us", s.mean()}};
+        };
+        nlohmann::json report = {
+            {"twoHop", {{"miss", series(twoMiss)}, {"hit", series(twoHit)}, {"errors", two.errors}}},
+            {"oneHop", {{"miss", series(oneMiss)}, {"hit", series(oneHit)}, {"errors", one.errors}}}
+        };
+        std::cout << report.dump(2) << "\n";
+    }
+    return two.errors + one.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,369 @@
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Per 64-byte block: bits set for ASCII word bytes and for UTF-8 lead bytes
+struct BlockMasks {
+    uint64_t word;
+    uint64_t lead;
+};
+
+inline bool isAsciiSpace(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline BlockMasks classifyScalar(const unsigned char* p, size_t n) {
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            if (!isAsciiSpace(c)) {
+                masks.word |= 1ULL << i;
+            }
+        } else if (c >= 0xC0) {
+            masks.lead |= 1ULL << i;
+        }
+    }
+    return masks;
+}
+
+#if defined(__SSE2__)
+inline BlockMasks classifySse2(const unsigned char* p) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i belowLead = _mm_set1_epi8(static_cast<char>(0xBF));
+
+    BlockMasks masks{0, 0};
+    for (int lane = 0; lane < 4; ++lane) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + lane * 16));
+
+        // '\t'..'\r' is (c - 9) <= 4 as unsigned bytes
+        __m128i shifted = _mm_sub_epi8(v, tab);
+        __m128i isCtrlSpace = _mm_cmpeq_epi8(_mm_min_epu8(shifted, four), shifted);
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(v, space), isCtrlSpace);
+
+        uint64_t nonAscii = static_cast<uint32_t>(_mm_movemask_epi8(v));
+        uint64_t spaces = static_cast<uint32_t>(_mm_movemask_epi8(isSpace));
+        // Signed compare: bytes 0xC0..0xFF are -64..-1, greater than (int8)0xBF
+        uint64_t aboveBf = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, belowLead)));
+
+        masks.word |= ((~nonAscii & ~spaces) & 0xFFFF) << (lane * 16);
+        masks.lead |= (nonAscii & aboveBf) << (lane * 16);
+    }
+    return masks;
+}
+#endif
+
+// A word of length n costs ceil(n / 4) tokens, i.e. one token at every word byte
+// whose offset inside the word is a multiple of four. Count those bytes with bit
+// tricks instead of walking the runs; `run` carries the offset of a word that
+// continues into the next block.
+inline size_t countTokenStarts(uint64_t word, size_t blockLength, size_t& run) {
+    uint64_t starts = word & ~(word << 1);
+    if (run > 0 && (word & 1)) {
+        // Bit 0 continues the carried word: its first token boundary is at
+        // offset k so that run + k is a multiple of four
+        starts &= ~1ULL;
+        size_t k = (4 - run % 4) % 4;
+        uint64_t prefix = (2ULL << k) - 1;
+        if ((word & prefix) == prefix) {
+            starts |= 1ULL << k;
+        }
+    }
+
+    // Bit i + 4 is a boundary when i is one and bytes i+1..i+4 are in the same word
+    uint64_t four = word & (word << 1) & (word << 2) & (word << 3);
+    size_t tokens = 0;
+    for (uint64_t p = starts; p != 0; p = (p << 4) & four) {
+        tokens += __builtin_popcountll(p);
+    }
+
+    // Offset of the word still open at the end of the block, if any
+    uint64_t last = 1ULL << (blockLength - 1);
+    if (!(word & last)) {
+        run = 0;
+    } else {
+        uint64_t inverted = ~word & (last | (last - 1));
+        size_t trailing = inverted == 0 ? blockLength
+                                        : blockLength - 1 - (63 - __builtin_clzll(inverted));
+        run = trailing == blockLength ? run + blockLength : trailing;
+    }
+    return tokens;
+}
+
+size_t estimateBlocks(const unsigned char* p, size_t n, bool simd) {
+    size_t tokens = 0;
+    size_t run = 0;
+    size_t offset = 0;
+
+    for (; offset + 64 <= n; offset += 64) {
+        BlockMasks masks;
+#if defined(__SSE2__)
+        masks = simd ? classifySse2(p + offset) : classifyScalar(p + offset, 64);
+#else
+        (void)simd;
+        masks = classifyScalar(p + offset, 64);
+#endif
+        tokens += __builtin_popcountll(masks.lead);
+        tokens += countTokenStarts(masks.word, 64, run);
+    }
+
+    if (offset < n) {
+        BlockMasks masks = classifyScalar(p + offset, n - offset);
+        tokens += __builtin_popcountll(masks.lead);
+        tokens += countTokenStarts(masks.word, n - offset, run);
+    }
+
+    return tokens;
+}
+
+// GPT-2 style byte-level BPE writes every byte as a printable code point
+int unicodeToByte(uint32_t cp) {
+    if ((cp >= 33 && cp <= 126) || (cp >= 161 && cp <= 172) || (cp >= 174 && cp <= 255)) {
+        return static_cast<int>(cp);
+    }
+    if (cp >= 256 && cp < 256 + 68) {
+        // The remaining 68 bytes, in ascending order, are shifted to 256..323
+        int n = static_cast<int>(cp - 256);
+        for (int b = 0; b < 256; ++b) {
+            bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255);
+            if (!printable && n-- == 0) {
+                return b;
+            }
+        }
+    }
+    return -1;
+}
+
+// Decode one byte-level token (UTF-8 of mapped code points) to raw bytes
+bool decodeToken(const std::string& token, std::string& bytes) {
+    bytes.clear();
+    size_t i = 0;
+    while (i < token.size()) {
+        unsigned char c = token[i];
+        uint32_t cp;
+        size_t len;
+        if (c < 0x80) { cp = c; len = 1; }
+        else if ((c >> 5) == 0x6) { cp = c & 0x1F; len = 2; }
+        else if ((c >> 4) == 0xE) { cp = c & 0x0F; len = 3; }
+        else { return false; }
+        if (i + len > token.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < len; ++k) {
+            cp = (cp << 6) | (static_cast<unsigned char>(token[i + k]) & 0x3F);
+        }
+        int b = unicodeToByte(cp);
+        if (b < 0) {
+            return false;
+        }
+        bytes.push_back(static_cast<char>(b));
+        i += len;
+    }
+    return !bytes.empty();
+}
+
+enum class PieceClass { Letter, Digit, Space, Other, NonAscii };
+
+inline PieceClass classOf(unsigned char c) {
+    if (c >= 0x80) return PieceClass::NonAscii;
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') return PieceClass::Letter;
+    if (c >= '0' && c <= '9') return PieceClass::Digit;
+    if (isAsciiSpace(c)) return PieceClass::Space;
+    return PieceClass::Other;
+}
+
+}
+
+size_t Tokenizer::estimate(std::string_view text) {
+    return estimateBlocks(reinterpret_cast<const unsigned char*>(text.data()), text.size(), true);
+}
+
+size_t Tokenizer::estimateScalar(std::string_view text) {
+    return estimateBlocks(reinterpret_cast<const unsigned char*>(text.data()), text.size(), false);
+}
+
+bool Tokenizer::loadMerges(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    bool isJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    try {
+        if (isJson) {
+            auto json = nlohmann::json::parse(in);
+            for (const auto& merge : json.at("model").at("merges")) {
+                // Older files use "a b", newer ones ["a", "b"]
+                if (merge.is_array() && merge.size() == 2) {
+                    pairs.emplace_back(merge[0].get<std::string>(), merge[1].get<std::string>());
+                } else if (merge.is_string()) {
+                    const std::string& s = merge.get_ref<const std::string&>();
+                    size_t space = s.find(' ');
+                    if (space != std::string::npos) {
+                        pairs.emplace_back(s.substr(0, space), s.substr(space + 1));
+                    }
+                }
+            }
+        } else {
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                size_t space = line.find(' ');
+                if (space != std::string::npos) {
+                    pairs.emplace_back(line.substr(0, space), line.substr(space + 1));
+                }
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // Intern every token as raw bytes; ids 0-255 are the single bytes
+    std::unordered_map<std::string, uint32_t> ids;
+    for (int b = 0; b < 256; ++b) {
+        ids.emplace(std::string(1, static_cast<char>(b)), static_cast<uint32_t>(b));
+    }
+    auto intern = [&ids](const std::string& bytes) {
+        auto it = ids.emplace(bytes, static_cast<uint32_t>(ids.size())).first;
+        return it->second;
+    };
+
+    std::unordered_map<uint64_t, Merge> merges;
+    merges.reserve(pairs.size());
+    std::string left, right;
+    uint32_t rank = 0;
+    for (const auto& pair : pairs) {
+        if (!decodeToken(pair.first, left) || !decodeToken(pair.second, right)) {
+            continue;
+        }
+        uint32_t leftId = intern(left);
+        uint32_t rightId = intern(right);
+        uint32_t mergedId = intern(left + right);
+        merges.emplace(pairKey(leftId, rightId), Merge{rank++, mergedId});
+    }
+
+    if (merges.empty()) {
+        return false;
+    }
+    merges_ = std::move(merges);
+    return true;
+}
+
+size_t Tokenizer::countPiece(const unsigned char* data, size_t length) const {
+    // Symbols form a linked list over the piece; candidate merges wait in a heap
+    // ordered by rank, then position, so the lowest-ranked leftmost pair is always
+    // applied first, as a rescan would. Entries whose symbols changed since they
+    // were pushed are skipped when popped. O(n log n) in the piece length.
+    struct Symbol {
+        uint32_t id;
+        int32_t prev;
+        int32_t next;
+    };
+    struct Candidate {
+        uint32_t rank;
+        int32_t left;
+        uint32_t leftId;
+        uint32_t rightId;
+        uint32_t mergedId;
+
+        bool operator>(const Candidate& other) const {
+            return rank != other.rank ? rank > other.rank : left > other.left;
+        }
+    };
+
+    thread_local std::vector<Symbol> symbols;
+    thread_local std::vector<Candidate> heap;
+    symbols.resize(length);
+    heap.clear();
+    for (size_t i = 0; i < length; ++i) {
+        symbols[i] = Symbol{data[i], static_cast<int32_t>(i) - 1, i + 1 < length ? static_cast<int32_t>(i + 1) : -1};
+    }
+
+    auto push = [this](int32_t left) {
+        if (left < 0 || symbols[left].next < 0) {
+            return;
+        }
+        uint32_t leftId = symbols[left].id;
+        uint32_t rightId = symbols[symbols[left].next].id;
+        auto it = merges_.find(pairKey(leftId, rightId));
+        if (it != merges_.end()) {
+            heap.push_back(Candidate{it->second.rank, left, leftId, rightId, it->second.id});
+            std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        }
+    };
+    for (size_t i = 0; i + 1 < length; ++i) {
+        push(static_cast<int32_t>(i));
+    }
+
+    size_t count = length;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        Candidate candidate = heap.back();
+        heap.pop_back();
+
+        Symbol& left = symbols[candidate.left];
+        if (left.id != candidate.leftId || left.next < 0 || symbols[left.next].id != candidate.rightId) {
+            continue;
+        }
+        Symbol& right = symbols[left.next];
+        left.id = candidate.mergedId;
+        left.next = right.next;
+        if (right.next >= 0) {
+            symbols[right.next].prev = candidate.left;
+        }
+        // The merged-away symbol is unlinked; give it an id no candidate carries
+        right.id = UINT32_MAX;
+        --count;
+
+        push(left.prev);
+        push(candidate.left);
+    }
+    return count;
+}
+
+size_t Tokenizer::count(std::string_view text) const {
+    if (merges_.empty()) {
+        return estimate(text);
+    }
+
+    // Simplified form of the DeepSeek pre-tokenizer: letter runs with one leading
+    // space, digit groups of up to three, whitespace runs, punctuation runs and
+    // runs of non-ASCII characters are merged independently. Other runs are cut
+    // every kMaxPieceBytes (at a code point boundary) so one long CJK paragraph
+    // or base64 blob can't become a single huge piece on the request path.
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    size_t n = text.size();
+    size_t tokens = 0;
+    size_t i = 0;
+    while (i < n) {
+        size_t start = i;
+        if (p[i] == ' ' && i + 1 < n && classOf(p[i + 1]) != PieceClass::Space) {
+            ++i;
+        }
+        PieceClass cls = classOf(p[i]);
+        size_t limit = cls == PieceClass::Digit ? 3 : kMaxPieceBytes;
+        size_t runLength = 0;
+        while (i < n && classOf(p[i]) == cls
+               && (runLength < limit || (p[i] & 0xC0) == 0x80)) {
+            ++i;
+            ++runLength;
+        }
+        tokens += countPiece(p + start, i - start);
+    }
+    return tokens;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Token counting shared by proxy_server and http_server.
+//
+// estimate() is the cheap default: runs of ASCII non-space bytes cost one token
+// per four bytes, every non-ASCII code point (CJK etc.) costs one token. It scans
+// 64 bytes per step with SSE2 and never allocates.
+//
+// When a DeepSeek tokenizer file has been loaded (HF tokenizer.json or a plain
+// merges.txt), count() runs byte-level BPE over pre-tokenized pieces instead.
+class Tokenizer {
+public:
+    Tokenizer() = default;
+
+    // Fast UTF-8 aware estimate
+    static size_t estimate(std::string_view text);
+
+    // Reference scalar implementation of estimate(), used by the benchmark
+    static size_t estimateScalar(std::string_view text);
+
+    // Load merges from tokenizer.json ("model.merges") or merges.txt ("a b" per line).
+    // Returns false and leaves the tokenizer in estimate mode on failure.
+    bool loadMerges(const std::string& path);
+
+    bool hasMerges() const { return !merges_.empty(); }
+    size_t mergeCount() const { return merges_.size(); }
+
+    // Exact BPE count when merges are loaded, estimate() otherwise
+    size_t count(std::string_view text) const;
+
+private:
+    struct Merge {
+        uint32_t rank;
+        uint32_t id;
+    };
+
+    // Longest piece handed to countPiece(); longer runs are split
+    static constexpr size_t kMaxPieceBytes = 256;
+
+    static uint64_t pairKey(uint32_t left, uint32_t right) {
+        return (static_cast<uint64_t>(left) << 32) | right;
+    }
+
+    size_t countPiece(const unsigned char* data, size_t length) const;
+
+private:
+    // (left id, right id) -> rank and id of the merged token; ids 0-255 are raw bytes
+    std::unordered_map<uint64_t, Merge> merges_;
+};
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <iomanip>
+#include <random>
+#include <functional>
+#include "tokenizer.h"
+
+// Timer class
+class Timer {
+public:
+    Timer() : start_(std::chrono::high_resolution_clock::now()) {}
+
+    double elapsed() {
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start_).count();
+    }
+
+private:
+    std::chrono::time_point<std::chrono::high_resolution_clock> start_;
+};
+
+// The estimator proxy_server used before Tokenizer, kept for comparison
+int legacyCalculateTokens(const std::string& content) {
+    int tokens = 0;
+    std::string current_word;
+
+    for (char c : content) {
+        if (std::isspace(c)) {
+            if (!current_word.empty()) {
+                if (current_word.length() == 1 && (unsigned char)current_word[0] > 127) {
+                    tokens += 1;
+                } else {
+                    tokens += (current_word.length() + 3) / 4;
+                }
+                current_word.clear();
+            }
+        } else {
+            current_word += c;
+        }
+    }
+
+    if (!current_word.empty()) {
+        if (current_word.length() == 1 && (unsigned char)current_word[0] > 127) {
+            tokens += 1;
+        } else {
+            tokens += (current_word.length() + 3) / 4;
+        }
+    }
+
+    return tokens;
+}
+
+// Build roughly `bytes` of text from the given fragments
+std::string makeCorpus(const std::vector<std::string>& fragments, size_t bytes) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> pick(0, fragments.size() - 1);
+    std::string text;
+    text.reserve(bytes + 64);
+    while (text.size() < bytes) {
+        text += fragments[pick(gen)];
+    }
+    return text;
+}
+
+void runCase(const std::string& name, const std::string& text, const std::function<size_t(const std::string&)>& fn) {
+    const int MIN_ROUNDS = 3;
+    const double MIN_TIME_MS = 300;
+
+    size_t result = 0;
+    int rounds = 0;
+    Timer timer;
+    while (rounds < MIN_ROUNDS || timer.elapsed() < MIN_TIME_MS) {
+        result += fn(text);
+        ++rounds;
+    }
+    double ms = timer.elapsed();
+    double gbps = (static_cast<double>(text.size()) * rounds) / (ms / 1000.0) / 1e9;
+
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::fixed << std::setprecision(2) << std::setw(8) << gbps << " GB/s"
+              << "  tokens=" << result / rounds << "\n";
+}
+
+void benchCorpus(const std::string& title, const std::string& text, const Tokenizer* bpe) {
+    std::cout << "\n=== " << title << " (" << text.size() / 1024 << " KiB) ===\n";
+    runCase("legacy lambda", text, [](const std::string& s) { return static_cast<size_t>(legacyCalculateTokens(s)); });
+    runCase("Tokenizer::estimateScalar", text, [](const std::string& s) { return Tokenizer::estimateScalar(s); });
+    runCase("Tokenizer::estimate", text, [](const std::string& s) { return Tokenizer::estimate(s); });
+    if (bpe) {
+        runCase("Tokenizer::count (BPE)", text, [bpe](const std::string& s) { return bpe->count(s); });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const size_t CORPUS_BYTES = 4 * 1024 * 1024;
+
+    // Optional: path to a DeepSeek tokenizer.json / merges.txt for the exact mode
+    Tokenizer bpe;
+    const Tokenizer* bpePtr = nullptr;
+    if (argc > 1) {
+        if (bpe.loadMerges(argv[1])) {
+            std::cout << "Loaded " << bpe.mergeCount() << " merges from " << argv[1] << "\n";
+            bpePtr = &bpe;
+        } else {
+            std::cout << "Failed to load merges from " << argv[1] << "\n";
+        }
+    }
+
+    std::string english = makeCorpus({"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog. ",
+                                      "cache ", "proxy ", "server,\n", "what ", "can ", "you ", "do? "}, CORPUS_BYTES);
+    std::string chinese = makeCorpus({"你好", "世界", "缓存", "服务器", "，", "。", "请问", "你能做什么", "\n"}, CORPUS_BYTES);
+    std::string mixed = makeCorpus({"hello ", "你好 ", "LRU cache ", "命中率 ", "p99 ", "延迟，", "thanks! "}, CORPUS_BYTES);
+
+    benchCorpus("English", english, bpePtr);
+    benchCorpus("Chinese", chinese, bpePtr);
+    benchCorpus("Mixed", mixed, bpePtr);
+
+    return 0;
+}
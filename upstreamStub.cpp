@@ -0,0 +1,56 @@
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "cmdLine.h"
+
+// Local stand-in for http_server: answers /api/message with an echo after a
+// fixed delay and counts calls, so proxy setups can be tried without an API key.
+// Each call holds a worker for the whole delay; --threads bounds the concurrency
+// (rate x delay), so size it for load tests such as proxy_bench.
+//   upstream_stub --port=8888 --delay-ms=200 --threads=256
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    int port = static_cast<int>(args.getInt("port", 8888));
+    auto delay = std::chrono::milliseconds(args.getInt("delay-ms", 200));
+    int threads = std::max(1, static_cast<int>(args.getInt("threads", 256)));
+
+    std::atomic<size_t> calls{0};
+    httplib::Server svr;
+    svr.new_task_queue = [threads]() { return new httplib::ThreadPool(threads); };
+
+    svr.Get("/api/hello", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content("{\"message\":\"Hello from upstream stub\"}", "application/json");
+    });
+
+    svr.Post("/api/message", [&calls, delay](const httplib::Request& req, httplib::Response& res) {
+        try {
+            auto json = nlohmann::json::parse(req.body);
+            std::string message = json.value("message", "");
+            size_t n = ++calls;
+            std::this_thread::sleep_for(delay);
+
+            nlohmann::json response = {
+                {"conversationId", json.value("conversationId", "")},
+                {"content", "stub reply #" + std::to_string(n) + ": " + message},
+                {"role", "assistant"}
+            };
+            res.set_content(response.dump(), "application/json");
+        } catch (const std::exception& e) {
+            res.status = 400;
+            res.set_content(nlohmann::json{{"error", e.what()}}.dump(), "application/json");
+        }
+    });
+
+    svr.Get("/api/stub/calls", [&calls](const httplib::Request&, httplib::Response& res) {
+        res.set_content(nlohmann::json{{"calls", calls.load()}}.dump(), "application/json");
+    });
+
+    std::cout << "Upstream stub running on http://0.0.0.0:" << port << std::endl;
+    svr.listen("0.0.0.0", port);
+    return 0;
+}
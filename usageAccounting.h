@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Tokens billed (or saved) by one upstream reply
+struct UsageSample {
+    uint64_t promptTokens = 0;
+    uint64_t cacheHitTokens = 0;        // part of promptTokens the provider served from its context cache
+    uint64_t completionTokens = 0;
+};
+
+// USD per million tokens; defaults are DeepSeek chat list prices
+struct UsagePricing {
+    double inputCacheMiss = 0.27;
+    double inputCacheHit = 0.07;
+    double output = 1.10;
+
+    double cost(uint64_t promptTokens, uint64_t cacheHitTokens, uint64_t completionTokens) const {
+        uint64_t hit = std::min(cacheHitTokens, promptTokens);
+        return ((promptTokens - hit) * inputCacheMiss + hit * inputCacheHit + completionTokens * output) / 1e6;
+    }
+};
+
+struct UsageAccountingOptions {
+    UsagePricing pricing;
+    size_t maxKeys = 10000;             // rows per table; when full, the least recently active are folded into "(other)"
+    size_t windowSeconds = 300;
+};
+
+// Token spend per conversation, per client and overall, plus what the response
+// cache saved.
+//
+// "Spent" is what upstream replies reported; "avoided" is the usage stored with
+// a cache entry, credited each time the entry answers instead of the upstream.
+// Counters are atomics: once a row exists, recording is a shared-lock lookup and
+// a few relaxed adds, so request threads never wait on each other here. Rates
+// come from a ring of one-second buckets (approximate: an add racing a bucket
+// reset can be lost).
+class UsageAccounting {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Options = UsageAccountingOptions;
+
+    struct Totals {
+        uint64_t requests = 0;
+        uint64_t promptTokens = 0;
+        uint64_t cacheHitTokens = 0;
+        uint64_t completionTokens = 0;
+        uint64_t avoidedRequests = 0;
+        uint64_t avoidedPromptTokens = 0;
+        uint64_t avoidedCompletionTokens = 0;
+    };
+
+    explicit UsageAccounting(const Options& options = Options())
+        : options_(options)
+        , window_(std::max<size_t>(options.windowSeconds, 1))
+        , started_(Clock::now())
+    {}
+
+    void recordSpent(const std::string& conversation, const std::string& client, const UsageSample& sample) {
+        record(conversation, client, sample, false);
+    }
+
+    void recordAvoided(const std::string& conversation, const std::string& client, const UsageSample& sample) {
+        record(conversation, client, sample, true);
+    }
+
+    Totals totals() const { return global_.load(); }
+
+    // {"total":..., "window":{...}, "conversations":[top N], "clients":[top N]};
+    // conversation / client add that one row (null if unknown)
+    nlohmann::json report(size_t top, const std::string& conversation = "", const std::string& client = "") const {
+        nlohmann::json out = {
+            {"pricing", {
+                {"inputCacheMissPerMTok", options_.pricing.inputCacheMiss},
+                {"inputCacheHitPerMTok", options_.pricing.inputCacheHit},
+                {"outputPerMTok", options_.pricing.output}
+            }},
+            {"total", render(global_.load())},
+            {"window", renderWindow(60)},
+            {"windowLong", renderWindow(options_.windowSeconds)},
+            {"conversations", conversations_.top(top, *this)},
+            {"clients", clients_.top(top, *this)}
+        };
+        Totals row;
+        if (!conversation.empty()) {
+            out["conversation"] = conversations_.find(conversation, row) ? render(row) : nlohmann::json();
+        }
+        if (!client.empty()) {
+            out["client"] = clients_.find(client, row) ? render(row) : nlohmann::json();
+        }
+        return out;
+    }
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> promptTokens{0};
+        std::atomic<uint64_t> cacheHitTokens{0};
+        std::atomic<uint64_t> completionTokens{0};
+        std::atomic<uint64_t> avoidedRequests{0};
+        std::atomic<uint64_t> avoidedPromptTokens{0};
+        std::atomic<uint64_t> avoidedCompletionTokens{0};
+
+        void add(const UsageSample& sample, bool avoided) {
+            if (avoided) {
+                avoidedRequests.fetch_add(1, std::memory_order_relaxed);
+                avoidedPromptTokens.fetch_add(sample.promptTokens, std::memory_order_relaxed);
+                avoidedCompletionTokens.fetch_add(sample.completionTokens, std::memory_order_relaxed);
+            } else {
+                requests.fetch_add(1, std::memory_order_relaxed);
+                promptTokens.fetch_add(sample.promptTokens, std::memory_order_relaxed);
+                cacheHitTokens.fetch_add(sample.cacheHitTokens, std::memory_order_relaxed);
+                completionTokens.fetch_add(sample.completionTokens, std::memory_order_relaxed);
+            }
+        }
+
+        // Fold a finished row into this one
+        void add(const Totals& t) {
+            requests.fetch_add(t.requests, std::memory_order_relaxed);
+            promptTokens.fetch_add(t.promptTokens, std::memory_order_relaxed);
+            cacheHitTokens.fetch_add(t.cacheHitTokens, std::memory_order_relaxed);
+            completionTokens.fetch_add(t.completionTokens, std::memory_order_relaxed);
+            avoidedRequests.fetch_add(t.avoidedRequests, std::memory_order_relaxed);
+            avoidedPromptTokens.fetch_add(t.avoidedPromptTokens, std::memory_order_relaxed);
+            avoidedCompletionTokens.fetch_add(t.avoidedCompletionTokens, std::memory_order_relaxed);
+        }
+
+        void clear() {
+            for (auto* counter : {&requests, &promptTokens, &cacheHitTokens, &completionTokens,
+                                  &avoidedRequests, &avoidedPromptTokens, &avoidedCompletionTokens}) {
+                counter->store(0, std::memory_order_relaxed);
+            }
+        }
+
+        Totals load() const {
+            Totals t;
+            t.requests = requests.load(std::memory_order_relaxed);
+            t.promptTokens = promptTokens.load(std::memory_order_relaxed);
+            t.cacheHitTokens = cacheHitTokens.load(std::memory_order_relaxed);
+            t.completionTokens = completionTokens.load(std::memory_order_relaxed);
+            t.avoidedRequests = avoidedRequests.load(std::memory_order_relaxed);
+            t.avoidedPromptTokens = avoidedPromptTokens.load(std::memory_order_relaxed);
+            t.avoidedCompletionTokens = avoidedCompletionTokens.load(std::memory_order_relaxed);
+            return t;
+        }
+    };
+
+    static void accumulate(Totals& into, const Totals& t) {
+        into.requests += t.requests;
+        into.promptTokens += t.promptTokens;
+        into.cacheHitTokens += t.cacheHitTokens;
+        into.completionTokens += t.completionTokens;
+        into.avoidedRequests += t.avoidedRequests;
+        into.avoidedPromptTokens += t.avoidedPromptTokens;
+        into.avoidedCompletionTokens += t.avoidedCompletionTokens;
+    }
+
+    // Rows keyed by conversation or client id, sharded by hash. A full shard
+    // evicts its least recently active eighth so new ids keep getting their own
+    // rows; evicted counts move to "(other)" once the last recorder lets go of
+    // the row, so totals stay exact.
+    class Table {
+    public:
+        static constexpr size_t kShards = 16;
+
+        std::shared_ptr<Counters> row(const std::string& key, size_t maxKeys, int64_t now) {
+            Shard& shard = shards_[std::hash<std::string>()(key) % kShards];
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                auto it = shard.rows.find(key);
+                if (it != shard.rows.end()) {
+                    it->second.touch(now);
+                    return it->second.counters;
+                }
+            }
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.rows.find(key);
+            if (it != shard.rows.end()) {
+                it->second.touch(now);
+                return it->second.counters;
+            }
+            size_t limit = maxKeys / kShards + 1;
+            if (shard.rows.size() >= limit) {
+                evictIdle(shard, limit / 8 + 1);
+            }
+            std::shared_ptr<Counters> counters(new Counters(), [this](Counters* finished) {
+                overflow_.add(finished->load());
+                delete finished;
+            });
+            shard.rows.emplace(key, Row{counters, now});
+            return counters;
+        }
+
+        bool find(const std::string& key, Totals& out) const {
+            const Shard& shard = shards_[std::hash<std::string>()(key) % kShards];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.rows.find(key);
+            if (it == shard.rows.end()) {
+                return false;
+            }
+            out = it->second.counters->load();
+            return true;
+        }
+
+        // Rows with the highest spend, most expensive first
+        nlohmann::json top(size_t n, const UsageAccounting& owner) const {
+            std::vector<std::pair<double, nlohmann::json>> rows;
+            auto consider = [&](const std::string& key, const Totals& t) {
+                double cost = owner.options_.pricing.cost(t.promptTokens, t.cacheHitTokens, t.completionTokens);
+                if (rows.size() == n && (n == 0 || cost <= rows.back().first)) {
+                    return;
+                }
+                nlohmann::json row = owner.render(t);
+                row["id"] = key;
+                rows.emplace_back(cost, std::move(row));
+                std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+                if (rows.size() > n) {
+                    rows.pop_back();
+                }
+            };
+            for (const Shard& shard : shards_) {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto& entry : shard.rows) {
+                    consider(entry.first, entry.second.counters->load());
+                }
+            }
+            Totals other = overflow_.load();
+            if (other.requests > 0 || other.avoidedRequests > 0) {
+                consider("(other)", other);
+            }
+
+            nlohmann::json out = nlohmann::json::array();
+            for (auto& row : rows) {
+                out.push_back(std::move(row.second));
+            }
+            return out;
+        }
+
+    private:
+        struct Row {
+            std::shared_ptr<Counters> counters;
+            std::atomic<int64_t> lastSeen;      // seconds since start of the last record
+
+            Row(std::shared_ptr<Counters> c, int64_t now) : counters(std::move(c)), lastSeen(now) {}
+            Row(Row&& other) noexcept
+                : counters(std::move(other.counters)), lastSeen(other.lastSeen.load(std::memory_order_relaxed)) {}
+
+            // Shared lock only: skip the store when the second hasn't changed
+            void touch(int64_t now) {
+                if (lastSeen.load(std::memory_order_relaxed) != now) {
+                    lastSeen.store(now, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string, Row> rows;
+        };
+
+        // Drop the `count` rows idle the longest; needs the shard's unique lock
+        static void evictIdle(Shard& shard, size_t count) {
+            std::vector<int64_t> seen;
+            seen.reserve(shard.rows.size());
+            for (const auto& entry : shard.rows) {
+                seen.push_back(entry.second.lastSeen.load(std::memory_order_relaxed));
+            }
+            count = std::min(count, seen.size());
+            std::nth_element(seen.begin(), seen.begin() + (count - 1), seen.end());
+            int64_t cutoff = seen[count - 1];
+            for (auto it = shard.rows.begin(); it != shard.rows.end() && count > 0;) {
+                if (it->second.lastSeen.load(std::memory_order_relaxed) <= cutoff) {
+                    it = shard.rows.erase(it);
+                    --count;
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        // Declared before the shards: rows destroyed with them still fold into it
+        Counters overflow_;
+        Shard shards_[kShards];
+    };
+
+    struct Bucket {
+        std::atomic<int64_t> second{-1};
+        Counters counters;
+    };
+
+    void record(const std::string& conversation, const std::string& client, const UsageSample& sample, bool avoided) {
+        global_.add(sample, avoided);
+        int64_t now = secondsSinceStart();
+        if (!conversation.empty()) {
+            conversations_.row(conversation, options_.maxKeys, now)->add(sample, avoided);
+        }
+        if (!client.empty()) {
+            clients_.row(client, options_.maxKeys, now)->add(sample, avoided);
+        }
+
+        Bucket& bucket = window_[static_cast<size_t>(now) % window_.size()];
+        int64_t seen = bucket.second.load(std::memory_order_acquire);
+        if (seen != now && bucket.second.compare_exchange_strong(seen, now, std::memory_order_acq_rel)) {
+            bucket.counters.clear();
+        }
+        bucket.counters.add(sample, avoided);
+    }
+
+    int64_t secondsSinceStart() const {
+        return std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - started_).count();
+    }
+
+    nlohmann::json render(const Totals& t) const {
+        const UsagePricing& p = options_.pricing;
+        return {
+            {"requests", t.requests},
+            {"promptTokens", t.promptTokens},
+            {"promptCacheHitTokens", t.cacheHitTokens},
+            {"completionTokens", t.completionTokens},
+            {"costUsd", p.cost(t.promptTokens, t.cacheHitTokens, t.completionTokens)},
+            {"avoidedRequests", t.avoidedRequests},
+            {"avoidedPromptTokens", t.avoidedPromptTokens},
+            {"avoidedCompletionTokens", t.avoidedCompletionTokens},
+            // Priced as cache-miss input: what the calls would have cost at worst
+            {"avoidedCostUsd", p.cost(t.avoidedPromptTokens, 0, t.avoidedCompletionTokens)}
+        };
+    }
+
+    // Sums of the last `seconds` complete buckets, as per-second rates
+    nlohmann::json renderWindow(size_t seconds) const {
+        int64_t now = secondsSinceStart();
+        int64_t span = static_cast<int64_t>(std::min(seconds, window_.size() - 1));
+        span = std::max<int64_t>(1, std::min(span, now));
+        Totals sum;
+        for (const Bucket& bucket : window_) {
+            int64_t second = bucket.second.load(std::memory_order_acquire);
+            if (second >= now - span && second < now) {
+                accumulate(sum, bucket.counters.load());
+            }
+        }
+
+        const UsagePricing& p = options_.pricing;
+        double per = 1.0 / static_cast<double>(span);
+        return {
+            {"seconds", span},
+            {"requestsPerS", sum.requests * per},
+            {"promptTokensPerS", sum.promptTokens * per},
+            {"completionTokensPerS", sum.completionTokens * per},
+            {"costUsdPerHour", p.cost(sum.promptTokens, sum.cacheHitTokens, sum.completionTokens) * per * 3600},
+            {"avoidedRequestsPerS", sum.avoidedRequests * per},
+            {"avoidedCostUsdPerHour", p.cost(sum.avoidedPromptTokens, 0, sum.avoidedCompletionTokens) * per * 3600}
+        };
+    }
+
+    Options options_;
+    Counters global_;
+    Table conversations_;
+    Table clients_;
+    std::vector<Bucket> window_;
+    Clock::time_point started_;
+};